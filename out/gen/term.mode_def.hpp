@@ -0,0 +1,74 @@
+/* automatically generated from term.mode.def */
+mode_gatm                 =     0,
+mode_kam                  =     1,
+mode_crm                  =     2 | mode_flag_guarded | mode_flag_protect,
+mode_irm                  =     3,
+mode_srtm                 =     4 | mode_flag_guarded | mode_flag_protect,
+mode_erm                  =     5,
+mode_vem                  =     6,
+mode_bdsm                 =     7,
+mode_dcsm                 =     8,
+mode_hem                  =     9,
+mode_pum                  =    10 | mode_flag_guarded | mode_flag_protect,
+mode_srm                  =    11,
+mode_feam                 =    12 | mode_flag_guarded | mode_flag_protect,
+mode_fetm                 =    13 | mode_flag_guarded | mode_flag_protect,
+mode_matm                 =    14 | mode_flag_guarded | mode_flag_protect,
+mode_ttm                  =    15 | mode_flag_guarded | mode_flag_protect,
+mode_satm                 =    16 | mode_flag_guarded | mode_flag_protect,
+mode_tsm                  =    17 | mode_flag_guarded | mode_flag_protect,
+mode_ebm                  =    18 | mode_flag_guarded | mode_flag_protect,
+mode_lnm                  =    19,
+mode_grcm                 =    20,
+mode_zdm                  =    21,
+mode_decckm               =    22,
+mode_decsclm              =    23,
+mode_decom                =    24,
+mode_decarm               =    25,
+mode_decnkm               =    26,
+mode_decbkm               =    27,
+mode_XtermPasteInBracket  =    28,
+mode_SynchronizedOutput   =    29,
+mode_decawm_              =    30 | mode_flag_guarded | mode_flag_protect,
+mode_XtermReversewrap     =    31,
+mode_Att610Blink          =    32,
+mode_XtermCursorBlinkOps  =    33,
+mode_XtermXorCursorBlinks =    34,
+mode_dectcem              =    35,
+mode_declrmm              =    36,
+mode_altscr               =    37 | mode_flag_guarded | mode_flag_protect,
+mode_Xterm132cols         =    38,
+mode_decncsm              =    39,
+mode_decscnm_             =    40 | mode_flag_guarded | mode_flag_protect,
+mode_XtermFocusEventMouse =    41,
+mode_simd                 =    42 | mode_flag_guarded | mode_flag_protect,
+mode_xenl_ech             =    43 | mode_flag_guarded | mode_flag_protect,
+mode_home_il              =    44 | mode_flag_guarded | mode_flag_protect,
+mode_s7c1t                =    45 | mode_flag_guarded | mode_flag_protect,
+mode_bce                  =    46 | mode_flag_guarded | mode_flag_protect,
+mode_xenl                 =    47 | mode_flag_guarded | mode_flag_protect,
+mode_decawm               =     0 | mode_flag_accessor,
+mode_wystcurm             =     1 | mode_flag_accessor,
+mode_wyulcurm             =     2 | mode_flag_accessor,
+mode_XtermAltbuf          =     3 | mode_flag_accessor,
+mode_XtermOptAltbuf       =     4 | mode_flag_accessor,
+mode_XtermSaveCursor      =     5 | mode_flag_accessor,
+mode_XtermOptAltbufCursor =     6 | mode_flag_accessor,
+mode_deccolm              =     7 | mode_flag_accessor,
+mode_decscnm              =     8 | mode_flag_accessor,
+mode_XtermTcapFkeys       =     9 | mode_flag_accessor,
+mode_XtermSunFkeys        =    10 | mode_flag_accessor,
+mode_XtermHpFkeys         =    11 | mode_flag_accessor,
+mode_XtermScoFkeys        =    12 | mode_flag_accessor,
+mode_XtermLegacyFkeys     =    13 | mode_flag_accessor,
+mode_XtermVt220Fkeys      =    14 | mode_flag_accessor,
+mode_ContraTildeFkeys     =    15 | mode_flag_accessor | mode_flag_guarded | mode_flag_protect,
+mode_XtermX10Mouse        =    16 | mode_flag_accessor,
+mode_XtermVt200Mouse      =    17 | mode_flag_accessor,
+mode_XtermVt200HighlightMouse =    18 | mode_flag_accessor,
+mode_XtermBtnEventMouse   =    19 | mode_flag_accessor,
+mode_XtermAnyEventMouse   =    20 | mode_flag_accessor,
+mode_XtermExtModeMouse    =    21 | mode_flag_accessor,
+mode_XtermSgrExtModeMouse =    22 | mode_flag_accessor,
+mode_UrxvtExtModeMouse    =    23 | mode_flag_accessor,
+mode_XtermPixelPositionMouse =    24 | mode_flag_accessor,
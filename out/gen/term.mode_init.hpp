@@ -0,0 +1,38 @@
+/* automatically generated from term.mode.def */
+set_mode(mode_gatm, false);
+set_mode(mode_kam, false);
+set_mode(mode_irm, false);
+set_mode(mode_erm, false);
+set_mode(mode_vem, false);
+set_mode(mode_bdsm, false);
+set_mode(mode_dcsm, true);
+set_mode(mode_hem, false);
+set_mode(mode_srm, true);
+set_mode(mode_lnm, false);
+set_mode(mode_grcm, true);
+set_mode(mode_zdm, true);
+set_mode(mode_decckm, false);
+set_mode(mode_decsclm, true);
+set_mode(mode_decom, false);
+set_mode(mode_decarm, true);
+set_mode(mode_decnkm, false);
+set_mode(mode_decbkm, false);
+set_mode(mode_XtermPasteInBracket, false);
+set_mode(mode_SynchronizedOutput, false);
+set_mode(mode_decawm_, true);
+set_mode(mode_Att610Blink, true);
+set_mode(mode_XtermCursorBlinkOps, false);
+set_mode(mode_XtermXorCursorBlinks, true);
+set_mode(mode_dectcem, true);
+set_mode(mode_declrmm, false);
+set_mode(mode_altscr, false);
+set_mode(mode_Xterm132cols, false);
+set_mode(mode_decncsm, false);
+set_mode(mode_decscnm_, false);
+set_mode(mode_XtermFocusEventMouse, false);
+set_mode(mode_simd, false);
+set_mode(mode_xenl_ech, true);
+set_mode(mode_home_il, false);
+set_mode(mode_s7c1t, true);
+set_mode(mode_bce, true);
+set_mode(mode_xenl, true);
@@ -0,0 +1,65 @@
+/* automatically generated from term.mode.def */
+data_ansi[1] = mode_gatm;
+data_ansi[2] = mode_kam;
+data_ansi[3] = mode_crm;
+data_ansi[4] = mode_irm;
+data_ansi[5] = mode_srtm;
+data_ansi[6] = mode_erm;
+data_ansi[7] = mode_vem;
+data_ansi[8] = mode_bdsm;
+data_ansi[9] = mode_dcsm;
+data_ansi[10] = mode_hem;
+data_ansi[11] = mode_pum;
+data_ansi[12] = mode_srm;
+data_ansi[13] = mode_feam;
+data_ansi[14] = mode_fetm;
+data_ansi[15] = mode_matm;
+data_ansi[16] = mode_ttm;
+data_ansi[17] = mode_satm;
+data_ansi[18] = mode_tsm;
+data_ansi[19] = mode_ebm;
+data_ansi[20] = mode_lnm;
+data_ansi[21] = mode_grcm;
+data_ansi[22] = mode_zdm;
+data_dec[1] = mode_decckm;
+data_dec[4] = mode_decsclm;
+data_dec[6] = mode_decom;
+data_dec[8] = mode_decarm;
+data_dec[66] = mode_decnkm;
+data_dec[67] = mode_decbkm;
+data_dec[2004] = mode_XtermPasteInBracket;
+data_dec[2026] = mode_SynchronizedOutput;
+data_dec[45] = mode_XtermReversewrap;
+data_dec[12] = mode_Att610Blink;
+data_dec[13] = mode_XtermCursorBlinkOps;
+data_dec[14] = mode_XtermXorCursorBlinks;
+data_dec[25] = mode_dectcem;
+data_dec[69] = mode_declrmm;
+data_dec[40] = mode_Xterm132cols;
+data_dec[95] = mode_decncsm;
+data_dec[1004] = mode_XtermFocusEventMouse;
+data_dec[7] = mode_decawm;
+data_ansi[33] = mode_wystcurm;
+data_ansi[34] = mode_wyulcurm;
+data_dec[47] = mode_XtermAltbuf;
+data_dec[1047] = mode_XtermOptAltbuf;
+data_dec[1048] = mode_XtermSaveCursor;
+data_dec[1049] = mode_XtermOptAltbufCursor;
+data_dec[3] = mode_deccolm;
+data_dec[5] = mode_decscnm;
+data_dec[1050] = mode_XtermTcapFkeys;
+data_dec[1051] = mode_XtermSunFkeys;
+data_dec[1052] = mode_XtermHpFkeys;
+data_dec[1053] = mode_XtermScoFkeys;
+data_dec[1060] = mode_XtermLegacyFkeys;
+data_dec[1061] = mode_XtermVt220Fkeys;
+data_dec[9950] = mode_ContraTildeFkeys;
+data_dec[9] = mode_XtermX10Mouse;
+data_dec[1000] = mode_XtermVt200Mouse;
+data_dec[1001] = mode_XtermVt200HighlightMouse;
+data_dec[1002] = mode_XtermBtnEventMouse;
+data_dec[1003] = mode_XtermAnyEventMouse;
+data_dec[1005] = mode_XtermExtModeMouse;
+data_dec[1006] = mode_XtermSgrExtModeMouse;
+data_dec[1015] = mode_UrxvtExtModeMouse;
+data_dec[1016] = mode_XtermPixelPositionMouse;
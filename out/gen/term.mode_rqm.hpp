@@ -0,0 +1,26 @@
+/* automatically generated from term.mode.def */
+case mode_index(mode_decawm): return do_rqm_decawm(*m_term);
+case mode_index(mode_wystcurm): return do_rqm_wystcurm(*m_term);
+case mode_index(mode_wyulcurm): return do_rqm_wyulcurm(*m_term);
+case mode_index(mode_XtermAltbuf): return do_rqm_XtermAltbuf(*m_term);
+case mode_index(mode_XtermOptAltbuf): return do_rqm_XtermOptAltbuf(*m_term);
+case mode_index(mode_XtermSaveCursor): return do_rqm_XtermSaveCursor(*m_term);
+case mode_index(mode_XtermOptAltbufCursor): return do_rqm_XtermOptAltbufCursor(*m_term);
+case mode_index(mode_deccolm): return do_rqm_deccolm(*m_term);
+case mode_index(mode_decscnm): return do_rqm_decscnm(*m_term);
+case mode_index(mode_XtermTcapFkeys): return do_rqm_XtermTcapFkeys(*m_term);
+case mode_index(mode_XtermSunFkeys): return do_rqm_XtermSunFkeys(*m_term);
+case mode_index(mode_XtermHpFkeys): return do_rqm_XtermHpFkeys(*m_term);
+case mode_index(mode_XtermScoFkeys): return do_rqm_XtermScoFkeys(*m_term);
+case mode_index(mode_XtermLegacyFkeys): return do_rqm_XtermLegacyFkeys(*m_term);
+case mode_index(mode_XtermVt220Fkeys): return do_rqm_XtermVt220Fkeys(*m_term);
+case mode_index(mode_ContraTildeFkeys): return do_rqm_ContraTildeFkeys(*m_term);
+case mode_index(mode_XtermX10Mouse): return do_rqm_XtermX10Mouse(*m_term);
+case mode_index(mode_XtermVt200Mouse): return do_rqm_XtermVt200Mouse(*m_term);
+case mode_index(mode_XtermVt200HighlightMouse): return do_rqm_XtermVt200HighlightMouse(*m_term);
+case mode_index(mode_XtermBtnEventMouse): return do_rqm_XtermBtnEventMouse(*m_term);
+case mode_index(mode_XtermAnyEventMouse): return do_rqm_XtermAnyEventMouse(*m_term);
+case mode_index(mode_XtermExtModeMouse): return do_rqm_XtermExtModeMouse(*m_term);
+case mode_index(mode_XtermSgrExtModeMouse): return do_rqm_XtermSgrExtModeMouse(*m_term);
+case mode_index(mode_UrxvtExtModeMouse): return do_rqm_UrxvtExtModeMouse(*m_term);
+case mode_index(mode_XtermPixelPositionMouse): return do_rqm_XtermPixelPositionMouse(*m_term);
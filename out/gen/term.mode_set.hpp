@@ -0,0 +1,26 @@
+/* automatically generated from term.mode.def */
+case mode_index(mode_decawm): return do_sm_decawm(*m_term, value);
+case mode_index(mode_wystcurm): return do_sm_wystcurm(*m_term, value);
+case mode_index(mode_wyulcurm): return do_sm_wyulcurm(*m_term, value);
+case mode_index(mode_XtermAltbuf): return do_sm_XtermAltbuf(*m_term, value);
+case mode_index(mode_XtermOptAltbuf): return do_sm_XtermOptAltbuf(*m_term, value);
+case mode_index(mode_XtermSaveCursor): return do_sm_XtermSaveCursor(*m_term, value);
+case mode_index(mode_XtermOptAltbufCursor): return do_sm_XtermOptAltbufCursor(*m_term, value);
+case mode_index(mode_deccolm): return do_sm_deccolm(*m_term, value);
+case mode_index(mode_decscnm): return do_sm_decscnm(*m_term, value);
+case mode_index(mode_XtermTcapFkeys): return do_sm_XtermTcapFkeys(*m_term, value);
+case mode_index(mode_XtermSunFkeys): return do_sm_XtermSunFkeys(*m_term, value);
+case mode_index(mode_XtermHpFkeys): return do_sm_XtermHpFkeys(*m_term, value);
+case mode_index(mode_XtermScoFkeys): return do_sm_XtermScoFkeys(*m_term, value);
+case mode_index(mode_XtermLegacyFkeys): return do_sm_XtermLegacyFkeys(*m_term, value);
+case mode_index(mode_XtermVt220Fkeys): return do_sm_XtermVt220Fkeys(*m_term, value);
+case mode_index(mode_ContraTildeFkeys): return do_sm_ContraTildeFkeys(*m_term, value);
+case mode_index(mode_XtermX10Mouse): return do_sm_XtermX10Mouse(*m_term, value);
+case mode_index(mode_XtermVt200Mouse): return do_sm_XtermVt200Mouse(*m_term, value);
+case mode_index(mode_XtermVt200HighlightMouse): return do_sm_XtermVt200HighlightMouse(*m_term, value);
+case mode_index(mode_XtermBtnEventMouse): return do_sm_XtermBtnEventMouse(*m_term, value);
+case mode_index(mode_XtermAnyEventMouse): return do_sm_XtermAnyEventMouse(*m_term, value);
+case mode_index(mode_XtermExtModeMouse): return do_sm_XtermExtModeMouse(*m_term, value);
+case mode_index(mode_XtermSgrExtModeMouse): return do_sm_XtermSgrExtModeMouse(*m_term, value);
+case mode_index(mode_UrxvtExtModeMouse): return do_sm_UrxvtExtModeMouse(*m_term, value);
+case mode_index(mode_XtermPixelPositionMouse): return do_sm_XtermPixelPositionMouse(*m_term, value);
@@ -332,10 +332,26 @@ namespace ansi {
     std::vector<attr_t*> gc_references;
     std::uint32_t m_gc_count = 0;
 
+    // 同じ拡張属性に同じ attr_t を割り当てる (hash-consing) 為の索引。
+    // 開番地法 (線形探査) で、各要素は table の添字 + 1 (0 は空) を保持する。
+    // 旧世代と新世代で索引を分けて、minor GC では新世代の索引だけを作り直す。
+    std::vector<std::uint32_t> m_old_index;
+    std::vector<std::uint32_t> m_young_index;
+
+    // 世代別 GC: 添字が m_old_size 未満の項目は旧世代で、minor GC では回収しない。
+    // 旧世代は GC を生き延びた項目なので、それ以前にスクロールバッファに
+    // 移された行が参照しているのは旧世代の項目だけである。
+    std::uint32_t m_old_size = 0;
+    std::uint32_t m_old_live = 0; // 直前の full GC 直後の旧世代の大きさ
+    std::uint32_t m_gc_boundary = 0; // 今回の GC で回収対象とする最初の添字
+
   public:
     std::uint32_t gc_count() const {
       return m_gc_count;
     }
+    std::size_t size() const {
+      return table.size();
+    }
 
   private:
     entry& resolve(attr_t const& attr) {
@@ -368,12 +384,56 @@ namespace ansi {
       }
     }
 
+  private:
+    // Note: aflags_gcmark は GC の途中で付加されるので比較から除外する。
+    static std::uint32_t index_hash(attribute_t const& attr) {
+      std::uint32_t h = 2166136261u;
+      auto _mix = [&h] (std::uint32_t value) { h = (h ^ value) * 16777619u; };
+      _mix((std::uint32_t) (attr.aflags & ~aflags_gcmark));
+      _mix((std::uint32_t) attr.xflags);
+      _mix(attr.fg);
+      _mix(attr.bg);
+      _mix(attr.dc);
+      return h ^ h >> 15;
+    }
+    static bool index_equals(attribute_t const& a, attribute_t const& b) {
+      return ((a.aflags ^ b.aflags) & ~aflags_gcmark) == 0 &&
+        a.xflags == b.xflags && a.fg == b.fg && a.bg == b.bg && a.dc == b.dc;
+    }
+    std::uint32_t& index_find(std::vector<std::uint32_t>& index, attribute_t const& attr) {
+      std::size_t const mask = index.size() - 1;
+      std::size_t i = index_hash(attr) & mask;
+      while (index[i] && !index_equals(table[index[i] - 1].attr, attr))
+        i = (i + 1) & mask;
+      return index[i];
+    }
+    void index_rebuild(std::vector<std::uint32_t>& index, std::size_t begin, std::size_t end, std::size_t capacity) {
+      std::size_t size = 64;
+      while (size < 2 * capacity) size *= 2;
+      index.assign(size, 0);
+      for (std::size_t i = begin; i < end; i++)
+        index_find(index, table[i].attr) = (std::uint32_t) i + 1;
+    }
+
   public:
     attr_t save(attribute_t const& attr) {
+      if (m_old_index.empty())
+        index_rebuild(m_old_index, 0, m_old_size, m_old_size);
+      if (std::uint32_t const slot = index_find(m_old_index, attr))
+        return attr_extended | (slot - 1);
+
+      std::size_t const young_size = table.size() - m_old_size;
+      if (m_young_index.size() < 2 * (young_size + 1))
+        index_rebuild(m_young_index, m_old_size, table.size(), young_size + 1);
+      std::uint32_t& slot = index_find(m_young_index, attr);
+      if (slot) return attr_extended | (slot - 1);
+
       if (table.size() < max_size) {
         m_gc_count++;
         attr_t const ret = attr_extended | (std::uint32_t) table.size();
         table.emplace_back(attr);
+        table.back().attr.aflags &= ~aflags_gcmark;
+        slot = (std::uint32_t) table.size();
         return ret;
       } else {
         // todo: 容量不足
@@ -465,8 +525,22 @@ namespace ansi {
     }
 
   public:
+    /*?lwiki
+     * @fn bool full_gc_recommended() const;
+     *   旧世代に不要になった項目が溜まっている可能性が高い時に true を返す。
+     *   旧世代の項目は full GC でしか回収されない。
+     * @fn void begin_gc(bool full);
+     *   mark の前に呼び出す。full = false の時は新世代の項目だけを対象にする。
+     */
+    bool full_gc_recommended() const {
+      return m_old_size > 2 * m_old_live + 0x1000;
+    }
+    void begin_gc(bool full) {
+      m_gc_boundary = full ? 0 : m_old_size;
+    }
+
     void mark(attr_t* attr) {
-      if (*attr & attr_extended) {
+      if ((*attr & attr_extended) && (std::uint32_t) (*attr & attr_extended_refmask) >= m_gc_boundary) {
         extended(*attr).aflags |= aflags_gcmark;
         gc_references.push_back(attr);
       }
@@ -474,14 +548,15 @@ namespace ansi {
 
     void sweep() {
       // sweep&compaction
-      std::vector<attr_t> gc_compaction_map(table.size(), 0);
-      std::size_t j = 0;
-      for (std::size_t i = 0; i < table.size(); i++) {
+      std::size_t const boundary = m_gc_boundary;
+      std::vector<attr_t> gc_compaction_map(table.size() - boundary, 0);
+      std::size_t j = boundary;
+      for (std::size_t i = boundary; i < table.size(); i++) {
         entry& ent = table[i];
         if (ent.attr.aflags & aflags_gcmark) {
           ent.attr.aflags &= ~aflags_gcmark;
           if (i != j) table[j] = table[i];
-          gc_compaction_map[i] = (std::uint32_t) j | attr_extended;
+          gc_compaction_map[i - boundary] = (std::uint32_t) j | attr_extended;
           j++;
         }
       }
@@ -489,9 +564,23 @@ namespace ansi {
 
       // 参照の書き換え
       for (attr_t* ref : gc_references)
-        *ref = gc_compaction_map[(std::uint32_t)(*ref & attr_extended_refmask)];
+        *ref = gc_compaction_map[(std::uint32_t)(*ref & attr_extended_refmask) - boundary];
       gc_references.clear();
       m_gc_count = 0;
+
+      // 生き残った項目を旧世代に移す
+      if (boundary == 0) {
+        index_rebuild(m_old_index, 0, j, j);
+        m_old_live = j;
+      } else if (m_old_index.size() < 2 * j) {
+        index_rebuild(m_old_index, 0, j, j);
+      } else {
+        for (std::size_t i = boundary; i < j; i++)
+          index_find(m_old_index, table[i].attr) = (std::uint32_t) i + 1;
+      }
+      m_young_index.clear();
+      m_old_size = j;
+      m_gc_boundary = 0;
     }
   };
 
@@ -566,6 +655,32 @@ namespace ansi {
         m_atable->mark(&m_fill_attr);
     }
 
+    // SGR キャッシュ (sgr_cache_t) 用。拡張属性は attr_table への参照
+    // ではなく attribute_t の値として取り出す・設定する。
+    void get_sgr_state(attr_t& attr, attribute_t& attribute) const {
+      if (m_attr & attr_extended) {
+        attr = attr_extended;
+        attribute = m_attribute;
+      } else {
+        attr = m_attr;
+        attribute = attribute_t();
+      }
+    }
+    void set_sgr_state(attr_t attr, attribute_t const& attribute) {
+      color_t old_bg, new_bg;
+      int old_space, new_space;
+      this->get_bg(old_bg, old_space);
+      if (!(attr & attr_extended)) {
+        m_attr = attr;
+      } else if (!(m_attr & attr_extended) || m_attribute != attribute) {
+        m_attr = attr_extended;
+        m_attribute = attribute;
+        m_attribute_dirty = true;
+      }
+      this->get_bg(new_bg, new_space);
+      if (new_bg != old_bg || new_space != old_space) m_fill_dirty = true;
+    }
+
   private:
     void extend() {
       m_atable->get_extended(m_attribute, m_attr);
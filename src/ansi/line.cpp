@@ -1,5 +1,6 @@
 #include "line.hpp"
 #include "../iso2022.hpp"
+#include <unordered_map>
 
 using namespace contra::ansi;
 
@@ -21,25 +22,22 @@ bool character_t::get_unicode_from_iso2022(std::vector<char32_t>& buff, char32_t
   }
 }
 
-void line_t::_mono_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const* cell, int count, int repeat, curpos_t width, int implicit_move) {
-  this->m_version++;
-  contra_unused(implicit_move);
-
+void line_t::_mono_splice_cells(curpos_t xL, curpos_t xR, curpos_t width) {
   // 左側の中途半端な文字を消去
   curpos_t const ncell = (curpos_t) this->m_cells.size();
-  if (xL < ncell && m_cells[xL].character.is_extension()) {
+  if (xL < ncell && m_cells[xL].character().is_extension()) {
     for (std::ptrdiff_t q = xL - 1; q >= 0; q--) {
-      bool const is_wide = this->m_cells[q].character.is_extension();
-      this->m_cells[q].character = ascii_sp;
-      this->m_cells[q].width = 1;
+      bool const is_wide = this->m_cells[q].character().is_extension();
+      this->m_cells[q].set_character(ascii_sp);
+      this->m_cells[q].set_width(1);
       if (!is_wide) break;
     }
   }
 
   // 右側の中途半端な文字を消去
-  for (curpos_t q = xR; q < ncell && this->m_cells[q].character.is_extension(); q++) {
-    this->m_cells[q].character = ascii_sp;
-    this->m_cells[q].width = 1;
+  for (curpos_t q = xR; q < ncell && this->m_cells[q].character().is_extension(); q++) {
+    this->m_cells[q].set_character(ascii_sp);
+    this->m_cells[q].set_width(1);
   }
 
   // 長さの調節
@@ -47,30 +45,66 @@ void line_t::_mono_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const*
   curpos_t const total_len = xL + width + tail_len;
   if (total_len > ncell) {
     cell_t fill;
-    fill.character = ascii_nul;
+    fill.set_character(ascii_nul);
     fill.attribute = 0;
-    fill.width = 1;
+    fill.set_width(1);
     m_cells.insert(m_cells.end() - tail_len, total_len - ncell, fill);
   } else if (total_len < ncell) {
     m_cells.erase(m_cells.begin() + xL, m_cells.begin() + xL + (ncell - total_len));
   }
+}
+
+void line_t::_mono_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const* cell, int count, int repeat, curpos_t width, int implicit_move) {
+  this->m_version++;
+  contra_unused(implicit_move);
+  this->_mono_splice_cells(xL, xR, width);
 
   // 文字を書き込む
   curpos_t x = xL;
   for (int r = 0; r < repeat; r++) {
     for (int i = 0; i < count; i++) {
-      curpos_t const w = cell[i].width;
+      curpos_t const w = cell[i].width();
       m_cells[x] = cell[i];
       for (curpos_t j = 1; j < w; j++) {
-        m_cells[x + j].character = charflag_wide_extension;
+        m_cells[x + j].set_character(charflag_wide_extension);
         m_cells[x + j].attribute = cell[i].attribute;
-        m_cells[x + j].width = 0;
+        m_cells[x + j].set_width(0);
       }
       x += w;
     }
   }
 }
 
+void line_t::write_ascii_cells(curpos_t x, byte const* beg, byte const* end, attr_t const& attr) {
+  if (m_prop_enabled) {
+    // Note: 位置の計算が必要なので一旦 cell_t の列に変換して書き込む。
+    constexpr std::size_t chunk_size = 256;
+    cell_t buff[chunk_size];
+    while (beg < end) {
+      std::size_t const n = std::min<std::size_t>(end - beg, chunk_size);
+      for (std::size_t i = 0; i < n; i++) {
+        buff[i].set_character(beg[i]);
+        buff[i].attribute = attr;
+        buff[i].set_width(1);
+      }
+      _prop_write_cells(x, buff, (int) n, 1, 1);
+      beg += n;
+      x += (curpos_t) n;
+    }
+    return;
+  }
+
+  curpos_t const width = (curpos_t) (end - beg);
+  this->m_version++;
+  this->_mono_splice_cells(x, x + width, width);
+  cell_t* p = &m_cells[x];
+  for (; beg != end; ++beg, ++p) {
+    p->set_character(*beg);
+    p->attribute = attr;
+    p->set_width(1);
+  }
+}
+
 void line_t::_prop_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const* cell, int count, int repeat, curpos_t width, int implicit_move) {
   std::size_t const ncell = m_cells.size();
 
@@ -81,7 +115,7 @@ void line_t::_prop_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const*
   curpos_t x1, x2;
   std::tie(i1, x1) = _prop_glb(xL, implicit_move < 0);
   std::tie(i2, x2) = _prop_lub(xR, implicit_move > 0);
-  if (i1 > i2) i2 = i1; // cell.width=0 implicit_move=0 の時
+  if (i1 > i2) i2 = i1; // cell.width()=0 implicit_move=0 の時
 
   // 書き込み文字数の計算
   std::size_t nwrite = count * repeat;
@@ -94,18 +128,18 @@ void line_t::_prop_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const*
     // Note: x1 < xL && i1 < ncell の時点で x1 < xL <= xR <= x2 より i1 < i2 は保証される。
     // Note: 文字幅 2 以上の NUL が設置されている事があるか分からないが、その時には NUL で埋める。
     if (i1 < ncell) mwg_assert(i1 < i2);
-    lfill.character = i1 < ncell && m_cells[i1].character.value != ascii_nul ? ascii_sp : ascii_nul;
+    lfill.set_character(i1 < ncell && m_cells[i1].character().value != ascii_nul ? ascii_sp : ascii_nul);
     lfill.attribute = i1 < i2 ? m_cells[i1].attribute : 0;
-    lfill.width = 1;
+    lfill.set_width(1);
   }
   if (xR < x2) {
     // Note: xR < x2 の時点で x1 <= xL <= xR < x2 なので i1 < i2 が保証される。
     //   更に、i1 < i2 <= ncell も保証される。
     // Note: 文字幅 2 以上の NUL が設置されている事があるか分からないが、その時には NUL で埋める。
     mwg_assert(i1 < i2 && i1 < ncell);
-    rfill.character = m_cells[i2 - 1].character.value != ascii_nul ? ascii_sp : ascii_nul;
+    rfill.set_character(m_cells[i2 - 1].character().value != ascii_nul ? ascii_sp : ascii_nul);
     rfill.attribute = m_cells[i2 - 1].attribute;
-    rfill.width = 1;
+    rfill.set_width(1);
   }
 
   // 書き込み領域の確保
@@ -148,7 +182,7 @@ void line_t::_prop_reverse(curpos_t width) {
   std::vector<elem_t> stack;
 
   auto _push = [&] (cell_t& cell, std::uint32_t beg_marker, std::uint32_t end_marker) {
-    cell.character = end_marker;
+    cell.set_character(end_marker);
     elem_t elem;
     elem.beg_marker = beg_marker;
     elem.end_marker = end_marker;
@@ -164,9 +198,9 @@ void line_t::_prop_reverse(curpos_t width) {
 
   for (std::size_t i = 0; i < m_cells.size(); ) {
     cell_t& cell = m_cells[i];
-    std::uint32_t const code = cell.character.value;
+    std::uint32_t const code = cell.character().value;
     bool remove = false;
-    if (cell.character.is_marker()) {
+    if (cell.character().is_marker()) {
       switch (code) {
       case marker_sds_l2r: _push(cell, code, marker_sds_end); break;
       case marker_sds_r2l: _push(cell, code, marker_sds_end); break;
@@ -176,7 +210,7 @@ void line_t::_prop_reverse(curpos_t width) {
         remove = true; // 対応する始まりがもし見つからなければ削除
         while (stack.size()) {
           if (stack.back().end_marker == code) {
-            cell.character = stack.back().beg_marker;
+            cell.set_character(stack.back().beg_marker);
             remove = false;
             stack.pop_back();
             break;
@@ -189,11 +223,11 @@ void line_t::_prop_reverse(curpos_t width) {
       default: break;
       }
     } else {
-      if (cell.character.value == ascii_nul) _flush();
+      if (cell.character().value == ascii_nul) _flush();
     }
 
     std::size_t i1 = i++;
-    while (i < m_cells.size() && m_cells[i].character.is_extension()) i++;
+    while (i < m_cells.size() && m_cells[i].character().is_extension()) i++;
     if (!remove)
       for (std::size_t p = i; p-- > i1; )
         buff.emplace_back(std::move(m_cells[p]));
@@ -235,8 +269,8 @@ std::vector<line_t::nested_string> const& line_t::update_strings(curpos_t width,
   if (!m_prop_enabled) return ret;
 
   for (cell_t const& cell : m_cells) {
-    std::uint32_t code = cell.character.value;
-    if (cell.character.is_marker()) {
+    std::uint32_t code = cell.character().value;
+    if (cell.character().is_marker()) {
       switch (code) {
       case marker_sds_l2r: _push(code, marker_sds_end, false); break;
       case marker_sds_r2l: _push(code, marker_sds_end, true); break;
@@ -254,13 +288,13 @@ std::vector<line_t::nested_string> const& line_t::update_strings(curpos_t width,
       default: break;
       }
     } else {
-      if (cell.character.value == ascii_nul) {
+      if (cell.character().value == ascii_nul) {
         while (istr >= 1) {
           ret[istr].end = x1;
           istr = ret[istr].parent;
         }
       }
-      x1 += cell.width;
+      x1 += cell.width();
     }
   }
   while (istr >= 1) {
@@ -339,8 +373,8 @@ curpos_t line_t::_prop_to_presentation_position(curpos_t x, bool line_r2l) const
   };
 
   for (cell_t const& cell : m_cells) {
-    std::uint32_t code = cell.character.value;
-    if (cell.character.is_marker()) {
+    std::uint32_t code = cell.character().value;
+    if (cell.character().is_marker()) {
       switch (code) {
       case marker_sds_l2r:
         _push(marker_sds_end, false);
@@ -363,13 +397,13 @@ curpos_t line_t::_prop_to_presentation_position(curpos_t x, bool line_r2l) const
 
       default: break;
       }
-    } else if (cell.character.value == ascii_nul) {
+    } else if (cell.character().value == ascii_nul) {
       // Note: HT に対しては HT (TAB) の代わりに NUL が挿入される。
       //   またその他の移動の後に文字を入れた時にも使われる。
       //   これらの NUL は segment separator として使われる。
       while (stack.size()) _pop();
     } else {
-      if (x1 <= x && x < x1 + (curpos_t) cell.width) {
+      if (x1 <= x && x < x1 + (curpos_t) cell.width()) {
         contains_odd_count = 0;
 
         // 左側を集計しつつ contains マークを付ける。
@@ -389,7 +423,7 @@ curpos_t line_t::_prop_to_presentation_position(curpos_t x, bool line_r2l) const
         x2 = x + 1;
         contains = true;
       }
-      x1 += cell.width;
+      x1 += cell.width();
     }
 
     // Note: 途中で見つかり更に反転範囲が全て閉じた時はその時点で確定。
@@ -402,23 +436,45 @@ curpos_t line_t::_prop_to_presentation_position(curpos_t x, bool line_r2l) const
   return a;
 }
 
-void line_t::order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const {
-  if (m_prop_enabled && to != position_data) {
-    return _prop_order_cells_in(buff, to, width, line_r2l);
-  } else {
-    buff.clear();
-    buff.reserve(m_cells.size());
-    curpos_t w = 0;
-    for (auto const& cell : m_cells) {
-      if (cell.character.is_wide_extension()) continue;
-      if (curpos_t(w + cell.width) > width) break;
-      w += cell.width;
-      buff.push_back(cell);
-    }
-    if (to == position_client && line_r2l) {
-      if (w < width) buff.insert(buff.end(), width - w, cell_t(ascii_nul));
-      std::reverse(buff.begin(), buff.end());
-    }
+std::vector<cell_t> const& line_t::ordered_cells(position_type to, curpos_t width, bool line_r2l) const {
+  int const key = (int) to << 1 | (line_r2l ? 1 : 0);
+  if (m_order_version != m_version || m_order_width != width || m_order_key != key) {
+    m_order_version = m_version;
+    m_order_width = width;
+    m_order_key = key;
+    m_order_identity = _is_identity_order(to, width, line_r2l);
+    if (m_order_identity)
+      m_order_cache.clear();
+    else if (m_prop_enabled && to != position_data)
+      _prop_order_cells_in(m_order_cache, to, width, line_r2l);
+    else
+      _mono_order_cells_in(m_order_cache, to, width, line_r2l);
+  }
+  return m_order_identity ? m_cells : m_order_cache;
+}
+bool line_t::_is_identity_order(position_type to, curpos_t width, bool line_r2l) const {
+  if (m_prop_enabled && to != position_data) return false;
+  if (to == position_client && line_r2l) return false;
+  curpos_t w = 0;
+  for (auto const& cell : m_cells) {
+    if (cell.character().is_wide_extension()) return false;
+    w += cell.width();
+  }
+  return w <= width;
+}
+void line_t::_mono_order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const {
+  buff.clear();
+  buff.reserve(m_cells.size());
+  curpos_t w = 0;
+  for (auto const& cell : m_cells) {
+    if (cell.character().is_wide_extension()) continue;
+    if (curpos_t(w + cell.width()) > width) break;
+    w += cell.width();
+    buff.push_back(cell);
+  }
+  if (to == position_client && line_r2l) {
+    if (w < width) buff.insert(buff.end(), width - w, cell_t(ascii_nul));
+    std::reverse(buff.begin(), buff.end());
   }
 }
 void line_t::_prop_order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const {
@@ -456,8 +512,8 @@ void line_t::_prop_order_cells_in(std::vector<cell_t>& buff, position_type to, c
   curpos_t w = 0;
   for (std::size_t i = 0; i < m_cells.size(); i++) {
     cell_t const& cell = m_cells[i];
-    std::uint32_t code = cell.character.value;
-    if (cell.character.is_marker()) {
+    std::uint32_t code = cell.character().value;
+    if (cell.character().is_marker()) {
       switch (code) {
       case marker_sds_l2r:
         _push(marker_sds_end, false);
@@ -480,18 +536,18 @@ void line_t::_prop_order_cells_in(std::vector<cell_t>& buff, position_type to, c
 
       default: break;
       }
-    } else if (cell.character.value == ascii_nul) {
+    } else if (cell.character().value == ascii_nul) {
       while (stack.size()) _pop();
     }
 
-    if (cell.character.is_wide_extension()) continue;
+    if (cell.character().is_wide_extension()) continue;
 
-    if (curpos_t(w + cell.width) > width) break;
-    w += cell.width;
+    if (curpos_t(w + cell.width()) > width) break;
+    w += cell.width();
 
-    if (r2l != buff_r2l && cell.character.is_extension()) {
+    if (r2l != buff_r2l && cell.character().is_extension()) {
       std::size_t j = buff.size();
-      if (j) while (--j && buff[j - 1].character.is_extension());
+      if (j) while (--j && buff[j - 1].character().is_extension());
       buff.insert(buff.begin() + j, cell);
     } else
       buff.push_back(cell);
@@ -606,22 +662,22 @@ void line_t::_mono_compose_segments(line_segment_t const* comp, int count, curpo
   }
 
   cell_t fill;
-  fill.character = ascii_nul;
+  fill.set_character(ascii_nul);
   fill.attribute = 0;
-  fill.width = 1;
+  fill.set_width(1);
   m_cells.resize(x, fill);
   fill.attribute = fill_attr; // 後で使う
 
   // 境界上の wide 文字をスペースに置き換える関数
   auto _erase_wide_on_boundary = [this] (curpos_t index) {
-    if (!m_cells[index].character.is_wide_extension()) return;
+    if (!m_cells[index].character().is_wide_extension()) return;
     curpos_t l = index, u = index + 1;
     if (l > 0) l--;
-    while (l > 0 && m_cells[l].character.is_wide_extension()) l--;
-    while (u < (curpos_t) m_cells.size() && m_cells[u].character.is_wide_extension()) u++;
+    while (l > 0 && m_cells[l].character().is_wide_extension()) l--;
+    while (u < (curpos_t) m_cells.size() && m_cells[u].character().is_wide_extension()) u++;
     for (; l < u; l++) {
-      m_cells[l].character = ascii_sp;
-      m_cells[l].width = 1;
+      m_cells[l].set_character(ascii_sp);
+      m_cells[l].set_width(1);
     }
   };
 
@@ -662,15 +718,15 @@ void line_t::_mono_compose_segments(line_segment_t const* comp, int count, curpo
 
     switch (type) {
     case line_segment_erase:
-      fill.character = ascii_nul;
+      fill.set_character(ascii_nul);
       for (curpos_t p = x, pN = x + delta; p < pN; p++) m_cells[p] = fill;
       break;
     case line_segment_space:
-      fill.character = ascii_sp;
+      fill.set_character(ascii_sp);
       for (curpos_t p = x, pN = x + delta; p < pN; p++) m_cells[p] = fill;
       break;
     case line_segment_erase_unprotected:
-      fill.character = ascii_nul;
+      fill.set_character(ascii_nul);
       for (curpos_t p = x, pN = x + delta; p < pN; p++)
         if (!m_atable->is_protected(m_cells[p].attribute))
           m_cells[p] = fill;
@@ -682,17 +738,17 @@ void line_t::_mono_compose_segments(line_segment_t const* comp, int count, curpo
         curpos_t p = x, pN = x + delta;
 
         // 左境界上の全角文字
-        for (; p < (curpos_t) source_cells.size() && source_cells[p].character.is_wide_extension(); p++) {
-          m_cells[p].character = ascii_sp;
-          m_cells[p].width = 1;
+        for (; p < (curpos_t) source_cells.size() && source_cells[p].character().is_wide_extension(); p++) {
+          m_cells[p].set_character(ascii_sp);
+          m_cells[p].set_width(1);
         }
 
         // 右境界上の全角文字
-        if (pN < (curpos_t) source_cells.size() && source_cells[pN].character.is_wide_extension()) {
+        if (pN < (curpos_t) source_cells.size() && source_cells[pN].character().is_wide_extension()) {
           while (pN--) {
-            bool const hit = m_cells[pN].character.is_wide_extension();
-            m_cells[pN].character = ascii_sp;
-            m_cells[pN].width = 1;
+            bool const hit = m_cells[pN].character().is_wide_extension();
+            m_cells[pN].set_character(ascii_sp);
+            m_cells[pN].set_width(1);
             if (hit) break;
           }
         }
@@ -701,7 +757,7 @@ void line_t::_mono_compose_segments(line_segment_t const* comp, int count, curpo
           curpos_t const p1 = contra::clamp<curpos_t>(source_cells.size(), p, pN);
           if (p < p1) std::copy(source_cells.begin() + p, source_cells.begin() + p1, m_cells.begin() + p);
           if (p1 < pN) {
-            fill.character = ascii_nul;
+            fill.set_character(ascii_nul);
             fill.attribute = 0;
             std::fill(m_cells.begin() + p1, m_cells.begin() + pN, fill);
             fill.attribute = fill_attr;
@@ -721,13 +777,13 @@ void line_t::_mono_compose_segments(line_segment_t const* comp, int count, curpo
 
 void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpos_t width, attr_t const& fill_attr, bool line_r2l, bool dcsm) {
   cell_t fill;
-  fill.character = ascii_nul;
+  fill.set_character(ascii_nul);
   fill.attribute = 0;
-  fill.width = 1;
+  fill.set_width(1);
 
   cell_t mark;
   mark.attribute = 0;
-  mark.width = 0;
+  mark.set_width(0);
 
   std::vector<cell_t> cells;
   auto _fragment = [&cells, &fill] (line_t const* line, curpos_t xL, curpos_t xR) {
@@ -737,23 +793,23 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
     auto const [i2, x2] = line->_prop_glb(xR, false);
     if (i1 > i2) {
       // Note: 或る wide 文字の内部にいる時にここに来る。
-      fill.character = i2 < source_cells.size() && source_cells[i2].character.value != ascii_nul ? ascii_sp : ascii_nul;
+      fill.set_character(i2 < source_cells.size() && source_cells[i2].character().value != ascii_nul ? ascii_sp : ascii_nul);
       fill.attribute = 0;
       cells.insert(cells.end(), xR - xL, fill);
     } else {
       if (xL < x1) {
         mwg_assert(i1 > 0);
-        fill.character = source_cells[i1 - 1].character.value == ascii_nul ? ascii_nul : ascii_sp;
+        fill.set_character(source_cells[i1 - 1].character().value == ascii_nul ? ascii_nul : ascii_sp);
         fill.attribute = source_cells[i1 - 1].attribute;
         cells.insert(cells.end(), x1 - xL, fill);
       }
       cells.insert(cells.end(), source_cells.begin() + i1, source_cells.begin() + i2);
       if (x2 < xR) {
         if (i2 < source_cells.size()) {
-          fill.character = source_cells[i2].character.value == ascii_nul ? ascii_nul : ascii_sp;
+          fill.set_character(source_cells[i2].character().value == ascii_nul ? ascii_nul : ascii_sp);
           fill.attribute = source_cells[i2].attribute;
         } else {
-          fill.character = ascii_nul;
+          fill.set_character(ascii_nul);
           fill.attribute = 0;
         }
         cells.insert(cells.end(), xR - x2, fill);
@@ -777,14 +833,14 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
       std::size_t const insert_index = cells.size();
       istr = src->find_innermost_string(ranges[0].first, true, width, src_r2l);
       while (istr) {
-        mark.character = strings[istr].beg_marker;
+        mark.set_character(strings[istr].beg_marker);
         cells.insert(cells.begin() + insert_index, mark);
         istr = strings[istr].parent;
       }
 
       // 転送元と向きが異なる場合
       if (src_r2l != line_r2l) {
-        mark.character = marker_srs_beg;
+        mark.set_character(marker_srs_beg);
         cells.push_back(mark);
       }
 
@@ -793,17 +849,17 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
 
       // 転送元と向きが異なる場合
       if (src_r2l != line_r2l) {
-        mark.character = marker_srs_end;
+        mark.set_character(marker_srs_end);
         cells.push_back(mark);
       }
 
       // 文字列終端
       istr = src->find_innermost_string(ranges.back().second, false, width, src_r2l);
       while (istr) {
-        if (cells.size() && cells.back().character.value == strings[istr].beg_marker) {
+        if (cells.size() && cells.back().character().value == strings[istr].beg_marker) {
           cells.pop_back();
         } else {
-          mark.character = strings[istr].end_marker;
+          mark.set_character(strings[istr].end_marker);
           cells.push_back(mark);
         }
         istr = strings[istr].parent;
@@ -818,7 +874,7 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
     } else
       src->calculate_data_ranges_from_presentation_range(ranges, p1, p2, width, src_r2l);
 
-    fill.character = ascii_nul;
+    fill.set_character(ascii_nul);
     fill.attribute = fill_attr;
     if (ranges.size() != 0) {
       // 左右境界上の零幅文字は既に左右に取り込まれている筈なので無視。
@@ -840,7 +896,7 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
 
       // 転送元と向きが異なる場合
       if (src_r2l != line_r2l) {
-        mark.character = marker_srs_beg;
+        mark.set_character(marker_srs_beg);
         cells.push_back(mark);
       }
 
@@ -859,16 +915,16 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
           if (m_atable->is_protected(src_cells[i].attribute)) {
             if (xwrite < x) cells.insert(cells.end(), x - xwrite, fill);
             cells.push_back(src_cells[i]);
-            xwrite = x + src_cells[i].width;
+            xwrite = x + src_cells[i].width();
           }
-          x += src_cells[i].width;
+          x += src_cells[i].width();
         }
       }
       if (xwrite < p2) cells.insert(cells.end(), p2 - xwrite, fill);
 
       // 転送元と向きが異なる場合
       if (src_r2l != line_r2l) {
-        mark.character = marker_srs_end;
+        mark.set_character(marker_srs_end);
         cells.push_back(mark);
       }
     }
@@ -886,12 +942,12 @@ void line_t::_prop_compose_segments(line_segment_t const* comp, int count, curpo
       _slice(seg.source, seg.source_r2l, p1, p2);
       break;
     case line_segment_erase:
-      fill.character = ascii_nul;
+      fill.set_character(ascii_nul);
       fill.attribute = fill_attr;
       cells.insert(cells.end(), p2 - p1, fill);
       break;
     case line_segment_space:
-      fill.character = ascii_sp;
+      fill.set_character(ascii_sp);
       fill.attribute = fill_attr;
       cells.insert(cells.end(), p2 - p1, fill);
       break;
@@ -918,34 +974,34 @@ void line_t::_mono_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
   if (p1 >= p2) return;
 
   cell_t fill;
-  fill.character = ascii_nul;
+  fill.set_character(ascii_nul);
   fill.attribute = 0;
-  fill.width = 1;
+  fill.set_width(1);
   m_cells.resize((std::size_t) width, fill);
   fill.attribute = fill_attr;
 
   bool protect = false;
   auto _erase_wide_left = [this, &protect] (curpos_t p1) {
-    if (m_cells[p1].character.is_wide_extension()) {
+    if (m_cells[p1].character().is_wide_extension()) {
       if (protect && m_atable->is_protected(m_cells[p1].attribute)) return;
       curpos_t c = p1;
       if (c > 0) c--;
-      while (c > 0 && m_cells[c].character.is_wide_extension()) c--;
+      while (c > 0 && m_cells[c].character().is_wide_extension()) c--;
       for (; c < p1; c++) {
-        m_cells[c].character = ascii_sp;
-        m_cells[c].width = 1;
+        m_cells[c].set_character(ascii_sp);
+        m_cells[c].set_width(1);
       }
     }
   };
 
   auto _erase_wide_right = [this, &protect] (curpos_t p) {
-    if (p < (curpos_t) m_cells.size() && m_cells[p].character.is_wide_extension()) {
+    if (p < (curpos_t) m_cells.size() && m_cells[p].character().is_wide_extension()) {
       if (protect && m_atable->is_protected(m_cells[p].attribute)) return;
       do {
-        m_cells[p].character = ascii_sp;
-        m_cells[p].width = 1;
+        m_cells[p].set_character(ascii_sp);
+        m_cells[p].set_width(1);
         p++;
-      } while (p < (curpos_t) m_cells.size() && m_cells[p].character.is_wide_extension());
+      } while (p < (curpos_t) m_cells.size() && m_cells[p].character().is_wide_extension());
     }
   };
 
@@ -1003,7 +1059,7 @@ void line_t::_bdsm_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
       curpos_t const x1 = convert_position(false, p1, -1, width, line_r2l);
       auto [i, x] = _prop_glb(x1, false);
       if (x < x1 && i < m_cells.size() && m_atable->is_protected(m_cells[i].attribute)) {
-        curpos_t const xL = x, xR = x + m_cells[i].width;
+        curpos_t const xL = x, xR = x + m_cells[i].width();
         if (x1 - xL == xR - x1) {
           p1 -= x1 - xL;
         } else {
@@ -1020,7 +1076,7 @@ void line_t::_bdsm_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
       curpos_t const x2 = convert_position(false, p2, -1, width, line_r2l);
       auto [i, x] = _prop_glb(x2, false);
       if (x < x2 && i < m_cells.size() && m_atable->is_protected(m_cells[i].attribute)) {
-        curpos_t const xL = x, xR = x + m_cells[i].width;
+        curpos_t const xL = x, xR = x + m_cells[i].width();
         if (xR - x2 == x2 - xL) {
           p2 += xR - x2;
         } else {
@@ -1065,9 +1121,9 @@ void line_t::_prop_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
   if (p1 >= p2) return;
 
   cell_t fill;
-  fill.character = ascii_nul;
+  fill.set_character(ascii_nul);
   fill.attribute = 0;
-  fill.width = 1;
+  fill.set_width(1);
 
   // 行の長さの調整
   {
@@ -1075,10 +1131,10 @@ void line_t::_prop_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
     curpos_t x1;
     std::tie(i1, x1) = _prop_glb(width, false);
     m_cells.resize((std::size_t) (i1 + width - x1), fill);
-    if (x1 < width && m_cells[i1].width > 1) {
-      int const w = m_cells[i1].width;
-      m_cells[i1].character = ascii_sp;
-      m_cells[i1].width = 1;
+    if (x1 < width && m_cells[i1].width() > 1) {
+      int const w = m_cells[i1].width();
+      m_cells[i1].set_character(ascii_sp);
+      m_cells[i1].set_width(1);
       for (int i = 1; i < w; i++)
         m_cells[i1 + i] = m_cells[i1];
     }
@@ -1105,12 +1161,12 @@ void line_t::_prop_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
   if (std::abs(shift) >= p2 - p1) {
     if ((flags & lshift_erm_protect) && has_protected_cells()) {
       if (w1 && m_atable->is_protected(m_cells[i1].attribute)) {
-        p1 += m_cells[i1].width - w1;
+        p1 += m_cells[i1].width() - w1;
         w1 = 0;
         i1++;
       }
       if (w2 && m_atable->is_protected(m_cells[i2 - 1].attribute)) {
-        p2 -= m_cells[i2].width - w2;
+        p2 -= m_cells[i2].width() - w2;
         w2 = 0;
         i2--;
       }
@@ -1121,7 +1177,7 @@ void line_t::_prop_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
       for (curpos_t i = p1; i < p2; i++) {
         if (m_atable->is_protected(m_cells[i].attribute)) {
           protected_count++;
-          total_protected_width += m_cells[i].width;
+          total_protected_width += m_cells[i].width();
         }
       }
 
@@ -1162,17 +1218,17 @@ void line_t::_prop_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
 
     auto _erase_unprotected = [&] () {
       i += wlfill;
-      fill.character = ascii_nul;
+      fill.set_character(ascii_nul);
       fill.attribute = fill_attr;
       auto src = std::remove_if(m_cells.begin() + i1, m_cells.begin() + i2,
-        [&] (auto const& cell) { return !m_atable->is_protected(cell.attribute) && cell.width == 0; });
+        [&] (auto const& cell) { return !m_atable->is_protected(cell.attribute) && cell.width() == 0; });
       auto dst = m_cells.begin() + i;
       while (src-- != m_cells.begin()) {
         if (m_atable->is_protected(src->attribute)) {
           if (--dst != src)
             *dst = std::move(*src);
         } else {
-          std::size_t w = src->width;
+          std::size_t w = src->width();
           while (w--) *--dst = fill;
         }
       }
@@ -1193,13 +1249,13 @@ void line_t::_prop_shift_cells(curpos_t p1, curpos_t p2, curpos_t shift, line_sh
     // 余白の書き込み
     auto _write_space = [&] (curpos_t w, attr_t const& attr) {
       if (w <= 0) return;
-      fill.character = ascii_sp;
+      fill.set_character(ascii_sp);
       fill.attribute = attr;
       do m_cells[i++] = fill; while (--w);
     };
     auto _write_fill = [&] (curpos_t w) {
       if (w <= 0) return;
-      fill.character = ascii_nul;
+      fill.set_character(ascii_nul);
       fill.attribute = fill_attr;
       do m_cells[i++] = fill; while (--w);
     };
@@ -1231,18 +1287,18 @@ bool line_t::set_selection(curpos_t x1, curpos_t x2, bool trunc, bool gatm, bool
   auto _unset = [&dirty, &x] (cell_t& cell) {
     dirty |= cell.attribute;
     cell.attribute &= ~attr_selected;
-    x += cell.width;
+    x += cell.width();
   };
   auto _set = [&dirty, &x] (cell_t& cell) {
     dirty |= ~cell.attribute;
     cell.attribute |= attr_selected;
-    x += cell.width;
+    x += cell.width();
   };
   auto _guarded = [gatm, this] (cell_t const& cell) {
     return !gatm && m_atable->is_guarded(cell.attribute);
   };
   auto _truncated = [trunc] (cell_t const& cell) {
-    return trunc && (cell.character.value == ascii_nul || cell.character.value == ascii_sp);
+    return trunc && (cell.character().value == ascii_nul || cell.character().value == ascii_sp);
   };
 
   std::size_t const iN = m_cells.size();
@@ -1250,7 +1306,7 @@ bool line_t::set_selection(curpos_t x1, curpos_t x2, bool trunc, bool gatm, bool
   if (x1 < x2) {
     while (i < iN && x < x1)
       _unset(m_cells[i++]);
-    while (i < iN && x == x1 && m_cells[i].character.is_extension())
+    while (i < iN && x == x1 && m_cells[i].character().is_extension())
       _unset(m_cells[i++]);
 
     // Note: 選択範囲の末尾空白類は選択範囲から除外する。
@@ -1258,11 +1314,11 @@ bool line_t::set_selection(curpos_t x1, curpos_t x2, bool trunc, bool gatm, bool
     std::size_t i_ = i;
     curpos_t x_ = x;
     std::size_t end = 0;
-    while (i_ < iN && x_ + (curpos_t) m_cells[i_].width <= x2) {
+    while (i_ < iN && x_ + (curpos_t) m_cells[i_].width() <= x2) {
       auto& cell = m_cells[i_++];
       if (!_guarded(cell) && !_truncated(cell))
         end = i_; // 最後の選択されるセル(の次の位置)
-      x_ += cell.width;
+      x_ += cell.width();
     }
     while (end > 0 && m_cells[end - 1].is_zero_width_body()) end--;
 
@@ -1291,10 +1347,10 @@ bool line_t::set_selection_word(curpos_t x, word_selection_type type, bool gatm)
   if (x >= ncell || _guarded(m_cells[x])) return false;
 
   auto _isspace = [] (cell_t const& cell) {
-    return cell.character.value == ascii_nul || cell.character.value == ascii_sp;
+    return cell.character().value == ascii_nul || cell.character().value == ascii_sp;
   };
   auto _isalpha = [] (cell_t const& cell) {
-    std::uint32_t code = cell.character.value;
+    std::uint32_t code = cell.character().value;
     return code == ascii_underscore ||
       (ascii_0 <= code && code <= ascii_9) ||
       (ascii_A <= code && code <= ascii_Z) ||
@@ -1305,14 +1361,14 @@ bool line_t::set_selection_word(curpos_t x, word_selection_type type, bool gatm)
   auto _range = [&, this] (curpos_t x, auto predicate) {
     curpos_t x1 = x;
     for (curpos_t x1p = x; --x1p >= 0 && !_guarded(m_cells[x1p]); ) {
-      if (m_cells[x1p].character.is_extension()) continue;
+      if (m_cells[x1p].character().is_extension()) continue;
       if (predicate(m_cells[x1p])) x1 = x1p;
       else break;
     }
 
     curpos_t x2 = x + 1;
     for (curpos_t x2p = x + 1; x2p < ncell && !_guarded(m_cells[x2p]); x2p++) {
-      if (predicate(m_cells[x2p]) || m_cells[x2p].character.is_extension()) x2 = x2p + 1;
+      if (predicate(m_cells[x2p]) || m_cells[x2p].character().is_extension()) x2 = x2p + 1;
       else break;
     }
 
@@ -1338,7 +1394,7 @@ curpos_t line_t::extract_selection(std::u32string& data) const {
   std::vector<char32_t> buff;
   for (cell_t const& cell : this->m_cells) {
     if (cell.attribute & attr_selected) {
-      if (cell.character.get_unicode_representation(buff)) {
+      if (cell.character().get_unicode_representation(buff)) {
         if (data.empty())
           head_x = space_count;
         else
@@ -1349,12 +1405,329 @@ curpos_t line_t::extract_selection(std::u32string& data) const {
           if (value == ascii_nul) value = U' ';
         data.append(buff.begin(), buff.end());
 
-        if ((m_atable->xflags(cell.attribute) & xflags_decdhl_mask) && cell.width / 2)
-          data.append(cell.width / 2, U' ');
+        if ((m_atable->xflags(cell.attribute) & xflags_decdhl_mask) && cell.width() / 2)
+          data.append(cell.width() / 2, U' ');
         continue;
       }
     }
-    space_count += cell.width;
+    space_count += cell.width();
   }
   return head_x;
 }
+
+void line_t::reflow(line_t const* lines, std::size_t count, curpos_t width, std::vector<line_t>& result, std::uint32_t& next_id, curpos_t* cursor_y, curpos_t* cursor_x) {
+  mwg_assert(count && width > 0);
+  attr_table* const atable = lines[0].m_atable;
+  line_attr_t const lflags = lines[0].m_lflags & ~lattr_wrapped;
+  bool const wrapped = (bool) (lines[count - 1].m_lflags & lattr_wrapped);
+
+  // 各行の末尾の未使用のセルを除いて連結する。
+  // Note: 全角文字が行末に収まらなかった時に残る空白も除かれる。
+  static thread_local std::vector<cell_t> joined;
+  joined.clear();
+  std::size_t cursor_offset = (std::size_t) -1;
+  for (std::size_t i = 0; i < count; i++) {
+    std::vector<cell_t> const& cells = lines[i].m_cells;
+    std::size_t size = cells.size();
+    while (size && cells[size - 1].character().value == ascii_nul && cells[size - 1].attribute == 0) size--;
+    if (cursor_y && (std::size_t) *cursor_y == i)
+      cursor_offset = joined.size() + (i + 1 < count ? std::min<std::size_t>(*cursor_x, size) : *cursor_x);
+    joined.insert(joined.end(), cells.begin(), cells.begin() + size);
+  }
+
+  std::size_t const result_begin = result.size();
+  auto _push_line = [&] {
+    std::size_t const index = result.size() - result_begin;
+    line_t& line = result.emplace_back(atable);
+    line.m_lflags = lflags | lattr_wrapped;
+    if (index < count) {
+      line.m_id = lines[index].m_id;
+      line.m_version = lines[index].m_version + 1;
+    } else {
+      line.m_id = next_id++;
+    }
+    line.m_cells.reserve(width);
+    return &line;
+  };
+
+  line_t* line = _push_line();
+  curpos_t x = 0;
+  std::size_t const joined_size = joined.size();
+  for (std::size_t i = 0; i < joined_size; ) {
+    // 全角文字は継続部分と一緒に移す。
+    std::size_t j = i + 1;
+    while (j < joined_size && joined[j].character().is_wide_extension()) j++;
+    curpos_t const w = j - i;
+    if (x && x + w > width) {
+      line = _push_line();
+      x = 0;
+    }
+    if (cursor_offset - i < (std::size_t) w) {
+      *cursor_y = result.size() - result_begin - 1;
+      *cursor_x = x + (cursor_offset - i);
+    }
+    line->m_cells.insert(line->m_cells.end(), joined.begin() + i, joined.begin() + j);
+    x += w;
+    i = j;
+  }
+
+  // カーソルが内容の後にある時は最後の行に置く。
+  if (cursor_offset != (std::size_t) -1 && cursor_offset >= joined_size) {
+    *cursor_y = result.size() - result_begin - 1;
+    *cursor_x = std::min<curpos_t>(x + (cursor_offset - joined_size), width - 1);
+  }
+
+  if (!wrapped) line->m_lflags &= ~lattr_wrapped;
+}
+
+//-----------------------------------------------------------------------------
+// line_block_t
+
+// セルの符号 (先頭 byte)
+//   0x00-0x7F  幅 1 の ASCII 文字
+//   0x80       幅 0 の charflag_wide_extension
+//   0x81       直前のセルの繰り返し (LEB128 で回数が続く)
+//   0x84-0x87  文字幅 0, 1, 2, 4 の一般の文字 (LEB128 で文字が続く)
+namespace contra {
+namespace ansi {
+namespace {
+  constexpr byte block_code_wide_extension = 0x80;
+  constexpr byte block_code_repeat         = 0x81;
+  constexpr byte block_code_character      = 0x84;
+
+  void block_put_uint(std::vector<byte>& text, std::uint32_t value) {
+    while (value >= 0x80) {
+      text.push_back(byte(value | 0x80));
+      value >>= 7;
+    }
+    text.push_back(byte(value));
+  }
+  std::uint32_t block_get_uint(byte const*& p) {
+    std::uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+      byte const b = *p++;
+      value |= std::uint32_t(b & 0x7F) << shift;
+      if (!(b & 0x80)) return value;
+    }
+  }
+
+  void block_put_cell(std::vector<byte>& text, std::uint32_t code, std::uint32_t width) {
+    if (code < 0x80 && width == 1) {
+      text.push_back(byte(code));
+    } else if (code == charflag_wide_extension && width == 0) {
+      text.push_back(block_code_wide_extension);
+    } else {
+      text.push_back(byte(block_code_character + (width == 4 ? 3 : width)));
+      block_put_uint(text, code);
+    }
+  }
+}
+}
+}
+
+void line_block_t::freeze(line_t const* lines, std::size_t count) {
+  mwg_assert(count <= capacity);
+  m_headers.clear();
+  m_text.clear();
+  m_runs.clear();
+  m_has_selection = false;
+
+  // Note: 行ブロックは長期間保持されるので最終的な大きさちょうどに確保し直す。
+  //   符号化は再利用する一時領域で行う。
+  static thread_local std::vector<byte> text;
+  static thread_local std::vector<attribute_run_t> runs;
+  text.clear();
+  runs.clear();
+
+  m_headers.reserve(count);
+  for (std::size_t i = 0; i < count; i++) {
+    line_t const& line = lines[i];
+    std::vector<cell_t> const& cells = line.m_cells;
+    std::size_t const ncell = cells.size();
+
+    for (std::size_t k = 0; k < ncell; ) {
+      std::uint32_t const code = cells[k].character().value;
+      std::uint32_t const width = cells[k].width();
+      block_put_cell(text, code, width);
+      std::size_t l = k + 1;
+      while (l < ncell && cells[l].character().value == code && cells[l].width() == width) l++;
+      if (l - k > 2) {
+        text.push_back(block_code_repeat);
+        block_put_uint(text, l - k - 1);
+      } else if (l - k == 2) {
+        block_put_cell(text, code, width);
+      }
+      k = l;
+    }
+
+    std::size_t const run_begin = runs.size();
+    for (cell_t const& cell : cells) {
+      if (runs.size() > run_begin && runs.back().attribute == cell.attribute)
+        runs.back().count++;
+      else
+        runs.push_back({cell.attribute, 1});
+      if (cell.attribute & attr_selected) m_has_selection = true;
+    }
+
+    line_header_t header;
+    header.id = line.m_id;
+    header.version = line.m_version;
+    header.lflags = line.m_lflags;
+    header.home = line.m_home;
+    header.limit = line.m_limit;
+    header.cell_count = ncell;
+    header.text_end = text.size();
+    header.run_end = runs.size();
+    header.prop_enabled = line.m_prop_enabled;
+    m_headers.push_back(header);
+  }
+
+  m_text.assign(text.begin(), text.end());
+  m_runs.assign(runs.begin(), runs.end());
+  m_text.shrink_to_fit();
+  m_runs.shrink_to_fit();
+}
+
+void line_block_t::thaw(std::size_t index, line_t& line) const {
+  mwg_assert(index < m_headers.size());
+  line_header_t const& header = m_headers[index];
+  std::uint32_t const text_begin = index ? m_headers[index - 1].text_end : 0;
+  std::uint32_t const run_begin = index ? m_headers[index - 1].run_end : 0;
+
+  std::vector<cell_t>& cells = line.m_cells;
+  cells.resize(header.cell_count);
+
+  byte const* p = m_text.data() + text_begin;
+  byte const* const pN = m_text.data() + header.text_end;
+  std::size_t k = 0;
+  while (p < pN) {
+    byte const b = *p++;
+    if (b == block_code_repeat) {
+      mwg_assert(k > 0);
+      cell_t const prev = cells[k - 1];
+      for (std::uint32_t n = block_get_uint(p); n--; ) cells[k++] = prev;
+      continue;
+    }
+
+    cell_t& cell = cells[k++];
+    if (b < 0x80) {
+      cell.set_character(b);
+      cell.set_width(1);
+    } else if (b == block_code_wide_extension) {
+      cell.set_character(charflag_wide_extension);
+      cell.set_width(0);
+    } else {
+      std::uint32_t const wcode = b - block_code_character;
+      cell.set_character(block_get_uint(p));
+      cell.set_width(wcode == 3 ? 4 : wcode);
+    }
+  }
+  mwg_assert(k == header.cell_count);
+
+  k = 0;
+  for (std::uint32_t r = run_begin; r < header.run_end; r++)
+    for (std::uint32_t n = m_runs[r].count; n--; )
+      cells[k++].attribute = m_runs[r].attribute;
+
+  line.m_lflags = header.lflags;
+  line.m_home = header.home;
+  line.m_limit = header.limit;
+  line.m_prop_enabled = header.prop_enabled;
+  line.m_prop_i = 0;
+  line.m_prop_x = 0;
+  line.m_id = header.id;
+  line.m_version = header.version;
+  line.m_strings_version = (std::uint32_t) -1;
+  line.m_order_version = (std::uint32_t) -1;
+}
+
+// 直列化の形式
+//   record_header_t, line_header_t[line_count], byte[text_size],
+//   attribute_run_t[run_count], attribute_t[dict_count]
+// attribute_run_t の拡張属性は attr_extended | (attr_selected) | 辞書の添字 に置き換える。
+namespace contra {
+namespace ansi {
+namespace {
+  struct block_record_header_t {
+    std::uint32_t line_count;
+    std::uint32_t text_size;
+    std::uint32_t run_count;
+    std::uint32_t dict_count;
+  };
+
+  template<typename T>
+  void block_append(std::vector<byte>& buffer, T const* data, std::size_t count) {
+    byte const* p = reinterpret_cast<byte const*>(data);
+    buffer.insert(buffer.end(), p, p + sizeof(T) * count);
+  }
+}
+}
+}
+
+void line_block_t::serialize(std::vector<byte>& buffer, attr_table const& atable) const {
+  std::vector<attribute_run_t> runs(m_runs);
+  std::vector<attribute_t> dict;
+  std::unordered_map<std::uint32_t, std::uint32_t> dict_index;
+  for (attribute_run_t& run : runs) {
+    if (!(run.attribute & attr_extended)) continue;
+    std::uint32_t const ref = (std::uint32_t) (run.attribute & attr_extended_refmask);
+    auto const [it, inserted] = dict_index.emplace(ref, (std::uint32_t) dict.size());
+    if (inserted) dict.push_back(atable.extended(run.attribute));
+    run.attribute = attr_extended | (run.attribute & attr_selected) | it->second;
+  }
+
+  block_record_header_t const header = {
+    (std::uint32_t) m_headers.size(), (std::uint32_t) m_text.size(),
+    (std::uint32_t) runs.size(), (std::uint32_t) dict.size() };
+  block_append(buffer, &header, 1);
+  block_append(buffer, m_headers.data(), m_headers.size());
+  block_append(buffer, m_text.data(), m_text.size());
+  block_append(buffer, runs.data(), runs.size());
+  block_append(buffer, dict.data(), dict.size());
+}
+
+bool line_block_t::deserialize(byte const* data, std::size_t size, attr_table& atable) {
+  block_record_header_t header;
+  if (size < sizeof header) return false;
+  std::memcpy(&header, data, sizeof header);
+  std::size_t const total = sizeof header
+    + sizeof(line_header_t) * header.line_count + header.text_size
+    + sizeof(attribute_run_t) * header.run_count + sizeof(attribute_t) * header.dict_count;
+  if (size != total || header.line_count > capacity) return false;
+
+  byte const* p = data + sizeof header;
+  m_headers.resize(header.line_count);
+  std::memcpy(m_headers.data(), p, sizeof(line_header_t) * header.line_count);
+  p += sizeof(line_header_t) * header.line_count;
+  m_text.assign(p, p + header.text_size);
+  p += header.text_size;
+  m_runs.resize(header.run_count);
+  std::memcpy(m_runs.data(), p, sizeof(attribute_run_t) * header.run_count);
+  p += sizeof(attribute_run_t) * header.run_count;
+
+  std::vector<attr_t> dict;
+  dict.reserve(header.dict_count);
+  for (std::uint32_t i = 0; i < header.dict_count; i++) {
+    attribute_t attribute;
+    std::memcpy(&attribute, p, sizeof attribute);
+    p += sizeof attribute;
+    dict.push_back(atable.save(attribute));
+  }
+
+  m_has_selection = false;
+  for (attribute_run_t& run : m_runs) {
+    if (run.attribute & attr_extended) {
+      std::uint32_t const index = (std::uint32_t) (run.attribute & attr_extended_refmask);
+      if (index >= dict.size()) return false;
+      run.attribute = dict[index] | (run.attribute & attr_selected);
+    }
+    if (run.attribute & attr_selected) m_has_selection = true;
+  }
+  return true;
+}
+
+std::uint32_t line_block_t::serialized_id(byte const* data, std::size_t index) {
+  line_header_t header;
+  std::memcpy(&header, data + sizeof(block_record_header_t) + sizeof(line_header_t) * index, sizeof header);
+  return header.id;
+}
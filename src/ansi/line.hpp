@@ -4,6 +4,7 @@
 #include <mwg/except.h>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <algorithm>
 #include <tuple>
@@ -67,26 +68,207 @@ namespace ansi {
     }
   };
 
+  /*?lwiki
+   * @class cell_t
+   *   文字 (character_t)、文字幅、属性 (attr_t) を 8 byte に詰めて保持する。
+   *   文字幅は character_t で使われていない bit 22-23 に格納する。
+   *   文字幅として取り得る値は 0, 1, 2, 4 だけである
+   *   (4 は DECDWL 相当の属性で全角文字を書いた時)。
+   */
   struct cell_t {
-    character_t   character;
-    attr_t       attribute = 0;
-    std::uint32_t width;
+  private:
+    static constexpr int           width_shift = 22;
+    static constexpr std::uint32_t width_mask  = 3u << width_shift;
+    static constexpr std::uint32_t encode_width(std::uint32_t width) {
+      return (width == 4 ? 3 : width) << width_shift;
+    }
+
+    std::uint32_t m_code = 0;
+
+  public:
+    attr_t attribute = 0;
 
     cell_t() {}
     constexpr cell_t(std::uint32_t c):
-      character(c),
-      width(character.is_extension() || character.is_marker() ? 0 : 1) {}
+      m_code(c | encode_width(character_t(c).is_extension() || character_t(c).is_marker() ? 0 : 1)) {}
+
+  public:
+    constexpr character_t character() const { return m_code & ~width_mask; }
+    void set_character(character_t const& character) {
+      mwg_assert(!(character.value & width_mask));
+      m_code = (m_code & width_mask) | character.value;
+    }
+
+    constexpr std::uint32_t width() const {
+      std::uint32_t const code = (m_code & width_mask) >> width_shift;
+      return code == 3 ? 4 : code;
+    }
+    void set_width(std::uint32_t width) {
+      mwg_assert(width <= 2 || width == 4, "width=%u", width);
+      m_code = (m_code & ~width_mask) | encode_width(width);
+    }
 
     bool operator==(cell_t const& rhs) const {
-      return character == rhs.character && attribute == rhs.attribute && width == rhs.width;
+      return m_code == rhs.m_code && attribute == rhs.attribute;
     }
     bool operator!=(cell_t const& rhs) const { return !(*this == rhs); }
 
     bool is_zero_width_body() const {
-      return width == 0 && !character.is_extension();
+      return width() == 0 && !character().is_extension();
+    }
+  };
+  static_assert(sizeof(cell_t) == 8, "cell_t is expected to be packed in 8 bytes");
+
+  /*?lwiki
+   * @class cell_columns_t
+   *   セル列を Structure of Arrays 形式で保持する。
+   *   文字と文字幅はそれぞれ連続した配列に保持し、属性は連長圧縮する。
+   *   属性の走査は連の数に比例し、文字の比較は memcmp で塊ごとに行える。
+   */
+  class cell_columns_t {
+  public:
+    struct attribute_run_t {
+      attr_t attribute;
+      std::uint32_t end;
+    };
+
+  private:
+    std::vector<character_t> m_characters;
+    std::vector<std::uint8_t> m_widths;
+    std::vector<attribute_run_t> m_runs;
+
+  public:
+    std::size_t size() const { return m_characters.size(); }
+    bool empty() const { return m_characters.empty(); }
+    void clear() {
+      m_characters.clear();
+      m_widths.clear();
+      m_runs.clear();
+    }
+    void swap(cell_columns_t& other) {
+      m_characters.swap(other.m_characters);
+      m_widths.swap(other.m_widths);
+      m_runs.swap(other.m_runs);
+    }
+
+    void assign(cell_t const* beg, cell_t const* end) {
+      std::size_t const count = end - beg;
+      m_characters.resize(count);
+      m_widths.resize(count);
+      m_runs.clear();
+      for (std::size_t i = 0; i < count; i++) {
+        m_characters[i] = beg[i].character();
+        m_widths[i] = beg[i].width();
+        if (m_runs.empty() || m_runs.back().attribute != beg[i].attribute)
+          m_runs.push_back({beg[i].attribute, (std::uint32_t) i + 1});
+        else
+          m_runs.back().end = i + 1;
+      }
+    }
+
+  public:
+    character_t character(std::size_t index) const { return m_characters[index]; }
+    std::uint32_t width(std::size_t index) const { return m_widths[index]; }
+    attr_t attribute(std::size_t index) const {
+      auto const it = std::upper_bound(m_runs.begin(), m_runs.end(), index,
+        [] (std::size_t index, attribute_run_t const& run) { return index < run.end; });
+      return it->attribute;
+    }
+    std::vector<attribute_run_t> const& runs() const { return m_runs; }
+    std::vector<attribute_run_t>& runs() { return m_runs; }
+
+  private:
+    template<typename T>
+    static std::size_t _common_prefix(T const* a, T const* b, std::size_t count) {
+      constexpr std::size_t block = 64 / sizeof(T);
+      std::size_t i = 0;
+      while (i + block <= count && std::memcmp(a + i, b + i, sizeof(T) * block) == 0) i += block;
+      while (i < count && a[i] == b[i]) i++;
+      return i;
+    }
+
+  public:
+    /*?lwiki
+     * @fn static std::size_t common_prefix(a, b);
+     *   先頭から一致するセルの数を返す。
+     *   文字と文字幅は配列の比較、属性は連の比較で求める。
+     */
+    static std::size_t common_prefix(cell_columns_t const& a, cell_columns_t const& b) {
+      std::size_t count = std::min(a.size(), b.size());
+      count = _common_prefix(a.m_characters.data(), b.m_characters.data(), count);
+      count = _common_prefix(a.m_widths.data(), b.m_widths.data(), count);
+
+      std::size_t pos = 0, ia = 0, ib = 0;
+      while (pos < count) {
+        attribute_run_t const& ra = a.m_runs[ia];
+        attribute_run_t const& rb = b.m_runs[ib];
+        if (ra.attribute != rb.attribute) return pos;
+        pos = std::min(ra.end, rb.end);
+        if (ra.end == pos) ia++;
+        if (rb.end == pos) ib++;
+      }
+      return count;
     }
   };
 
+  /*?lwiki
+   * @class line_storage_aos
+   * @class line_storage_soa
+   *   描画側で行の内容を保持する形式 (frame_snapshot_t や差分検出で使う)。
+   *   line_storage_aos は cell_t の配列、line_storage_soa は cell_columns_t を使う。
+   *   コンパイル時に contra_ansi_line_storage_soa を定義すると
+   *   line_storage として line_storage_soa が選択される。
+   *
+   *   Note: line_t 自体の編集用の記憶域は cell_t の配列のままである。
+   *     line.cpp の編集操作は連続したセル列を前提としている為。
+   */
+  struct line_storage_aos {
+    typedef std::vector<cell_t> buffer_type;
+
+    static void assign(buffer_type& buffer, std::vector<cell_t>& cells) { buffer.swap(cells); }
+    static std::size_t size(buffer_type const& buffer) { return buffer.size(); }
+    static character_t character(buffer_type const& buffer, std::size_t index) { return buffer[index].character(); }
+    static std::uint32_t width(buffer_type const& buffer, std::size_t index) { return buffer[index].width(); }
+    static attr_t attribute(buffer_type const& buffer, std::size_t index) { return buffer[index].attribute; }
+    static bool equals(buffer_type const& a, std::size_t i, buffer_type const& b, std::size_t j) { return a[i] == b[j]; }
+    static std::size_t common_prefix(buffer_type const& a, buffer_type const& b) {
+      std::size_t const count = std::min(a.size(), b.size());
+      std::size_t i = 0;
+      while (i < count && a[i] == b[i]) i++;
+      return i;
+    }
+    template<typename F>
+    static void for_each_attribute(buffer_type& buffer, F f) {
+      for (cell_t& cell : buffer) f(cell.attribute);
+    }
+  };
+
+  struct line_storage_soa {
+    typedef cell_columns_t buffer_type;
+
+    static void assign(buffer_type& buffer, std::vector<cell_t>& cells) { buffer.assign(cells.data(), cells.data() + cells.size()); }
+    static std::size_t size(buffer_type const& buffer) { return buffer.size(); }
+    static character_t character(buffer_type const& buffer, std::size_t index) { return buffer.character(index); }
+    static std::uint32_t width(buffer_type const& buffer, std::size_t index) { return buffer.width(index); }
+    static attr_t attribute(buffer_type const& buffer, std::size_t index) { return buffer.attribute(index); }
+    static bool equals(buffer_type const& a, std::size_t i, buffer_type const& b, std::size_t j) {
+      return a.character(i) == b.character(j) && a.width(i) == b.width(j) && a.attribute(i) == b.attribute(j);
+    }
+    static std::size_t common_prefix(buffer_type const& a, buffer_type const& b) {
+      return cell_columns_t::common_prefix(a, b);
+    }
+    template<typename F>
+    static void for_each_attribute(buffer_type& buffer, F f) {
+      for (auto& run : buffer.runs()) f(run.attribute);
+    }
+  };
+
+#ifdef contra_ansi_line_storage_soa
+  typedef line_storage_soa line_storage;
+#else
+  typedef line_storage_aos line_storage;
+#endif
+
   //---------------------------------------------------------------------------
   // line_attr_t
 
@@ -114,6 +296,14 @@ namespace ansi {
   constexpr line_attr_t lattr_ltor = 0x0004;
   constexpr line_attr_t lattr_charpath_mask = lattr_rtol | lattr_ltor;
 
+  // bit 3
+  /*?lwiki
+   * @const lattr_wrapped
+   * 自動改行により次の行に続いている事を表す。
+   * 端末の幅が変わった時にこのフラグで繋がった行を折り返し直す。
+   */
+  constexpr line_attr_t lattr_wrapped = 0x0008;
+
   // bit 6-7: DECDHL, DECDWL, DECSWL
   // The same values are used as in `xflags_t`.
   // The related constants are defined in `enum extended_flags`.
@@ -224,6 +414,16 @@ namespace ansi {
     mutable bool m_strings_r2l = false;
     mutable std::uint32_t m_strings_version = (std::uint32_t) -1;
 
+    // ordered_cells の結果のキャッシュ。
+    // m_order_identity の時は m_cells をそのまま返すので m_order_cache は使わない。
+    mutable std::vector<cell_t> m_order_cache;
+    mutable std::uint32_t m_order_version = (std::uint32_t) -1;
+    mutable curpos_t m_order_width = 0;
+    mutable int m_order_key = 0;
+    mutable bool m_order_identity = false;
+
+    friend class line_block_t;
+
   public:
     line_t(attr_table* atable): m_atable(atable) {}
 
@@ -242,11 +442,37 @@ namespace ansi {
 
       // invalidate cache
       this->m_strings_version = -1;
+      this->m_order_version = -1;
       line.m_cells.clear();
       line.m_prop_enabled = false;
       line.m_strings_version = -1;
     }
 
+    // 描画用の複製 (term_t::copy_frame) を作る。
+    // 拡張属性は複製先の m_atable に登録し直すので、元の attr_table とは独立に GC できる。
+    void copy_frame_from(line_t const& line, attr_table const* source_atable) {
+      m_cells        = line.m_cells;
+      m_lflags       = line.m_lflags;
+      m_home         = line.m_home;
+      m_limit        = line.m_limit;
+      m_prop_enabled = line.m_prop_enabled;
+      m_prop_i       = line.m_prop_i;
+      m_prop_x       = line.m_prop_x;
+      m_id           = line.m_id;
+      m_version      = line.m_version;
+      if (m_atable != source_atable) {
+        for (cell_t& cell : m_cells) {
+          if (!(cell.attribute & attr_extended)) continue;
+          attr_t const selected = cell.attribute & attr_selected;
+          cell.attribute = m_atable->save(source_atable->extended(cell.attribute)) | selected;
+        }
+      }
+
+      // invalidate cache
+      this->m_strings_version = -1;
+      this->m_order_version = -1;
+    }
+
   public:
     std::vector<cell_t>& cells() { return m_cells; }
     std::vector<cell_t> const& cells() const { return m_cells; }
@@ -272,14 +498,19 @@ namespace ansi {
         if (m_atable->is_blinking(cell.attribute)) return true;
       return false;
     }
+    bool has_decdhl_cells() const {
+      for (cell_t const& cell : m_cells)
+        if (m_atable->xflags(cell.attribute) & xflags_decdhl_mask) return true;
+      return false;
+    }
 
   private:
     void _initialize_content(curpos_t width, attr_t const& attr) {
       if (attr == 0) return;
       cell_t fill;
-      fill.character = ascii_nul;
+      fill.set_character(ascii_nul);
       fill.attribute = attr;
-      fill.width = 1;
+      fill.set_width(1);
       this->m_cells.resize(width, fill);
     }
 
@@ -313,6 +544,10 @@ namespace ansi {
     void gc_mark() {
       for (auto& cell : m_cells)
         m_atable->mark(&cell.attribute);
+      // Note: compaction で属性の値が変わるのでキャッシュも mark する。
+      if (m_order_version == m_version && !m_order_identity)
+        for (auto& cell : m_order_cache)
+          m_atable->mark(&cell.attribute);
     }
 
   private:
@@ -322,19 +557,20 @@ namespace ansi {
       this->m_version++;
       this->m_cells.erase(
         std::remove_if(m_cells.begin(), m_cells.end(),
-          [] (cell_t const& cell) { return cell.character.is_wide_extension(); }),
+          [] (cell_t const& cell) { return cell.character().is_wide_extension(); }),
         m_cells.end());
       this->m_prop_i = 0;
       this->m_prop_x = 0;
     }
 
   private:
+    void _mono_splice_cells(curpos_t xL, curpos_t xR, curpos_t width);
     void _mono_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const* cell, int count, int repeat, curpos_t width, int implicit_move);
     void _mono_write_cells(curpos_t x, cell_t const* cell, int count, int repeat, int implicit_move) {
       curpos_t width = 0;
       bool flag_zw = false;
       for (int i = 0; i < count; i++) {
-        curpos_t const w = cell[i].width;
+        curpos_t const w = cell[i].width();
         if (w == 0) flag_zw = true;
         width += w;
       }
@@ -350,7 +586,7 @@ namespace ansi {
       curpos_t width = 0;
       bool flag_zw = false;
       for (int i = 0; i < count; i++) {
-        curpos_t const w = cell[i].width;
+        curpos_t const w = cell[i].width();
         if (w == 0) flag_zw = true;
         width += w;
       }
@@ -384,7 +620,7 @@ namespace ansi {
         x = m_prop_x;
       }
       while (i < ncell) {
-        curpos_t xnew = x + m_cells[i].width;
+        curpos_t xnew = x + m_cells[i].width();
         if (xdst < xnew) break;
         ++i;
         x = xnew;
@@ -413,8 +649,8 @@ namespace ansi {
         if (!include_zw_body && x == xdst)
           while (i > 0 && m_cells[i - 1].is_zero_width_body()) i--;
       }
-      while (i < ncell && x < xdst) x += m_cells[i++].width;
-      while (i < ncell && m_cells[i].character.is_extension()) i++;
+      while (i < ncell && x < xdst) x += m_cells[i++].width();
+      while (i < ncell && m_cells[i].character().is_extension()) i++;
       if (include_zw_body && x == xdst)
         while (i < ncell && m_cells[i].is_zero_width_body()) i++;
       m_prop_i = i;
@@ -424,14 +660,14 @@ namespace ansi {
     void _prop_generic_replace_cells(curpos_t xL, curpos_t xR, cell_t const* cell, int count, int repeat, curpos_t width, int implicit_move);
     void _prop_write_cells(curpos_t pos, cell_t const* cell, int count, int repeat, int implicit_move) {
       curpos_t width = 0;
-      for (int i = 0; i < count; i++) width += cell[i].width;
+      for (int i = 0; i < count; i++) width += cell[i].width();
       width *= repeat;
       curpos_t const left = pos, right = pos + width;
       _prop_generic_replace_cells(left, right, cell, count, repeat, width, implicit_move);
     }
     void _prop_replace_cells(curpos_t x1, curpos_t x2, cell_t const* cell, int count, int repeat, int implicit_move) {
       curpos_t width = 0;
-      for (int i = 0; i < count; i++) width += cell[i].width;
+      for (int i = 0; i < count; i++) width += cell[i].width();
       width *= repeat;
       _prop_generic_replace_cells(x1, x2, cell, count, repeat, width, implicit_move);
     }
@@ -446,6 +682,13 @@ namespace ansi {
       else
         _mono_write_cells(x, cell, count, repeat, implicit_move);
     }
+    /*?lwiki
+     * @fn void write_ascii_cells(curpos_t x, byte const* beg, byte const* end, attr_t const& attr);
+     *   印字可能 ASCII 文字の列を幅 1 の文字として位置 x から書き込みます。
+     *   `write_cells(x, cells, n, 1, 1)` と同じ効果ですが、
+     *   等幅の行では cell_t の一時配列を経由せず m_cells に直接書き込みます。
+     */
+    void write_ascii_cells(curpos_t x, byte const* beg, byte const* end, attr_t const& attr);
     void insert_cells(curpos_t x, cell_t const* cell, int count, int repeat) {
       if (m_prop_enabled)
         _prop_replace_cells(x, x, cell, count, repeat, 0);
@@ -473,7 +716,7 @@ namespace ansi {
       std::reverse(m_cells.begin(), m_cells.end());
       for (auto cell = m_cells.begin(), cellM = m_cells.end() - 1; cell < cellM; ++cell) {
         auto beg = cell;
-        while (cell < cellM && cell->character.is_wide_extension()) ++cell;
+        while (cell < cellM && cell->character().is_wide_extension()) ++cell;
         if (cell != beg) std::iter_swap(beg, cell);
       }
 
@@ -495,15 +738,15 @@ namespace ansi {
     character_t char_at(curpos_t x) const {
       if (!m_prop_enabled) {
         if (x < 0 || (std::size_t) x >= m_cells.size()) return ascii_nul;
-        //while (x > 0 && m_cells[x].character.is_extension()) x--;
-        return m_cells[x].character;
+        //while (x > 0 && m_cells[x].character().is_extension()) x--;
+        return m_cells[x].character();
       } else {
         std::size_t i1;
         curpos_t x1;
         std::tie(i1, x1) = _prop_glb(x, false);
         if (i1 >= m_cells.size()) return ascii_nul;
         if (x1 < x) return charflag_wide_extension;
-        return m_cells[i1].character;
+        return m_cells[i1].character();
       }
     }
 
@@ -583,9 +826,25 @@ namespace ansi {
     }
 
   private:
+    void _mono_order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const;
     void _prop_order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const;
+    bool _is_identity_order(position_type to, curpos_t width, bool line_r2l) const;
   public:
-    void order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const;
+    /*?lwiki
+     * @fn std::vector<cell_t> const& ordered_cells(position_type to, curpos_t width, bool line_r2l) const;
+     *   表示順に並べたセルの列 (order_cells_in の結果) を返します。
+     *   結果は行の版 (version), to, width, line_r2l が同じ間キャッシュします。
+     *   左から右の等幅の行で全角文字を含まず幅に収まる時は並べ替えが不要なので、
+     *   複製せずに行のセルの列そのものを返します。
+     *   返した参照は行の内容を変更するまで有効です。
+     * @fn void order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const;
+     *   ordered_cells の結果を buff に複製します。
+     */
+    std::vector<cell_t> const& ordered_cells(position_type to, curpos_t width, bool line_r2l) const;
+    void order_cells_in(std::vector<cell_t>& buff, position_type to, curpos_t width, bool line_r2l) const {
+      std::vector<cell_t> const& cells = ordered_cells(to, width, line_r2l);
+      buff.assign(cells.begin(), cells.end());
+    }
 
   public:
     typedef std::vector<std::pair<curpos_t, curpos_t>> slice_ranges_t;
@@ -684,6 +943,24 @@ namespace ansi {
      */
     curpos_t extract_selection(std::u32string& data) const;
 
+  public:
+    /*?lwiki
+     * @fn bool is_reflowable() const;
+     *   行を折り返し直す事ができるかどうかを返します。
+     *   プロポーショナルの行、文字進行方向や行頭・行末を持つ行は折り返し直しません。
+     *   DECDWL/DECDHL の文字を含む行も上下の半分の対応や表示幅が崩れるので折り返し直しません。
+     * @fn static void reflow(line_t const* lines, std::size_t count, curpos_t width, std::vector<line_t>& result, std::uint32_t& next_id, curpos_t* cursor_y = nullptr, curpos_t* cursor_x = nullptr);
+     *   lattr_wrapped で繋がった count 行の内容を幅 width で折り返し直して result の末尾に追加します。
+     *   最後の行の lattr_wrapped はそのまま引き継ぎます。
+     *   新しい行には元の行の id を先頭から順に割り当て、足りない分は next_id から割り当てます。
+     * @param[in,out] cursor_y, cursor_x
+     *   lines 内の位置を指定した時、折り返し後の result 内の相対位置に変換します。
+     */
+    bool is_reflowable() const {
+      return !m_prop_enabled && !(m_lflags & lattr_charpath_mask) && m_home < 0 && m_limit < 0 && !has_decdhl_cells();
+    }
+    static void reflow(line_t const* lines, std::size_t count, curpos_t width, std::vector<line_t>& result, std::uint32_t& next_id, curpos_t* cursor_y = nullptr, curpos_t* cursor_x = nullptr);
+
   public:
     void debug_string_nest(FILE* file, curpos_t width, presentation_direction_t board_charpath) const {
       bool const line_r2l = is_r2l(board_charpath);
@@ -723,8 +1000,8 @@ namespace ansi {
   public:
     void debug_dump(FILE* file) const {
       for (cell_t const& cell : m_cells) {
-        std::uint32_t code = cell.character.value;
-        if (cell.character.is_marker()) {
+        std::uint32_t code = cell.character().value;
+        if (cell.character().is_marker()) {
           switch (code) {
           case marker_sds_l2r: std::fprintf(file, "\x1b[91mSDS(1)\x1b[m"); break;
           case marker_sds_r2l: std::fprintf(file, "\x1b[91mSDS(2)\x1b[m"); break;
@@ -743,6 +1020,137 @@ namespace ansi {
     }
   };
 
+  /*?lwiki
+   * @class line_buffer_pool
+   *   スクロールバッファから破棄された行のセルの領域を保持し、
+   *   盤面に新しく現れる行 (board_t::initialize_lines) で再利用する。
+   *   定常的なスクロールでセルの領域の確保が起こらない様にする。
+   *   新しい確保は暖機の間 (保持する行が容量に達するまで) に限られる。
+   *
+   * @fn void release(line_t& line);
+   *   line のセルの領域を回収する。line のセルは空になる。
+   * @fn void prepare(line_t& line, curpos_t width);
+   *   line が width 個のセルを再確保なしに保持できる様にする。
+   *   回収した領域に十分な大きさの物がなければ新しく確保し、allocation_count に数える。
+   * @fn void set_max_buffers(std::size_t value);
+   *   保持する領域の数の上限を設定する。上限を超えて回収した領域は解放する。
+   *   一度に回収する行の数より小さいと、解放した分を次の行で確保し直す事になる。
+   */
+  class line_buffer_pool {
+    std::vector<std::vector<cell_t>> m_buffers;
+    std::size_t m_max_buffers = default_max_buffers;
+    std::size_t m_allocation_count = 0;
+    std::size_t m_recycle_count = 0;
+
+  public:
+    static constexpr std::size_t default_max_buffers = 256;
+
+    void set_max_buffers(std::size_t value) {
+      m_max_buffers = value;
+      if (m_buffers.size() > value) m_buffers.resize(value);
+    }
+    void release(line_t& line) {
+      std::vector<cell_t>& cells = line.cells();
+      if (cells.capacity() == 0 || m_buffers.size() >= m_max_buffers) return;
+      if (m_buffers.capacity() < m_max_buffers) m_buffers.reserve(m_max_buffers);
+      cells.clear();
+      m_buffers.emplace_back(std::move(cells));
+      cells.clear();
+    }
+    void prepare(line_t& line, curpos_t width) {
+      std::vector<cell_t>& cells = line.cells();
+      if (cells.capacity() >= (std::size_t) width) return;
+      while (m_buffers.size()) {
+        // Note: 大きさの足りない領域は端末の幅が拡大される前に回収した物なので捨てる。
+        std::vector<cell_t> buffer = std::move(m_buffers.back());
+        m_buffers.pop_back();
+        if (buffer.capacity() >= (std::size_t) width) {
+          buffer.assign(cells.begin(), cells.end());
+          cells.swap(buffer);
+          m_recycle_count++;
+          return;
+        }
+      }
+      cells.reserve(width);
+      m_allocation_count++;
+    }
+
+    std::size_t size() const { return m_buffers.size(); }
+    std::size_t allocation_count() const { return m_allocation_count; }
+    std::size_t recycle_count() const { return m_recycle_count; }
+  };
+
+  /*?lwiki
+   * @class line_block_t
+   *   スクロールバッファの古い行を凍結して保持する読み取り専用のブロック。
+   *   最大 line_block_t::capacity 行をまとめて保持する。
+   *
+   *   文字と文字幅は 1 セル 1-6 byte の可変長で符号化する。
+   *   ASCII 文字は 1 byte、同じセルの繰り返しはまとめて 1 つの符号にする。
+   *   属性は行毎に連長圧縮して attr_t のまま保持する。
+   *   これにより GC は凍結した行を展開せずに attr_table::mark できる。
+   *
+   * @fn void freeze(line_t const* lines, std::size_t count);
+   *   count 行の内容を符号化して保持する。以前の内容は破棄する。
+   * @fn void thaw(std::size_t index, line_t& line) const;
+   *   index 番目の行を line に復元する。行の id と version も復元する。
+   *
+   * @fn void serialize(std::vector<byte>& buffer, attr_table const& atable) const;
+   *   ファイルに書き出す為に buffer の末尾に直列化する。
+   *   拡張属性は attr_table の添字ではなく attribute_t の値として書き出す。
+   * @fn bool deserialize(byte const* data, std::size_t size, attr_table& atable);
+   *   serialize で書き出した内容を読み込む。拡張属性は atable に登録し直す。
+   * @fn static std::uint32_t serialized_id(byte const* data, std::size_t index);
+   *   直列化した内容から index 番目の行の id を読み取る。
+   */
+  class line_block_t {
+  public:
+    static constexpr std::size_t capacity = 64;
+
+  private:
+    struct line_header_t {
+      std::uint32_t id;
+      std::uint32_t version;
+      line_attr_t lflags = 0;
+      curpos_t home;
+      curpos_t limit;
+      std::uint32_t cell_count;
+      std::uint32_t text_end;
+      std::uint32_t run_end;
+      bool prop_enabled;
+    };
+    struct attribute_run_t {
+      attr_t attribute = 0;
+      std::uint32_t count;
+    };
+
+    std::vector<line_header_t> m_headers;
+    std::vector<byte> m_text;
+    std::vector<attribute_run_t> m_runs;
+    bool m_has_selection = false;
+
+  public:
+    std::size_t size() const { return m_headers.size(); }
+    std::uint32_t id(std::size_t index) const { return m_headers[index].id; }
+    bool has_selection() const { return m_has_selection; }
+    std::size_t memory_usage() const {
+      return sizeof(*this) + m_headers.capacity() * sizeof(line_header_t)
+        + m_text.capacity() + m_runs.capacity() * sizeof(attribute_run_t);
+    }
+
+    void freeze(line_t const* lines, std::size_t count);
+    void thaw(std::size_t index, line_t& line) const;
+
+    void serialize(std::vector<byte>& buffer, attr_table const& atable) const;
+    bool deserialize(byte const* data, std::size_t size, attr_table& atable);
+    static std::uint32_t serialized_id(byte const* data, std::size_t index);
+
+    void gc_mark(attr_table* atable) {
+      for (auto& run : m_runs)
+        atable->mark(&run.attribute);
+    }
+  };
+
   struct cursor_t {
   private:
     curpos_t m_x = 0, m_y = 0;
@@ -462,9 +462,9 @@ namespace ansi {
     std::tuple<double, double, double> get_displacement(font_t font) const {
       double dx = 0, dy = 0, dxW = 0;
       if (font & (font_layout_mask | font_decdwl | font_flag_italic)) {
-        // Note: 横のずれ量は dxI + dxW * cell.width である。
+        // Note: 横のずれ量は dxI + dxW * cell.width() である。
         // これを実際には幅1の時の値 dx = dxI + dxW を分離して、
-        // ずれ量 = dx + dxW * (cell.width - 1) と計算する。
+        // ずれ量 = dx + dxW * (cell.width() - 1) と計算する。
 
         double dxI = 0;
         if (font & font_layout_sup)
@@ -1404,7 +1404,7 @@ namespace ansi {
             bg0 = bg1;
             x0 = x;
           }
-          x += cell.width * xunit;
+          x += cell.width() * xunit;
         }
         _fill();
       }
@@ -1475,7 +1475,7 @@ namespace ansi {
           // 文字的な図形 (フォントと同様の変形を受ける)
           font_metric_t fmetric(xunit, yunit);
           auto [dx, dy, dxW] = fmetric.get_displacement(font);
-          coord_t const x = x1 + std::round(dx + dxW * cell.width);
+          coord_t const x = x1 + std::round(dx + dxW * cell.width());
           coord_t const y = y1 + std::round(dy);
           auto [w, h] = fmetric.get_font_size(font);
 
@@ -1525,7 +1525,7 @@ namespace ansi {
         color_t const fg = _color.resolve_fg(attr);
         font_t const font = _font.resolve_font(attr);
         m_str.start(font);
-        m_str.push(code, cell.width);
+        m_str.push(code, cell.width());
         this->clip(font, y1);
         m_str.render(g, x1, y1, font, fg);
         this->unclip(font);
@@ -1535,22 +1535,22 @@ namespace ansi {
         coord_t x1, coord_t y1, cell_t const& cell,
         std::vector<cell_t>& cells, std::size_t& i, coord_t& x
       ) {
-        std::uint32_t code = cell.character.value;
+        std::uint32_t code = cell.character().value;
         code &= ~charflag_cluster_extension;
         auto const& attr = cell.attribute;
         color_t const fg = _color.resolve_fg(attr);
         font_t const font = _font.resolve_font(attr);
         m_str.start(font);
-        m_str.push(code, cell.width);
+        m_str.push(code, cell.width());
 
         // 同じ色・フォントのセルは同時に描画してしまう。
         for (std::size_t j = i; j < cells.size(); j++) {
           auto const& cell2 = cells[j];
-          std::uint32_t code2 = cell2.character.value;
+          std::uint32_t code2 = cell2.character().value;
 
           // 回転文字の場合は一つずつ書かなければならない。
           // 零幅の cluster などだけ一緒に描画する。
-          if ((font & font_rotation_mask) && cell2.width) break;
+          if ((font & font_rotation_mask) && cell2.width()) break;
 
           bool const is_cluster = code2 & charflag_cluster_extension;
           color_t const fg2 = _color.resolve_fg(cell2.attribute);
@@ -1558,23 +1558,23 @@ namespace ansi {
           code2 &= ~charflag_cluster_extension;
           if (!_visible(code2, cell2.attribute, font & font_layout_proportional)) {
             if (font & font_layout_proportional) break;
-            m_str.skip(cell2.width);
+            m_str.skip(cell2.width());
           } else if (!character_t::is_char(code2)) {
-            m_str.skip(cell2.width);
+            m_str.skip(cell2.width());
             continue;
           } else if (is_cluster || (fg == fg2 && font == font2)) {
-            m_str.push(code2, cell2.width);
+            m_str.push(code2, cell2.width());
           } else {
             if (font & font_layout_proportional) break;
-            m_str.skip(cell2.width);
+            m_str.skip(cell2.width());
             continue;
           }
 
           if (i == j) {
             i++;
-            x += cell2.width * xunit;
+            x += cell2.width() * xunit;
           } else
-            cells[j].character.value |= flag_processed;
+            cells[j].set_character(cells[j].character().value | flag_processed);
         }
 
         this->clip(font, y1);
@@ -1589,7 +1589,7 @@ namespace ansi {
         coord_t x1, coord_t y1, cell_t const& cell,
         std::vector<cell_t>& cells, std::size_t& i, coord_t& x
       ) {
-        std::uint32_t const code = cell.character.value;
+        std::uint32_t const code = cell.character().value;
         std::uint32_t const cssize = code2cssize(code);
         std::uint32_t const cs = code2charset(code, cssize);
 
@@ -1610,18 +1610,18 @@ namespace ansi {
         color_t const fg = _color.resolve_fg(attr);
         font_t const font = _font.resolve_font(attr);
         m_str.start(font);
-        m_str.push(vec[0], cell.width);
+        m_str.push(vec[0], cell.width());
         for (std::size_t k = 1; k < vec.size(); k++)
           m_str.push(vec[k], 0);
 
         // 同じ文字集合・同じ色・フォントのセルは同時に描画する。
         for (std::size_t j = i; j < cells.size(); j++) {
           auto const& cell2 = cells[j];
-          std::uint32_t code2 = cell2.character.value;
+          std::uint32_t code2 = cell2.character().value;
 
           // 回転文字の場合は一つずつ書かなければならない。
           // 零幅の cluster などだけ一緒に描画する。
-          if ((font & font_rotation_mask) && cell2.width) break;
+          if ((font & font_rotation_mask) && cell2.width()) break;
 
           bool const is_cluster = code2 & charflag_cluster_extension;
           bool const cs2 = code2charset(code2);
@@ -1633,7 +1633,7 @@ namespace ansi {
           if (!_visible(code2, cell2.attribute, font & font_layout_proportional)) {
             goto discard;
           } else if (is_cluster) {
-            m_str.push(code2, cell2.width);
+            m_str.push(code2, cell2.width());
             goto processed;
           } else if (is_same_charset && fg == fg2 && font == font2) {
             iso2022_charset const* charset2 = iso2022.charset(cs2);
@@ -1641,13 +1641,13 @@ namespace ansi {
               goto process_later;
             } else if (vec.size() == 1 && is_iso2022_mosaic(vec[0])) {
               draw_iso2022_graphics(x1 + m_str.x(), y1, vec[0], cell2);
-              m_str.skip(cell2.width);
+              m_str.skip(cell2.width());
               goto processed;
             } else if (vec.empty()) {
               goto discard;
             }
 
-            m_str.push(vec[0], cell.width);
+            m_str.push(vec[0], cell.width());
             for (std::size_t k = 1; k < vec.size(); k++)
               m_str.push(vec[k], 0);
             goto processed;
@@ -1658,20 +1658,20 @@ namespace ansi {
 
         discard:
           if (font & font_layout_proportional) break;
-          m_str.skip(cell2.width);
+          m_str.skip(cell2.width());
           goto processed;
 
         process_later:
           if (font & font_layout_proportional) break;
-          m_str.skip(cell2.width);
+          m_str.skip(cell2.width());
           continue;
 
         processed:
           if (i == j) {
             i++;
-            x += cell2.width * xunit;
+            x += cell2.width() * xunit;
           } else
-            cells[j].character.value |= flag_processed;
+            cells[j].set_character(cells[j].character().value | flag_processed);
         }
 
         this->clip(font, y1);
@@ -1713,9 +1713,9 @@ namespace ansi {
             coord_t const x1 = x;
             coord_t const& y1 = y;
             i++;
-            x += cell.width * xunit;
+            x += cell.width() * xunit;
 
-            std::uint32_t code = cell.character.value;
+            std::uint32_t code = cell.character().value;
             if (!_visible(code, cell.attribute)) continue;
 
             if (character_t::is_char(code)) {
@@ -1726,7 +1726,7 @@ namespace ansi {
           }
 
           // clear private flags
-          for (cell_t& cell : cells) cell.character.value &= ~flag_processed;
+          for (cell_t& cell : cells) cell.set_character(cell.character().value & ~flag_processed);
         }
       }
     };
@@ -1755,16 +1755,16 @@ namespace ansi {
         charbuff.clear();
         charbuff.reserve(cells.size());
         for (auto const& cell : cells) {
-          std::uint32_t code = cell.character.value;
+          std::uint32_t code = cell.character().value;
           if (code & charflag_cluster_extension)
             code &= ~charflag_cluster_extension;
           if (code == ascii_nul || code == ascii_sp) {
             if (charbuff.empty())
-              xoffset += cell.width * xunit;
+              xoffset += cell.width() * xunit;
             else
-              charbuff.shift(cell.width * xunit);
+              charbuff.shift(cell.width() * xunit);
           } else if (code == (code & unicode_mask)) {
-            charbuff.add_char(code, cell.width * xunit);
+            charbuff.add_char(code, cell.width() * xunit);
           }
           // ToDo: その他の文字・マーカーに応じた処理。
         }
@@ -1995,11 +1995,11 @@ namespace ansi {
 
         for (std::size_t i = 0; i < cells.size(); ) {
           auto const& cell = cells[i++];
-          auto const& code = cell.character.value;
+          auto const& code = cell.character().value;
           aflags_t const aflags = view.atable()->aflags(cell.attribute);
           xflags_t const xflags = view.atable()->xflags(cell.attribute);
-          if (cell.width == 0) continue;
-          coord_t const cell_width = cell.width * xunit;
+          if (cell.width() == 0) continue;
+          coord_t const cell_width = cell.width() * xunit;
           color_t color = 0;
           if (code != ascii_nul && !(aflags & invisible_flags))
             color = _color.resolve_dc(cell.attribute);
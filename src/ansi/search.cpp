@@ -0,0 +1,326 @@
+#include "search.hpp"
+#include <algorithm>
+#include <iterator>
+#include <mwg/except.h>
+
+using namespace contra::ansi;
+
+namespace contra {
+namespace ansi {
+namespace {
+  constexpr char32_t search_fold(char32_t c) {
+    return U'A' <= c && c <= U'Z' ? c + (U'a' - U'A') : c;
+  }
+
+  std::uint32_t search_trigram(char32_t a, char32_t b, char32_t c) {
+    std::uint32_t h = 2166136261u;
+    auto _mix = [&h] (std::uint32_t value) { h = (h ^ value) * 16777619u; };
+    _mix(search_fold(a));
+    _mix(search_fold(b));
+    _mix(search_fold(c));
+    return h;
+  }
+
+  void search_put_uint(std::vector<byte>& data, std::uint64_t value) {
+    while (value >= 0x80) {
+      data.push_back(byte(value | 0x80));
+      value >>= 7;
+    }
+    data.push_back(byte(value));
+  }
+  void search_put_uint(byte*& p, std::uint64_t value) {
+    while (value >= 0x80) {
+      *p++ = byte(value | 0x80);
+      value >>= 7;
+    }
+    *p++ = byte(value);
+  }
+  std::uint64_t search_get_uint(byte const*& p) {
+    std::uint64_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+      byte const b = *p++;
+      value |= std::uint64_t(b & 0x7F) << shift;
+      if (!(b & 0x80)) return value;
+    }
+  }
+
+  static_assert(sizeof(wchar_t) >= sizeof(char32_t), "search_pattern: wchar_t should hold a code point");
+
+  // char32_t の列を wchar_t の列として std::wregex に渡す。文字列を複製せずに照合する為に使う。
+  class search_wchar_iterator {
+    char32_t const* m_ptr = nullptr;
+
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef wchar_t value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef wchar_t const* pointer;
+    typedef wchar_t reference;
+
+    search_wchar_iterator() {}
+    explicit search_wchar_iterator(char32_t const* ptr): m_ptr(ptr) {}
+    char32_t const* base() const { return m_ptr; }
+
+    wchar_t operator*() const { return (wchar_t) *m_ptr; }
+    search_wchar_iterator& operator++() { ++m_ptr; return *this; }
+    search_wchar_iterator operator++(int) { return search_wchar_iterator(m_ptr++); }
+    search_wchar_iterator& operator--() { --m_ptr; return *this; }
+    search_wchar_iterator operator--(int) { return search_wchar_iterator(m_ptr--); }
+    bool operator==(search_wchar_iterator const& other) const { return m_ptr == other.m_ptr; }
+    bool operator!=(search_wchar_iterator const& other) const { return m_ptr != other.m_ptr; }
+  };
+
+
+  // 正規表現が一致する文字列に必ず含まれる部分文字列の内、最長の物を求める。
+  // Note: 最上位の | を含む場合や括弧の中は考慮しない (空文字列を返すか括弧の外だけを見る)。
+  std::u32string search_regex_literal(std::u32string const& pattern) {
+    std::u32string best, current;
+    auto _flush = [&] {
+      if (current.size() > best.size()) best = current;
+      current.clear();
+    };
+
+    std::size_t const n = pattern.size();
+    for (std::size_t i = 0; i < n; ) {
+      char32_t c = pattern[i++];
+      bool literal = false;
+      switch (c) {
+      case U'|':
+        return std::u32string();
+      case U'(':
+        {
+          // 括弧の中は読み飛ばす
+          int level = 1;
+          while (i < n && level) {
+            char32_t const d = pattern[i++];
+            if (d == U'\\') i++;
+            else if (d == U'(') level++;
+            else if (d == U')') level--;
+          }
+          _flush();
+          continue;
+        }
+      case U'[':
+        if (i < n && pattern[i] == U'^') i++;
+        if (i < n && pattern[i] == U']') i++;
+        while (i < n && pattern[i] != U']') {
+          if (pattern[i] == U'\\') i++;
+          i++;
+        }
+        i++;
+        _flush();
+        continue;
+      case U'\\':
+        if (i >= n) return std::u32string();
+        c = pattern[i++];
+        // \d, \w, \b, \1 等は文字でないので区切りとして扱う。
+        // \xHH, \uHHHH, \cX は引数も読み飛ばす (引数を文字として拾わない為)。
+        literal = !(U'0' <= c && c <= U'9') && !(U'a' <= c && c <= U'z') && !(U'A' <= c && c <= U'Z');
+        if (c == U'x')
+          i = std::min(i + 2, n);
+        else if (c == U'u')
+          i = std::min(i + 4, n);
+        else if (c == U'c')
+          i = std::min(i + 1, n);
+        break;
+      case U'{':
+        // 量指定子 {n,m} の中は読み飛ばす
+        while (i < n && pattern[i] != U'}') i++;
+        if (i < n) i++;
+        _flush();
+        continue;
+      case U'^': case U'$': case U'.': case U'?': case U'*': case U'+':
+      case U'}': case U')': case U']':
+        literal = false;
+        break;
+      default:
+        literal = true;
+        break;
+      }
+
+      if (!literal) {
+        _flush();
+        continue;
+      }
+
+      // 直後に量指定子がある場合、この文字は省略可能かも知れない。
+      if (i < n && (pattern[i] == U'?' || pattern[i] == U'*' || pattern[i] == U'{')) {
+        _flush();
+        continue;
+      }
+      current += c;
+      if (i < n && pattern[i] == U'+') _flush();
+    }
+    _flush();
+    return best;
+  }
+}
+}
+}
+
+//-----------------------------------------------------------------------------
+// line_text
+
+void contra::ansi::line_text(line_t const& line, std::u32string& text, std::vector<curpos_t>* positions) {
+  text.clear();
+  if (positions) positions->clear();
+  static thread_local std::vector<char32_t> buff;
+  curpos_t x = 0;
+  for (cell_t const& cell : line.cells()) {
+    character_t const c = cell.character();
+    if (!c.is_wide_extension() && !c.is_marker() && c.get_unicode_representation(buff)) {
+      for (char32_t u : buff) {
+        text += u == ascii_nul ? U' ' : u;
+        if (positions) positions->push_back(x);
+      }
+    }
+    x += cell.width();
+  }
+  if (positions) positions->push_back(x);
+}
+
+//-----------------------------------------------------------------------------
+// search_pattern
+
+bool search_pattern::compile(std::u32string const& pattern, int flags) {
+  m_pattern = pattern;
+  m_flags = flags;
+  if (flags & search_regex) {
+    std::wstring const wpattern(pattern.begin(), pattern.end());
+    auto options = std::regex::ECMAScript | std::regex::optimize;
+    if (flags & search_icase) options |= std::regex::icase;
+    try {
+      m_regex.assign(wpattern, options);
+    } catch (std::regex_error&) {
+      m_pattern.clear();
+      m_literal.clear();
+      return false;
+    }
+    m_literal = search_regex_literal(pattern);
+  } else {
+    m_literal = pattern;
+  }
+  return true;
+}
+
+bool search_pattern::find(std::u32string const& text, std::size_t offset, std::size_t& begin, std::size_t& end) const {
+  if (m_pattern.empty() || offset > text.size()) return false;
+
+  if (!(m_flags & search_regex)) {
+    auto const _eq = [icase = m_flags & search_icase] (char32_t a, char32_t b) {
+      return icase ? search_fold(a) == search_fold(b) : a == b;
+    };
+    auto const it = std::search(text.begin() + offset, text.end(), m_pattern.begin(), m_pattern.end(), _eq);
+    if (it == text.end()) return false;
+    begin = it - text.begin();
+    end = begin + m_pattern.size();
+    return true;
+  }
+
+  char32_t const* const data = text.data();
+  std::match_results<search_wchar_iterator> m;
+  auto const flags = offset ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+  if (!std::regex_search(search_wchar_iterator(data + offset), search_wchar_iterator(data + text.size()), m, m_regex, flags)) return false;
+  begin = m[0].first.base() - data;
+  end = m[0].second.base() - data;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// text_search_index
+
+void text_search_index::add(std::u32string const& text) {
+  std::uint64_t const group = m_end++ / group_size;
+  for (std::size_t i = 2; i < text.size(); i++) {
+    posting_t& posting = m_postings[search_trigram(text[i - 2], text[i - 1], text[i])];
+    if (posting.last == group + 1) continue;
+    if (posting.data.empty()) posting.data.reserve(posting_initial_capacity);
+    search_put_uint(posting.data, group + 1 - posting.last);
+    posting.last = group + 1;
+    posting.count++;
+  }
+}
+
+void text_search_index::drop_front(std::size_t count) {
+  m_begin = std::min(m_begin + count, m_end);
+
+  // 破棄したグループが半分を超えたら postings から取り除く。
+  std::uint64_t const first_group = m_begin / group_size;
+  std::uint64_t const last_group = (m_end + group_size - 1) / group_size;
+  if (first_group - m_compacted_group > last_group - first_group) compact();
+}
+
+void text_search_index::compact() {
+  std::uint64_t const first_group = m_begin / group_size;
+  for (auto it = m_postings.begin(); it != m_postings.end(); ) {
+    posting_t& posting = it->second;
+    if (posting.last <= first_group) {
+      it = m_postings.erase(it);
+      continue;
+    }
+
+    // Note: 差分の和の符号長は各差分の符号長の和を超えないので、読み取り位置の手前に上書きできる。
+    //   領域を確保し直さない様に同じ領域の中で詰める。
+    std::uint32_t count = 0;
+    std::uint64_t value = 0, prev = 0;
+    byte const* p = posting.data.data();
+    byte const* const pN = p + posting.data.size();
+    byte* q = posting.data.data();
+    while (p < pN) {
+      value += search_get_uint(p);
+      if (value - 1 < first_group) continue;
+      search_put_uint(q, value - prev);
+      prev = value;
+      count++;
+    }
+    posting.data.resize(q - posting.data.data());
+    posting.count = count;
+    ++it;
+  }
+  m_compacted_group = first_group;
+}
+
+bool text_search_index::candidates(std::u32string const& literal, std::vector<std::uint64_t>& groups) const {
+  groups.clear();
+  if (literal.size() < 3) return false;
+
+  // 出現の少ない trigram から順に積集合を取る。
+  std::vector<posting_t const*> postings;
+  for (std::size_t i = 2; i < literal.size(); i++) {
+    auto const it = m_postings.find(search_trigram(literal[i - 2], literal[i - 1], literal[i]));
+    if (it == m_postings.end()) return true;
+    postings.push_back(&it->second);
+  }
+  std::sort(postings.begin(), postings.end(),
+    [] (posting_t const* a, posting_t const* b) { return a->count < b->count; });
+  postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+
+  std::uint64_t const first_group = m_begin / group_size;
+  auto _decode = [first_group] (posting_t const& posting, std::vector<std::uint64_t>& result) {
+    result.clear();
+    std::uint64_t value = 0;
+    byte const* p = posting.data.data();
+    byte const* const pN = p + posting.data.size();
+    while (p < pN) {
+      value += search_get_uint(p);
+      if (value - 1 >= first_group) result.push_back(value - 1);
+    }
+  };
+
+  _decode(*postings[0], groups);
+  std::vector<std::uint64_t> other, merged;
+  for (std::size_t k = 1; k < postings.size() && groups.size(); k++) {
+    _decode(*postings[k], other);
+    merged.clear();
+    std::set_intersection(groups.begin(), groups.end(), other.begin(), other.end(), std::back_inserter(merged));
+    groups.swap(merged);
+  }
+  return true;
+}
+
+std::size_t text_search_index::memory_usage() const {
+  std::size_t result = sizeof(*this);
+  for (auto const& [key, posting] : m_postings)
+    result += sizeof(key) + sizeof(posting) + posting.data.capacity() + sizeof(void*) * 2;
+  return result;
+}
@@ -0,0 +1,109 @@
+// -*- mode: c++; indent-tabs-mode: nil -*-
+#ifndef contra_ansi_search_hpp
+#define contra_ansi_search_hpp
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <regex>
+#include <unordered_map>
+#include "../contradef.hpp"
+#include "line.hpp"
+
+namespace contra {
+namespace ansi {
+
+  /*?lwiki
+   * @fn void line_text(line_t const& line, std::u32string& text, std::vector<curpos_t>* positions = nullptr);
+   *   行の内容を検索用の文字列に変換する。
+   *   全角文字の継続部分やマーカーは除き、NUL は空白にする。
+   *   positions を指定した時は各文字のデータ位置を格納する (末尾にはデータ部の幅を追加する)。
+   */
+  void line_text(line_t const& line, std::u32string& text, std::vector<curpos_t>* positions = nullptr);
+
+  enum search_flags {
+    search_regex = 0x1, // パターンを正規表現 (ECMAScript) として扱う
+    search_icase = 0x2, // 大文字・小文字を区別しない
+  };
+
+  /*?lwiki
+   * @class search_pattern
+   *   検索パターン。索引による候補の絞り込みに使う部分文字列 (literal) を保持する。
+   *
+   * @fn bool compile(std::u32string const& pattern, int flags);
+   *   パターンを解析する。正規表現が不正な時に false を返す。
+   * @fn bool find(std::u32string const& text, std::size_t offset, std::size_t& begin, std::size_t& end) const;
+   *   text の offset 以降で最初の一致を探し、一致範囲を [begin, end) に設定する。
+   *   正規表現の場合は空の一致もあり得る。
+   * @fn std::u32string const& literal() const;
+   *   一致する文字列が必ず含む部分文字列。分からない時は空文字列。
+   */
+  class search_pattern {
+    std::u32string m_pattern;
+    std::u32string m_literal;
+    int m_flags = 0;
+    // Note: 正規表現は文字単位で照合する為に std::wregex を使う (wchar_t は 32 bit を仮定)。
+    std::wregex m_regex;
+
+  public:
+    bool compile(std::u32string const& pattern, int flags);
+    bool find(std::u32string const& text, std::size_t offset, std::size_t& begin, std::size_t& end) const;
+    std::u32string const& literal() const { return m_literal; }
+    int flags() const { return m_flags; }
+    bool empty() const { return m_pattern.empty(); }
+  };
+
+  /*?lwiki
+   * @class text_search_index
+   *   スクロールバッファの行に対する trigram 索引。
+   *   行は追加順に通し番号 (seq) で管理し、group_size 行毎のグループを単位として
+   *   各 trigram を含むグループの番号の一覧 (postings) を保持する。
+   *   postings は差分を可変長整数で符号化する。
+   *   検索時は候補グループを返し、実際の一致は呼び出し元で行の内容を確認する。
+   *
+   * @fn void add(std::u32string const& text);
+   *   次の行の文字列を追加する。
+   * @fn void drop_front(std::size_t count);
+   *   古い行を count 行破棄する。
+   * @fn bool candidates(std::u32string const& literal, std::vector<std::uint64_t>& groups) const;
+   *   literal を含み得るグループの番号を昇順で返す。
+   *   literal が短すぎて索引が使えない時は false を返す。
+   */
+  class text_search_index {
+  public:
+    static constexpr std::size_t group_size = 64;
+
+  private:
+    static constexpr std::size_t posting_initial_capacity = 16;
+    struct posting_t {
+      std::vector<byte> data;
+      std::uint64_t last = 0; // 最後に追加したグループ番号 + 1
+      std::uint32_t count = 0;
+    };
+    std::unordered_map<std::uint32_t, posting_t> m_postings;
+    std::uint64_t m_begin = 0; // 最も古い行の通し番号
+    std::uint64_t m_end = 0;   // 次に追加する行の通し番号
+    std::uint64_t m_compacted_group = 0; // postings に含まれる最初のグループ番号
+
+  public:
+    std::uint64_t begin() const { return m_begin; }
+    std::uint64_t end() const { return m_end; }
+    void clear() {
+      m_postings.clear();
+      m_begin = m_end = m_compacted_group = 0;
+    }
+
+    void add(std::u32string const& text);
+    void drop_front(std::size_t count);
+    bool candidates(std::u32string const& literal, std::vector<std::uint64_t>& groups) const;
+
+    std::size_t memory_usage() const;
+
+  private:
+    void compact();
+  };
+
+}
+}
+
+#endif
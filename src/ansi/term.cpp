@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <vector>
 #include <unordered_map>
+#include <chrono>
 #include <mwg/except.h>
 #include "../sequence.hpp"
 
@@ -299,6 +300,15 @@ namespace ansi {
     do_lf(term);
     do_cr(term);
   }
+  // 自動改行。元の行が次の行に続いている事を lattr_wrapped で記録する。
+  // Note: SIMD や左右の余白がある時は幅を変えた時に繋げ直せないので記録しない。
+  void do_autowrap(term_t& term) {
+    board_t& b = term.board();
+    line_t& line = b.line();
+    if (!term.state().get_mode(mode_simd) && term.implicit_slh(line) == 0 && term.implicit_sll(line) == b.width() - 1)
+      line.lflags() |= lattr_wrapped;
+    do_nel(term);
+  }
 
   void do_bs(term_t& term) {
     // Note: mode_xenl, mode_decawm, mode_XtermReversewrap が絡んで来た時の振る舞いは適当である。
@@ -404,7 +414,7 @@ namespace ansi {
     curpos_t const x1 = x0 + dir * (char_width - 1);
     if ((x1 - sll) * dir > 0 && (x0 - slh) * dir > 0) {
       if (!s.get_mode(mode_decawm)) return;
-      do_nel(term);
+      do_autowrap(term);
       // Note: do_nel() 後に b.cur.x() in [slh, sll]
       //   は保証されていると思って良いので、
       //   現在位置が範囲外の時の sll の補正は不要。
@@ -414,9 +424,9 @@ namespace ansi {
     curpos_t const xL = simd ? b.cur.x() - (char_width - 1) : b.cur.x();
 
     cell_t cell;
-    cell.character = u;
+    cell.set_character(u);
     cell.attribute = b.cur.abuild.attr();
-    cell.width = char_width;
+    cell.set_width(char_width);
     b.line().write_cells(xL, &cell, 1, 1, dir);
 
     curpos_t x = b.cur.x() + dir * char_width;
@@ -428,7 +438,7 @@ namespace ansi {
         if (!simd && x == sll + 1 && s.get_mode(mode_xenl)) {
           xenl = true;
         } else {
-          do_nel(term);
+          do_autowrap(term);
           return;
         }
       } else {
@@ -465,7 +475,7 @@ namespace ansi {
     if (simd) std::swap(slh, sll);
 
     auto _next_line = [&] () {
-      do_nel(term);
+      do_autowrap(term);
       x = b.cur.x();
       line = &b.line();
       term.initialize_line(*line);
@@ -479,9 +489,9 @@ namespace ansi {
     };
 
     cell_t cell;
-    cell.character = ascii_nul;
+    cell.set_character(ascii_nul);
     cell.attribute = b.cur.abuild.attr();
-    cell.width = 1;
+    cell.set_width(1);
 
     std::vector<cell_t>& buffer = term.m_buffer;
     mwg_assert(buffer.empty());
@@ -525,8 +535,8 @@ namespace ansi {
 
       // 文字は取り敢えず buffer に登録する
       if (buffer.empty()) xbeg = x;
-      cell.character = u;
-      cell.width = char_width;
+      cell.set_character(u);
+      cell.set_width(char_width);
       buffer.emplace_back(cell);
       x += dir * char_width;
     }
@@ -545,7 +555,7 @@ namespace ansi {
           if (!simd && x == sll + 1 && cap_xenl) {
             xenl = true;
           } else {
-            do_nel(term);
+            do_autowrap(term);
             return;
           }
         } else {
@@ -556,6 +566,83 @@ namespace ansi {
     }
   }
 
+  /*?lwiki
+   * @fn void do_insert_graphs(term_t& term, byte const* beg, byte const* end);
+   *   印字可能 ASCII 文字の列を挿入します。
+   *   IRM, SIMD, 倍幅文字のいずれも有効でない時は、
+   *   文字幅の計算と term.m_buffer を経由せずに直接行に書き込みます。
+   */
+  void do_insert_graphs(term_t& term, byte const* beg, byte const* end) {
+    if (beg == end) return;
+
+    board_t& b = term.board();
+    tstate_t& s = term.state();
+    if (beg + 1 == end || s.get_mode(mode_simd) || s.get_mode(mode_irm) || b.cur.abuild.is_double_width()) {
+      constexpr std::size_t chunk_size = 256;
+      char32_t buff[chunk_size];
+      while (beg < end) {
+        std::size_t const n = std::min<std::size_t>(end - beg, chunk_size);
+        std::copy(beg, beg + n, buff);
+        beg += n;
+        do_insert_graphs(term, buff, buff + n);
+      }
+      return;
+    }
+
+    bool const decawm = s.get_mode(mode_decawm);
+    bool const cap_xenl = s.get_mode(mode_xenl);
+    attr_t const attr = b.cur.abuild.attr();
+
+    curpos_t x = b.cur.x();
+    line_t* line = &b.line();
+    term.initialize_line(*line);
+    curpos_t slh = term.implicit_slh(*line);
+    curpos_t sll = term.implicit_sll(*line);
+    if (x < slh)
+      slh = 0;
+    else if (x > (b.cur.xenl() ? sll + 1 : sll))
+      sll = b.width() - 1;
+
+    while (beg < end) {
+      // (行頭より後でかつ) 行末に文字が入らない時は折り返し
+      if (x > sll && x > slh) {
+        // Note: !decawm の時は do_insert_graphs(char32_t const*, ...) と同様に
+        //   残りの文字は捨てて、カーソル位置も更新しない。
+        if (!decawm) return;
+
+        do_autowrap(term);
+        x = b.cur.x();
+        line = &b.line();
+        term.initialize_line(*line);
+        slh = term.implicit_slh(*line);
+        sll = term.implicit_sll(*line);
+      }
+
+      // 折り返しまでに入る文字を一括で書き込む
+      curpos_t const n = std::min<curpos_t>(end - beg, std::max(sll, slh) + 1 - x);
+      line->write_ascii_cells(x, beg, beg + n, attr);
+      beg += n;
+      x += n;
+    }
+
+    bool xenl = false;
+    if (x - sll >= 1) {
+      if (decawm) {
+        // 行末を超えた時は折り返し
+        // Note: xenl かつ x == sll + 1 ならば の位置にいる事を許容する。
+        if (x == sll + 1 && cap_xenl) {
+          xenl = true;
+        } else {
+          do_autowrap(term);
+          return;
+        }
+      } else {
+        x = sll;
+      }
+    }
+    b.cur.set_x(x, xenl);
+  }
+
   //---------------------------------------------------------------------------
   // Page and line settings
 
@@ -1284,9 +1371,19 @@ namespace ansi {
     board_t& b = term.board();
     if (value != s.get_mode(mode_altscr)) {
       s.set_mode(mode_altscr, value);
-      s.altscreen.reset_size(b.width(), b.height());
-      s.altscreen.cur = b.cur;
       s.altscreen.m_line_count = b.m_line_count;
+      bool const reflowed = !value && s.altscreen.width() != b.width();
+      if (value)
+        s.altscreen.reset_size(b.width(), b.height());
+      else
+        s.altscreen.reflow(b.width(), b.height(), &term.m_scroll_buffer); // 主画面に戻る時
+      if (reflowed) {
+        // Note: 主画面を折り返し直した時は、折り返し後のカーソル位置を使う。
+        curpos_t const x = s.altscreen.cur.x(), y = s.altscreen.cur.y();
+        s.altscreen.cur = b.cur;
+        s.altscreen.cur.set(x, y);
+      } else
+        s.altscreen.cur = b.cur;
       std::swap(s.altscreen, b);
     }
   }
@@ -1321,9 +1418,15 @@ namespace ansi {
   void do_sm_XtermOptAltbufCursor(term_t& term, bool value) {
     auto& s = term.state();
     if (s.get_mode(mode_altscr) != value) {
+      board_t& b = term.board();
+      bool const reflowed = !value && s.altscreen.width() != b.width();
       s.set_mode(mode_XtermAltbuf, value);
+      curpos_t const x = b.cur.x(), y = b.cur.y();
       s.set_mode(mode_XtermSaveCursor, value);
       if (value) do_ed(term, 2);
+
+      // Note: 保存したカーソル位置は折り返し前の物なので、折り返し後の位置に置き直す。
+      if (reflowed) b.cur.set(x, y);
     }
   }
 
@@ -1537,6 +1640,19 @@ namespace ansi {
     return true;
   }
 
+  static bool do_sgr_cached(term_t& term, sequence const& seq, csi_parameters& params) {
+    term.gc(contra_ansi_term_abuild_gc_threshold);
+
+    attr_builder& abuild = term.board().cur.abuild;
+    bool const grcm = term.state().get_mode(mode_grcm);
+    sgr_cache_t::entry_t* slot;
+    if (term.sgr_cache().lookup(seq, grcm, abuild, slot)) return true;
+
+    do_sgr(term, params);
+    term.sgr_cache().store(slot, abuild);
+    return true;
+  }
+
   bool do_sco(term_t& term, csi_parameters& params) {
     csi_param_t param;
     params.read_param(param, 0);
@@ -1713,6 +1829,10 @@ namespace ansi {
   static void do_el(term_t& term, line_t& line, csi_param_t param, attr_t const& fill_attr) {
     board_t& b = term.board();
     tstate_t& s = term.state();
+
+    // 行末まで消去した行は次の行に続かない。
+    if (param != 1) line.lflags() &= ~lattr_wrapped;
+
     if (param != 0 && param != 1) {
       if (!s.get_mode(mode_erm) && line.has_protected_cells()) {
         line_shift_flags flags = lshift_erm_protect;
@@ -1773,8 +1893,10 @@ namespace ansi {
       for (curpos_t y = y1; y < y2; y++)
         do_el(term, b.m_lines[y], 2, fill_attr);
     } else {
-      for (curpos_t y = y1; y < y2; y++)
+      for (curpos_t y = y1; y < y2; y++) {
         b.m_lines[y].clear_content(b.width(), fill_attr);
+        b.m_lines[y].lflags() &= ~lattr_wrapped;
+      }
     }
   }
   bool do_ed(term_t& term, csi_parameters& params) {
@@ -2197,10 +2319,6 @@ namespace ansi {
   //---------------------------------------------------------------------------
   // dispatch
 
-  constexpr std::uint32_t compose_bytes(byte major, byte minor) {
-    return minor << 8 | major;
-  }
-
   int tstate_t::rqm_mode_with_accessor(mode_t modeSpec) const {
     switch (mode_index(modeSpec)) {
 #include "../../out/gen/term.mode_rqm.hpp"
@@ -2215,143 +2333,160 @@ namespace ansi {
     }
   }
 
-  struct control_function_dictionary {
-    std::unordered_map<std::uint32_t, control_function_t*> data0;
-    control_function_t* data1[63];
-    control_function_t* data_0Ft[63];
-    control_function_t* data_nFp[15 * 15];
-    control_function_t* data_PFt[4 * 63];
+  /*?lwiki
+   * 制御関数の表は以下の登録一覧からコンパイル時に構築する。
+   * 各項目は `{P, I1, I2, F, fp}` で、
+   * CSI [P] ... [I1 [I2]] F に対応する関数 fp を登録する。
+   * P (private parameter byte) と I1, I2 (intermediate bytes) は存在しない時に 0 を指定する。
+   */
+  struct control_function_entry {
+    byte P, I1, I2, F;
+    control_function_t* fp;
+  };
 
-    control_function_t* get(byte F) const {
-      int const index = (int) F - ascii_at;
-      return 0 <= index && index < (int) std::size(data1) ? data1[index] : nullptr;
-    }
-    void register_cfunc(control_function_t* fp, byte F) {
-      int const index = (int) F - ascii_at;
-      mwg_assert(0 <= index && index < (int) std::size(data1), "final byte out of range");
-      mwg_assert(data1[index] == nullptr, "another function is already registered");
-      data1[index] = fp;
+  constexpr control_function_entry cfunc_registry[] = {
+    {0,              0,                  0, ascii_circumflex,    &do_simd},
+
+    {0,              0,                  0, ascii_at,            &do_ich},
+    {0,              0,                  0, ascii_A,             &do_cuu},
+    {0,              0,                  0, ascii_B,             &do_cud},
+    {0,              0,                  0, ascii_C,             &do_cuf},
+    {0,              0,                  0, ascii_D,             &do_cub},
+    {0,              0,                  0, ascii_E,             &do_cnl},
+    {0,              0,                  0, ascii_F,             &do_cpl},
+    {0,              0,                  0, ascii_G,             &do_cha},
+    {0,              0,                  0, ascii_H,             &do_cup},
+    {0,              0,                  0, ascii_J,             &do_ed},
+    {0,              0,                  0, ascii_K,             &do_el},
+    {0,              0,                  0, ascii_L,             &do_il},
+    {0,              0,                  0, ascii_M,             &do_dl},
+    {0,              0,                  0, ascii_P,             &do_dch},
+    {0,              0,                  0, ascii_S,             &do_su},
+    {0,              0,                  0, ascii_T,             &do_sd},
+    {0,              0,                  0, ascii_X,             &do_ech},
+    {0,              0,                  0, ascii_left_bracket,  &do_srs},
+    {0,              0,                  0, ascii_right_bracket, &do_sds},
+
+    {0,              0,                  0, ascii_back_quote,    &do_hpa},
+    {0,              0,                  0, ascii_a,             &do_hpr},
+    {0,              0,                  0, ascii_c,             &do_da1},
+    {0,              0,                  0, ascii_d,             &do_vpa},
+    {0,              0,                  0, ascii_e,             &do_vpr},
+    {0,              0,                  0, ascii_f,             &do_hvp},
+    {0,              0,                  0, ascii_h,             &do_sm},
+    {0,              0,                  0, ascii_j,             &do_hpb},
+    {0,              0,                  0, ascii_k,             &do_vpb},
+    {0,              0,                  0, ascii_l,             &do_rm},
+    {0,              0,                  0, ascii_m,             &do_sgr},
+    {0,              0,                  0, ascii_n,             &do_dsr},
+
+    {0,              ascii_sp,           0, ascii_at,            &do_sl},
+    {0,              ascii_sp,           0, ascii_A,             &do_sr},
+    {0,              ascii_sp,           0, ascii_S,             &do_spd},
+    {0,              ascii_sp,           0, ascii_U,             &do_slh},
+    {0,              ascii_sp,           0, ascii_V,             &do_sll},
+    {0,              ascii_sp,           0, ascii_e,             &do_sco},
+    {0,              ascii_sp,           0, ascii_i,             &do_sph},
+    {0,              ascii_sp,           0, ascii_j,             &do_spl},
+    {0,              ascii_sp,           0, ascii_k,             &do_scp},
+
+    {0,              0,                  0, ascii_r,             &do_decstbm},
+    {0,              0,                  0, ascii_s,             &do_decslrm_or_scosc},
+    {0,              0,                  0, ascii_u,             &do_scorc},
+    {0,              ascii_sp,           0, ascii_q,             &do_decscusr},
+    {0,              ascii_double_quote, 0, ascii_p,             &do_decscl},
+    {0,              ascii_double_quote, 0, ascii_q,             &do_decsca},
+    {0,              ascii_dollar,       0, ascii_vertical_bar,  &do_decscpp},
+    {0,              ascii_dollar,       0, ascii_p,             &do_decrqm_ansi},
+
+    // CSI P Ft
+    {ascii_question, 0,                  0, ascii_h,             &do_decset},
+    {ascii_question, 0,                  0, ascii_l,             &do_decrst},
+    {ascii_question, 0,                  0, ascii_n,             &do_decdsr},
+    {ascii_greater,  0,                  0, ascii_c,             &do_da2},
+    {ascii_greater,  0,                  0, ascii_m,             &do_XtermSetModFkeys},
+    {ascii_greater,  0,                  0, ascii_n,             &do_XtermSetModFkeys0},
+
+    // CSI P I Ft
+    {ascii_question, ascii_dollar,       0, ascii_p,             &do_decrqm_dec},
+  };
+
+  constexpr std::size_t cfunc_final_count = 63; // 0x40-0x7E
+  constexpr std::size_t cfunc_prefix_count = 5 * 17 * 17;
+
+  // @fn cfunc_prefix_index(P, I1, I2)
+  //   P in {0, 0x3C-0x3F}, I1, I2 in {0, 0x20-0x2F} を 1段目の添字に変換する。
+  //   範囲外の時は cfunc_prefix_count を返す。
+  constexpr std::size_t cfunc_prefix_index(byte P, byte I1, byte I2) {
+    std::size_t const p = P ? (std::size_t) (byte) (P - ascii_less) + 1 : 0;
+    std::size_t const i1 = I1 ? (std::size_t) (byte) (I1 - ascii_sp) + 1 : 0;
+    std::size_t const i2 = I2 ? (std::size_t) (byte) (I2 - ascii_sp) + 1 : 0;
+    if (p > 4 || i1 > 16 || i2 > 16) return cfunc_prefix_count;
+    return (p * 17 + i1) * 17 + i2;
+  }
+
+  constexpr bool cfunc_registry_is_valid() {
+    for (auto const& entry : cfunc_registry) {
+      if (cfunc_prefix_index(entry.P, entry.I1, entry.I2) >= cfunc_prefix_count) return false;
+      if (!(ascii_at <= entry.F && entry.F - ascii_at < (int) cfunc_final_count)) return false;
+      if (entry.I2 && !entry.I1) return false;
+    }
+    for (std::size_t i = 0; i < std::size(cfunc_registry); i++) {
+      auto const& a = cfunc_registry[i];
+      for (std::size_t j = i + 1; j < std::size(cfunc_registry); j++) {
+        auto const& b = cfunc_registry[j];
+        if (a.P == b.P && a.I1 == b.I1 && a.I2 == b.I2 && a.F == b.F) return false;
+      }
     }
+    return true;
+  }
+  static_assert(cfunc_registry_is_valid(), "invalid or duplicate entry in cfunc_registry");
 
-    control_function_t* get(byte I, byte F) const {
-      auto const it = data0.find(compose_bytes(I, F));
-      return it != data0.end() ? it->second : nullptr;
+  constexpr std::size_t cfunc_count_pages() {
+    bool used[cfunc_prefix_count + 1] = {};
+    std::size_t count = 1;
+    for (auto const& entry : cfunc_registry) {
+      std::size_t const index = cfunc_prefix_index(entry.P, entry.I1, entry.I2);
+      if (!used[index]) {
+        used[index] = true;
+        count++;
+      }
     }
-    control_function_t* get_IF(byte I, byte F) const {
-      if (I == ascii_sp) {
-        return data_0Ft[(int) F - ascii_at];
-      } else if (ascii_p <= F) {
-        int const zone = (int) I - ascii_exclamation;
-        int const point = (int) F - ascii_p;
-        return data_nFp[zone * 15 + point];
-      } else
-        return get(I, F);
-    }
-    control_function_t* get_PF(byte P, byte F) const {
-      int const zone = (int) P - ascii_less;
-      int const point = (int) F - ascii_at;
-      return data_PFt[zone * 63 + point];
-    }
-    void register_cfunc(control_function_t* fp, byte I, byte F) {
-      if ((I & 0xF0) == ascii_sp) {
-        if (I == ascii_sp) {
-          data_0Ft[(int) F - ascii_at] = fp;
-        } else if (ascii_p <= F) {
-          int const zone = (int) I - ascii_exclamation;
-          int const point = (int) F - ascii_p;
-          data_nFp[zone * 15 + point] = fp;
-        } else
-          data0[compose_bytes(I, F)] = fp;
-      } else {
-        int const zone = (int) I - ascii_less;
-        int const point = (int) F - ascii_at;
-        data_PFt[zone * 63 + point] = fp;
-      }
-    }
-
-    control_function_t* get(byte I1, byte I2, byte F) const {
-      auto const it = data0.find(I1 << 16 | I2 << 8 | F);
-      return it != data0.end() ? it->second : nullptr;
-    }
-    void register_cfunc(control_function_t* fp, byte I1, byte I2, byte F) {
-      data0[I1 << 16 | I2 << 8 | F] = fp;
-    }
-
-    control_function_dictionary() {
-      std::fill(std::begin(data1), std::end(data1), nullptr);
-      std::fill(std::begin(data_0Ft), std::end(data_0Ft), nullptr);
-      std::fill(std::begin(data_nFp), std::end(data_nFp), nullptr);
-      std::fill(std::begin(data_PFt), std::end(data_PFt), nullptr);
-
-      register_cfunc(&do_simd, ascii_circumflex);
-
-      register_cfunc(&do_ich , ascii_at);
-      register_cfunc(&do_cuu , ascii_A);
-      register_cfunc(&do_cud , ascii_B);
-      register_cfunc(&do_cuf , ascii_C);
-      register_cfunc(&do_cub , ascii_D);
-      register_cfunc(&do_cnl , ascii_E);
-      register_cfunc(&do_cpl , ascii_F);
-      register_cfunc(&do_cha , ascii_G);
-      register_cfunc(&do_cup , ascii_H);
-      register_cfunc(&do_ed  , ascii_J);
-      register_cfunc(&do_el  , ascii_K);
-      register_cfunc(&do_il  , ascii_L);
-      register_cfunc(&do_dl  , ascii_M);
-      register_cfunc(&do_dch , ascii_P);
-      register_cfunc(&do_su  , ascii_S);
-      register_cfunc(&do_sd  , ascii_T);
-      register_cfunc(&do_ech , ascii_X);
-      register_cfunc(&do_srs , ascii_left_bracket);
-      register_cfunc(&do_sds , ascii_right_bracket);
-
-      register_cfunc(&do_hpa , ascii_back_quote);
-      register_cfunc(&do_hpr , ascii_a);
-      register_cfunc(&do_da1 , ascii_c);
-      register_cfunc(&do_vpa , ascii_d);
-      register_cfunc(&do_vpr , ascii_e);
-      register_cfunc(&do_hvp , ascii_f);
-      register_cfunc(&do_sm  , ascii_h);
-      register_cfunc(&do_hpb , ascii_j);
-      register_cfunc(&do_vpb , ascii_k);
-      register_cfunc(&do_rm  , ascii_l);
-      register_cfunc(&do_sgr , ascii_m);
-      register_cfunc(&do_dsr , ascii_n);
-
-      register_cfunc(&do_sl  , ascii_sp, ascii_at);
-      register_cfunc(&do_sr  , ascii_sp, ascii_A);
-      register_cfunc(&do_spd , ascii_sp, ascii_S);
-      register_cfunc(&do_slh , ascii_sp, ascii_U);
-      register_cfunc(&do_sll , ascii_sp, ascii_V);
-      register_cfunc(&do_sco , ascii_sp, ascii_e);
-      register_cfunc(&do_sph , ascii_sp, ascii_i);
-      register_cfunc(&do_spl , ascii_sp, ascii_j);
-      register_cfunc(&do_scp , ascii_sp, ascii_k);
-
-      register_cfunc(&do_decstbm         , ascii_r);
-      register_cfunc(&do_decslrm_or_scosc, ascii_s);
-      register_cfunc(&do_scorc   , ascii_u);
-      register_cfunc(&do_decscusr, ascii_sp, ascii_q);
-      register_cfunc(&do_decscl  , ascii_double_quote, ascii_p);
-      register_cfunc(&do_decsca  , ascii_double_quote, ascii_q);
-      register_cfunc(&do_decscpp , ascii_dollar, ascii_vertical_bar);
-      register_cfunc(&do_decrqm_ansi, ascii_dollar, ascii_p);
-
-      // CSI P Ft
-      register_cfunc(&do_decset, ascii_question, ascii_h);
-      register_cfunc(&do_decrst, ascii_question, ascii_l);
-      register_cfunc(&do_decdsr, ascii_question, ascii_n);
-      register_cfunc(&do_da2              , ascii_greater, ascii_c);
-      register_cfunc(&do_XtermSetModFkeys , ascii_greater, ascii_m);
-      register_cfunc(&do_XtermSetModFkeys0, ascii_greater, ascii_n);
-
-      // CSI P I Ft
-      register_cfunc(&do_decrqm_dec, ascii_question, ascii_dollar, ascii_p);
+    return count;
+  }
+
+  /*?lwiki
+   * @class control_function_dictionary
+   *   二段階の密な表による制御関数の辞書。
+   *   1段目 `page` は (P, I1, I2) の組から頁番号への写像である。
+   *   2段目 `data` は各頁について最終バイト (0x40-0x7E) で引く関数の表である。
+   *   頁番号 0 は空の頁で、登録のない組は全てここを指す。
+   */
+  class control_function_dictionary {
+    static constexpr std::size_t page_count = cfunc_count_pages();
+    static_assert(page_count <= 0x100, "too many control function pages");
+
+    byte page[cfunc_prefix_count + 1] = {};
+    control_function_t* data[page_count][cfunc_final_count] = {};
+
+  public:
+    constexpr control_function_dictionary() {
+      std::size_t npage = 1;
+      for (auto const& entry : cfunc_registry) {
+        std::size_t const index = cfunc_prefix_index(entry.P, entry.I1, entry.I2);
+        if (!page[index]) page[index] = (byte) npage++;
+        data[page[index]][entry.F - ascii_at] = entry.fp;
+      }
     }
 
+    constexpr control_function_t* get(byte P, byte I1, byte I2, byte F) const {
+      std::size_t const f = (byte) (F - ascii_at);
+      if (f >= cfunc_final_count) return nullptr;
+      return data[page[cfunc_prefix_index(P, I1, I2)]][f];
+    }
   };
 
-  static control_function_dictionary cfunc_dict;
+  static constexpr control_function_dictionary cfunc_dict;
 
   void term_t::print_unrecognized_sequence(sequence const& seq) {
     return; // 今は表示しない (後でロギングの枠組みを整理する)
@@ -2389,8 +2524,8 @@ namespace ansi {
     mwg_assert(b.cur.is_sane(b.width()));
 #endif
 
-    auto& params = this->w_csiparams;
-    params.initialize(seq);
+    // Note: パラメータは m_seqdecoder が受信時に解析済み。
+    auto& params = m_seqdecoder.csi_params();
     if (!params) {
       switch (params.result_code()) {
       default:
@@ -2407,53 +2542,25 @@ namespace ansi {
 
     bool result = false;
 
+    byte P = 0, I1 = 0, I2 = 0;
     switch (params.private_prefix_count()) {
-    case 0:
-      switch (seq.intermediate_size()) {
-      case 0: // CSI Ft
-        if (seq.final() == ascii_m)
-          result = do_sgr(*this, params);
-        else if (control_function_t* const f = cfunc_dict.get(seq.final()))
-          result = f(*this, params);
-        break;
-
-      case 1: // CSI I Ft
-        mwg_assert(seq.intermediate()[0] <= 0xFF);
-        if (control_function_t* const f = cfunc_dict.get_IF((byte) seq.intermediate()[0], seq.final()))
-          result = f(*this, params);
-        break;
-
-      case 2: // CSI I I Ft
-        {
-          byte const I1 = seq.intermediate()[0];
-          byte const I2 = seq.intermediate()[1];
-          byte const F = seq.final();
-          if (control_function_t* const f = cfunc_dict.get(I1, I2, F))
-            result = f(*this, params);
-        }
-        break;
-      }
-      break;
-
-    case 1: // Private parameter byte
-      switch (seq.intermediate_size()) {
-      case 0:
-        if (control_function_t* const f = cfunc_dict.get_PF((byte) seq.parameter()[0], seq.final()))
-          result = f(*this, params);
-        break;
-      case 1:
-        {
-          byte const P = seq.parameter()[0];
-          byte const I = seq.intermediate()[0];
-          byte const F = seq.final();
-          if (control_function_t* const f = cfunc_dict.get(P, I, F))
-            result = f(*this, params);
-          break;
-        }
-      }
-      break;
+    case 0: break;
+    case 1: P = (byte) seq.parameter()[0]; break;
+    default: goto unrecognized;
+    }
+    switch (seq.intermediate_size()) {
+    case 0: break;
+    case 2: I2 = (byte) seq.intermediate()[1]; [[fallthrough]];
+    case 1: I1 = (byte) seq.intermediate()[0]; break;
+    default: goto unrecognized;
     }
 
+    if (seq.final() == ascii_m && !(P | I1))
+      result = do_sgr_cached(*this, seq, params);
+    else if (control_function_t* const f = cfunc_dict.get(P, I1, I2, seq.final()))
+      result = f(*this, params);
+
+  unrecognized:
 #ifndef NDEBUG
     mwg_assert(b.cur.is_sane(b.width()),
       "cur: {x=%d, xenl=%d, width=%d} after CSI %c %c",
@@ -3096,6 +3203,558 @@ namespace ansi {
     return true;
   }
 
+  //---------------------------------------------------------------------------
+  // reflow
+
+  void board_t::reflow(curpos_t width, curpos_t height, term_scroll_buffer_t* scroll_buffer) {
+    width = limit::term_col.clamp(width);
+    height = limit::term_row.clamp(height);
+    if (width == m_width) return reset_size(width, height);
+
+    // Note: resize により data は論理位置の順に並ぶ。
+    m_lines.resize(m_height, line_t(m_atable));
+    std::vector<line_t>& old_lines = m_lines.data;
+
+    // 内容のある最後の行 (またはカーソル行) までを処理する。
+    curpos_t ylast = cur.y();
+    for (curpos_t y = m_height - 1; y > ylast; y--) {
+      if (old_lines[y].cells().size() || (old_lines[y].lflags() & lattr_wrapped)) {
+        ylast = y;
+        break;
+      }
+    }
+
+    std::vector<line_t> lines;
+    lines.reserve(std::max<curpos_t>(height, ylast + 1));
+    curpos_t const cur_y = cur.y();
+    curpos_t new_x = 0, new_y = 0;
+    for (curpos_t y = 0; y <= ylast; ) {
+      curpos_t y2 = y + 1;
+      while (y2 < m_height && (old_lines[y2 - 1].lflags() & lattr_wrapped)) y2++;
+
+      bool reflowable = true;
+      for (curpos_t i = y; i < y2; i++) reflowable = reflowable && old_lines[i].is_reflowable();
+      if (y2 - y == 1 && !(old_lines[y].lflags() & lattr_wrapped) && old_lines[y].cells().size() <= (std::size_t) width)
+        reflowable = false; // 変更の必要がない
+
+      if (reflowable) {
+        bool const has_cursor = y <= cur_y && cur_y < y2;
+        curpos_t cy = cur_y - y, cx = cur.x();
+        std::size_t const base = lines.size();
+        line_t::reflow(&old_lines[y], y2 - y, width, lines, m_line_count, has_cursor ? &cy : nullptr, has_cursor ? &cx : nullptr);
+        if (has_cursor) {
+          new_y = base + cy;
+          new_x = cx;
+        }
+      } else {
+        for (curpos_t i = y; i < y2; i++) {
+          if (i == cur_y) {
+            new_y = lines.size();
+            new_x = cur.x();
+          }
+          lines.emplace_back(std::move(old_lines[i]));
+          if (m_width > width) lines.back().truncate(width, false, true);
+        }
+      }
+      y = y2;
+    }
+
+    // 溢れた行は上からスクロールバッファに移して、画面の下端に揃える。
+    // Note: カーソル行より下の行を捨てない為、カーソルが画面の上に出る時は最初の行に置く。
+    curpos_t shift = 0;
+    if ((curpos_t) lines.size() > height) {
+      shift = lines.size() - height;
+      if (scroll_buffer)
+        for (curpos_t i = 0; i < shift; i++)
+          scroll_buffer->transfer(std::move(lines[i]));
+      lines.erase(lines.begin(), lines.begin() + shift);
+      if (new_y < shift) new_y = shift;
+    }
+    while ((curpos_t) lines.size() < height) {
+      lines.emplace_back(m_atable);
+      lines.back().set_id(m_line_count++);
+    }
+
+    m_lines.assign(std::move(lines));
+    m_width = width;
+    m_height = height;
+    cur.set(std::min(new_x, width - 1), new_y - shift);
+  }
+
+  void term_t::reset_size(curpos_t width, curpos_t height) {
+    // Note: 代替画面はアプリケーションが描き直すので折り返し直さない。
+    //   DECCOLM 等による幅の変更も board_t::reset_size を直接呼び出すので折り返し直さない。
+    if (m_state.get_mode(mode_altscr))
+      m_board.reset_size(width, height);
+    else
+      m_board.reflow(width, height, &m_scroll_buffer);
+    m_scroll_buffer.set_width(m_board.width());
+  }
+
+  //---------------------------------------------------------------------------
+  // term_scroll_buffer_t
+
+  bool term_scroll_buffer_t::set_spill(bool value) {
+    if (value == (m_spill != nullptr)) return true;
+    if (value) {
+      auto spill = std::make_unique<contra::sys::spill_file>();
+      if (!spill->open()) return false;
+      m_spill = std::move(spill);
+      m_spill_serial = m_block_serial;
+      m_spill_skip = 0;
+    } else {
+      // Note: 展開済みの項目は通し番号が m_block_serial より小さくなるので無効になる。
+      if (m_search_enabled) m_search_index.drop_front(m_spilled_count);
+      m_spilled.clear();
+      m_spilled_count = 0;
+      m_spill_dead = 0;
+      m_spill_serial = m_block_serial;
+      m_spill_skip = 0;
+      m_spill.reset();
+    }
+    evict_old_lines();
+    return true;
+  }
+
+  std::uint32_t term_scroll_buffer_t::line_id(std::size_t index) const {
+    if (index >= m_spilled_count + m_frozen_count)
+      return (*this)[index].id();
+
+    std::size_t line_index;
+    std::size_t const serial = locate_block(index, line_index);
+    if (serial >= m_block_serial)
+      return m_blocks[serial - m_block_serial].id(line_index);
+
+    spilled_block_t const& entry = m_spilled[serial - m_spill_serial];
+    byte const* const data = m_spill->map(entry.offset, entry.size);
+    return data ? line_block_t::serialized_id(data, line_index) : (std::uint32_t) -1;
+  }
+
+  void term_scroll_buffer_t::drop_front(std::size_t count) {
+    mwg_assert(m_spilled_count == 0);
+    std::size_t const old_size = size();
+    while (count && m_frozen_count) {
+      std::size_t const n = std::min(count, m_frozen_count);
+      std::size_t const skip = std::min(m_block_skip + n, line_block_t::capacity);
+      count -= skip - m_block_skip;
+      m_frozen_count -= skip - m_block_skip;
+      m_block_skip = skip;
+      if (m_block_skip == line_block_t::capacity) {
+        // Note: 展開済みの項目は通し番号が m_block_serial より小さくなるので自然に無効になる。
+        m_spare_block = std::move(m_blocks.front());
+        m_blocks.pop_front();
+        m_block_serial++;
+        m_block_skip = 0;
+      }
+    }
+    m_spill_serial = m_block_serial;
+
+    for (; count && m_pending_lines.size(); count--) {
+      m_line_pool.release(m_pending_lines.front());
+      m_pending_lines.pop_front();
+    }
+    count = std::min(count, m_lines.size());
+    while (count--) {
+      m_line_pool.release(m_lines.front());
+      m_lines.pop_front();
+    }
+    m_young_count = std::min(m_young_count, size());
+    if (m_search_enabled && !m_reflow_active) m_search_index.drop_front(old_size - size());
+  }
+
+  void term_scroll_buffer_t::evict_old_lines() {
+    if (m_spill) {
+      // メモリ上の行数が m_capacity を超えている間、古いブロックを退避する。
+      while (m_frozen_count + m_pending_lines.size() + m_lines.size() > m_capacity) {
+        if (m_blocks.empty()) {
+          // Note: 折り返し直しの途中は未処理の行から凍結する。
+          auto& source = m_pending_lines.size() ? m_pending_lines : m_lines;
+          if (source.size() < line_block_t::capacity) return;
+          freeze_front_lines(source);
+        }
+        if (!spill_front_block()) {
+          contra::xprint(errdev(), "contra: failed to write the scrollback spill file. The spilled lines are discarded.\n");
+          set_spill(false);
+          return;
+        }
+      }
+    } else if (size() > m_capacity) {
+      drop_front(size() - m_capacity);
+    }
+  }
+
+  void term_scroll_buffer_t::freeze_front_lines(contra::util::ring_deque<line_t>& source) {
+    std::vector<line_t>& lines = m_freeze_buffer;
+    lines.reserve(line_block_t::capacity);
+    for (std::size_t i = 0; i < line_block_t::capacity; i++) {
+      lines.emplace_back(std::move(source.front()));
+      source.pop_front();
+    }
+    m_blocks.emplace_back(std::move(m_spare_block));
+    m_blocks.back().freeze(lines.data(), lines.size());
+    m_frozen_count += lines.size();
+
+    for (line_t& line : lines) m_line_pool.release(line);
+    lines.clear();
+  }
+
+  void term_scroll_buffer_t::freeze_old_lines() {
+    if (m_freeze_age == 0 || m_reflow_active) return;
+    while (m_lines.size() >= m_freeze_age + line_block_t::capacity)
+      freeze_front_lines(m_lines);
+  }
+
+  bool term_scroll_buffer_t::write_spilled_block(std::size_t serial, line_block_t const& block) {
+    std::vector<byte> buffer;
+    block.serialize(buffer, *m_atable);
+
+    std::size_t const index = serial - m_spill_serial;
+    if (index < m_spilled.size()) {
+      // 内容に変化がなければ書き直さない。
+      spilled_block_t& entry = m_spilled[index];
+      if (entry.size == buffer.size()) {
+        byte const* const data = m_spill->map(entry.offset, entry.size);
+        if (data && std::memcmp(data, buffer.data(), buffer.size()) == 0) return true;
+      }
+
+      // 元の領域に収まる時はその場で上書きする。
+      if (buffer.size() <= entry.extent) {
+        if (!m_spill->overwrite(entry.offset, buffer.data(), buffer.size())) return false;
+        entry.size = (std::uint32_t) buffer.size();
+        entry.has_selection = block.has_selection();
+        return true;
+      }
+    }
+
+    std::uint64_t offset;
+    if (!m_spill->append(buffer.data(), buffer.size(), offset)) return false;
+    spilled_block_t const entry = { offset, (std::uint32_t) buffer.size(), (std::uint32_t) buffer.size(), block.has_selection() };
+    if (index < m_spilled.size()) {
+      m_spill_dead += m_spilled[index].extent;
+      m_spilled[index] = entry;
+    } else {
+      m_spilled.push_back(entry);
+    }
+
+    // 使われなくなった領域がファイルの半分を超えたら詰め直す。
+    if (m_spill_dead >= spill_compact_threshold && m_spill_dead * 2 > m_spill->size())
+      compact_spill_file();
+    return true;
+  }
+
+  // 使われている領域だけを新しい退避ファイルに書き写す。失敗した時は元のファイルを使い続ける。
+  void term_scroll_buffer_t::compact_spill_file() {
+    auto spill = std::make_unique<contra::sys::spill_file>();
+    if (!spill->open()) return;
+    std::vector<spilled_block_t> spilled = m_spilled;
+    for (spilled_block_t& entry : spilled) {
+      byte const* const data = m_spill->map(entry.offset, entry.size);
+      if (!data || !spill->append(data, entry.size, entry.offset)) return;
+      entry.extent = entry.size;
+    }
+    m_spill = std::move(spill);
+    m_spilled.swap(spilled);
+    m_spill_dead = 0;
+  }
+
+  bool term_scroll_buffer_t::spill_front_block() {
+    if (m_spilled.empty()) {
+      m_spill_serial = m_block_serial;
+      m_spill_skip = m_block_skip;
+    }
+    mwg_assert(m_spill_serial + m_spilled.size() == m_block_serial);
+    mwg_assert(m_spilled.empty() || m_block_skip == 0);
+    if (!write_spilled_block(m_block_serial, m_blocks.front())) return false;
+
+    std::size_t const count = line_block_t::capacity - m_block_skip;
+    m_spilled_count += count;
+    m_frozen_count -= count;
+    m_spare_block = std::move(m_blocks.front());
+    m_blocks.pop_front();
+    m_block_serial++;
+    m_block_skip = 0;
+    return true;
+  }
+
+  void term_scroll_buffer_t::load_block(std::size_t serial, std::vector<line_t>& lines) {
+    lines.resize(line_block_t::capacity, line_t(m_atable));
+    if (serial >= m_block_serial) {
+      line_block_t const& block = m_blocks[serial - m_block_serial];
+      for (std::size_t i = 0; i < block.size(); i++)
+        block.thaw(i, lines[i]);
+      return;
+    }
+
+    spilled_block_t const& entry = m_spilled[serial - m_spill_serial];
+    byte const* const data = m_spill->map(entry.offset, entry.size);
+    line_block_t block;
+    if (data && block.deserialize(data, entry.size, *m_atable)) {
+      for (std::size_t i = 0; i < block.size(); i++)
+        block.thaw(i, lines[i]);
+    } else {
+      contra::xprint(errdev(), "contra: failed to read the scrollback spill file.\n");
+      for (line_t& line : lines) line.clear();
+    }
+  }
+
+  line_t& term_scroll_buffer_t::thaw(std::size_t index, bool modify) {
+    std::size_t line_index;
+    std::size_t const serial = locate_block(index, line_index);
+
+    thawed_block_t* entry = nullptr;
+    for (thawed_block_t& e : m_thawed) {
+      if (e.serial == serial) {
+        entry = &e;
+        break;
+      }
+    }
+
+    if (!entry) {
+      auto _is_frozen = [this] (std::size_t serial) {
+        return m_block_serial <= serial && serial < m_block_serial + m_blocks.size();
+      };
+      auto _is_spilled = [this] (std::size_t serial) {
+        return m_spill_serial <= serial && serial < m_spill_serial + m_spilled.size();
+      };
+
+      if (m_thawed.size() < thaw_cache_size) {
+        m_thawed.emplace_back();
+        entry = &m_thawed.back();
+      } else {
+        // 既に破棄されたブロックの項目を優先して再利用する。
+        auto _priority = [&] (thawed_block_t const& e) {
+          return _is_frozen(e.serial) || _is_spilled(e.serial) ? e.last_access : 0;
+        };
+        entry = &*std::min_element(m_thawed.begin(), m_thawed.end(),
+          [&] (thawed_block_t const& a, thawed_block_t const& b) { return _priority(a) < _priority(b); });
+
+        // 追い出すブロックがまだ有効で変更された可能性があれば書き戻す。
+        //   変更がなければ凍結した内容がそのまま使えるので凍結し直さない。
+        if (entry->dirty && _is_frozen(entry->serial)) {
+          m_blocks[entry->serial - m_block_serial].freeze(entry->lines.data(), entry->lines.size());
+        } else if (entry->dirty && _is_spilled(entry->serial)) {
+          line_block_t block;
+          block.freeze(entry->lines.data(), entry->lines.size());
+          if (!write_spilled_block(entry->serial, block))
+            contra::xprint(errdev(), "contra: failed to write the scrollback spill file.\n");
+        }
+      }
+
+      load_block(serial, entry->lines);
+      entry->serial = serial;
+      entry->dirty = false;
+    }
+
+    entry->last_access = ++m_thaw_access;
+    entry->dirty |= modify;
+    return entry->lines[line_index];
+  }
+
+  void term_scroll_buffer_t::gc_mark() {
+    for (line_block_t& block : m_blocks) block.gc_mark(m_atable);
+    for (thawed_block_t& entry : m_thawed)
+      for (line_t& line : entry.lines) line.gc_mark();
+    for (line_t& line : m_pending_lines) line.gc_mark();
+    for (line_t& line : m_lines) line.gc_mark();
+  }
+
+  void term_scroll_buffer_t::gc_mark_young() {
+    std::size_t const nlive = std::min(m_young_count, m_lines.size());
+    for (std::size_t i = m_lines.size() - nlive; i < m_lines.size(); i++)
+      m_lines[i].gc_mark();
+    std::size_t const npending = std::min(m_young_count - nlive, m_pending_lines.size());
+    for (std::size_t i = m_pending_lines.size() - npending; i < m_pending_lines.size(); i++)
+      m_pending_lines[i].gc_mark();
+
+    // 前回の GC 以降に凍結された行
+    if (std::size_t const nfrozen = m_young_count - nlive - npending) {
+      std::size_t const nblock = std::min(m_blocks.size(), (nfrozen + line_block_t::capacity - 1) / line_block_t::capacity);
+      for (std::size_t i = m_blocks.size() - nblock; i < m_blocks.size(); i++)
+        m_blocks[i].gc_mark(m_atable);
+    }
+
+    // Note: 展開済みの行は書き戻しの際に内容が凍結し直されるので常に mark する。
+    for (thawed_block_t& entry : m_thawed)
+      for (line_t& line : entry.lines) line.gc_mark();
+  }
+
+  void term_scroll_buffer_t::set_width(curpos_t width) {
+    if (width == m_width) return;
+    m_width = width;
+    if (!m_line_id_source || m_capacity == 0) return;
+    if (!m_reflow_active && m_blocks.empty() && m_lines.empty()) return;
+
+    // 処理済みの行も含めてメモリ上の行を全て未処理に戻す。
+    if (m_pending_lines.empty()) {
+      m_pending_lines.swap(m_lines);
+    } else {
+      for (; m_lines.size(); m_lines.pop_front())
+        m_pending_lines.emplace_back(std::move(m_lines.front()));
+    }
+    // Note: 索引は処理が終わった時に作り直す。
+    m_reflow_active = true;
+    m_young_count = size();
+  }
+
+  // 最後の凍結ブロックを展開して m_pending_lines の先頭に移す。
+  bool term_scroll_buffer_t::unfreeze_back_block() {
+    if (m_blocks.empty()) return false;
+    std::size_t const serial = m_block_serial + m_blocks.size() - 1;
+    std::size_t const skip = m_blocks.size() == 1 ? m_block_skip : 0;
+
+    // 展開済みの時はその内容を使う。同じ通し番号は後で別のブロックに使うので項目は無効にする。
+    std::vector<line_t>& lines = m_freeze_buffer;
+    auto const it = std::find_if(m_thawed.begin(), m_thawed.end(),
+      [serial] (thawed_block_t const& entry) { return entry.serial == serial; });
+    if (it != m_thawed.end()) {
+      lines.swap(it->lines);
+      it->serial = (std::size_t) -1;
+    } else {
+      load_block(serial, lines);
+    }
+    for (std::size_t i = line_block_t::capacity; i-- > skip; )
+      m_pending_lines.emplace_front(std::move(lines[i]));
+    lines.clear();
+
+    m_frozen_count -= line_block_t::capacity - skip;
+    m_spare_block = std::move(m_blocks.back());
+    m_blocks.pop_back();
+    if (m_blocks.empty()) m_block_skip = 0;
+    return true;
+  }
+
+  // 未処理の最後の連鎖を折り返し直して m_lines の先頭に移す。処理が終わった時に false を返す。
+  bool term_scroll_buffer_t::reflow_step() {
+    std::size_t k;
+    for (;;) {
+      if (m_pending_lines.empty() && !unfreeze_back_block()) {
+        m_reflow_active = false;
+        m_search_index.clear();
+        freeze_old_lines();
+        evict_old_lines();
+        return false;
+      }
+
+      // 連鎖の先頭を探す。未処理の行の先頭まで続く時は前のブロックも展開する。
+      std::size_t const n = m_pending_lines.size();
+      k = n - 1;
+      while (k > 0 && n - k < reflow_chain_limit && (m_pending_lines[k - 1].lflags() & lattr_wrapped)) k--;
+      if (k > 0 || m_blocks.empty() || n - k >= reflow_chain_limit) break;
+      unfreeze_back_block();
+    }
+
+    std::vector<line_t>& input = m_reflow_input;
+    for (std::size_t i = k; i < m_pending_lines.size(); i++)
+      input.emplace_back(std::move(m_pending_lines[i]));
+    while (m_pending_lines.size() > k) m_pending_lines.pop_back();
+
+    bool reflowable = true;
+    for (line_t const& line : input) reflowable = reflowable && line.is_reflowable();
+    if (input.size() == 1 && !(input[0].lflags() & lattr_wrapped) && input[0].cells().size() <= (std::size_t) m_width)
+      reflowable = false; // 変更の必要がない
+
+    if (reflowable) {
+      std::vector<line_t>& output = m_reflow_output;
+      line_t::reflow(input.data(), input.size(), m_width, output, *m_line_id_source);
+      for (std::size_t i = output.size(); i--; )
+        m_lines.emplace_front(std::move(output[i]));
+      output.clear();
+      for (line_t& line : input) m_line_pool.release(line);
+    } else {
+      for (std::size_t i = input.size(); i--; )
+        m_lines.emplace_front(std::move(input[i]));
+    }
+    input.clear();
+    m_young_count = size();
+
+    // Note: 行数が増えて m_capacity を超えた時は古い行を破棄・退避する。
+    evict_old_lines();
+    return true;
+  }
+
+  namespace {
+    void search_line(search_pattern const& pattern, line_t const& line, curpos_t y, std::vector<term_search_result_t>& result,
+      std::u32string& text, std::vector<curpos_t>& positions
+    ) {
+      line_text(line, text, &positions);
+      std::size_t offset = 0, begin, end;
+      while (pattern.find(text, offset, begin, end)) {
+        if (begin == end) {
+          // 空の一致は結果に含めない
+          offset = end + 1;
+          continue;
+        }
+        result.push_back(term_search_result_t {line.id(), y, positions[begin], positions[end]});
+        offset = end;
+      }
+    }
+  }
+
+  void term_scroll_buffer_t::end_batch() {
+    mwg_assert(m_batch_depth > 0);
+    if (--m_batch_depth || !m_batch_deferred) return;
+    std::size_t const count = m_batch_count;
+    m_batch_deferred = false;
+    m_batch_count = 0;
+    // Note: 凍結すると索引の登録に展開が必要になるので、凍結の前に登録する。
+    if (m_search_enabled && !m_reflow_active) update_search_index(count * search_index_step);
+    freeze_old_lines();
+  }
+
+  void term_scroll_buffer_t::update_search_index(std::size_t count) {
+    for (std::size_t i = m_search_index.end() - m_search_index.begin(), iN = size(); count && i < iN; count--, i++) {
+      line_text(at(i, false), m_search_text);
+      m_search_index.add(m_search_text);
+    }
+  }
+
+  void term_scroll_buffer_t::set_search_index(bool value) {
+    if (value == m_search_enabled) return;
+    m_search_enabled = value;
+    m_search_index.clear();
+    if (value && !m_reflow_active) update_search_index((std::size_t) -1);
+  }
+
+  void term_scroll_buffer_t::search(search_pattern const& pattern, std::vector<term_search_result_t>& result) const {
+    if (pattern.empty()) return;
+
+    // Note: 結果の行番号が後で変わらない様に折り返し直しを済ませておく。
+    //   行の配置が変わるだけなので論理的には const である。
+    const_cast<self&>(*this).reflow((std::size_t) -1);
+    if (m_search_enabled) const_cast<self&>(*this).update_search_index((std::size_t) -1);
+    std::size_t const nline = size();
+    std::u32string text;
+    std::vector<curpos_t> positions;
+    auto _search_range = [&] (std::size_t i, std::size_t iN) {
+      for (; i < iN; i++)
+        search_line(pattern, (*this)[i], (curpos_t) i - (curpos_t) nline, result, text, positions);
+    };
+
+    std::vector<std::uint64_t> groups;
+    if (m_search_enabled && m_search_index.candidates(pattern.literal(), groups)) {
+      mwg_assert(m_search_index.end() - m_search_index.begin() == nline);
+      std::uint64_t const seq0 = m_search_index.begin();
+      for (std::uint64_t const group : groups) {
+        std::uint64_t const seq1 = std::max<std::uint64_t>(group * text_search_index::group_size, seq0);
+        std::uint64_t const seq2 = std::min<std::uint64_t>((group + 1) * text_search_index::group_size, m_search_index.end());
+        _search_range(seq1 - seq0, seq2 - seq0);
+      }
+    } else {
+      // 索引を使えない時は全ての行を確認する。
+      _search_range(0, nline);
+    }
+  }
+
+  void term_t::search(search_pattern const& pattern, std::vector<term_search_result_t>& result) const {
+    result.clear();
+    if (pattern.empty()) return;
+    m_scroll_buffer.search(pattern, result);
+    std::u32string text;
+    std::vector<curpos_t> positions;
+    for (curpos_t y = 0, yN = m_board.m_lines.size(); y < yN; y++)
+      search_line(pattern, m_board.m_lines[y], y, result, text, positions);
+  }
+
   void frame_snapshot_list::remove(frame_snapshot_t* snapshot) {
     m_data.erase(std::remove(m_data.begin(), m_data.end(), snapshot), m_data.end());
   }
@@ -3107,15 +3766,52 @@ namespace ansi {
     for (frame_snapshot_t* snapshot: snapshots) snapshot->reset();
   }
 
+  void term_t::copy_frame(term_view_t& view) {
+    term_t const& source = view.term();
+    mwg_assert(&source != this);
+    view.update();
+    term_view_t const& cview = view; // Note: 凍結行を書き戻す対象にしない様に const で参照する。
+
+    board_t const& b = source.board();
+    curpos_t const width = view.width(), height = view.height();
+    m_board.reset_size(width, height, b.xunit(), b.yunit());
+    m_board.set_presentation_direction(b.presentation_direction());
+    for (curpos_t y = 0; y < height; y++) {
+      line_t const& line = cview.line(y);
+      line_t& frame_line = m_board.m_lines[y];
+      if (frame_line.id() == line.id() && frame_line.version() == line.version()) continue;
+      frame_line.copy_frame_from(line, source.atable());
+    }
+    m_board.cur.set(view.x(), view.y(), view.xenl());
+    m_state.copy_display_state(source.state());
+
+    this->gc(contra_ansi_term_abuild_gc_threshold);
+  }
+
   void term_t::gc(std::uint32_t threshold) {
     if (m_atable.gc_count() < threshold) return;
+    auto const time0 = std::chrono::steady_clock::now();
+
+    bool const full = threshold == 0 || m_atable.full_gc_recommended();
+    m_atable.begin_gc(full);
     m_board.gc_mark();
-    m_scroll_buffer.gc_mark();
+    if (full)
+      m_scroll_buffer.gc_mark();
+    else
+      m_scroll_buffer.gc_mark_young();
     state().m_decsc_cur.abuild.gc_mark();
     state().altscreen.gc_mark();
     for (frame_snapshot_t* snapshot: m_snapshots.m_data)
       snapshot->gc_mark(m_atable);
     m_atable.sweep();
+    m_scroll_buffer.gc_promote();
+
+    auto const time1 = std::chrono::steady_clock::now();
+    std::uint64_t const pause = std::chrono::duration_cast<std::chrono::microseconds>(time1 - time0).count();
+    (full ? m_gc_stats.full_count : m_gc_stats.minor_count)++;
+    m_gc_stats.last_pause_usec = pause;
+    m_gc_stats.max_pause_usec = std::max(m_gc_stats.max_pause_usec, pause);
+    m_gc_stats.total_pause_usec += pause;
   }
 
 }
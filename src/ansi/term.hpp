@@ -10,11 +10,15 @@
 #include <iterator>
 #include <algorithm>
 #include <vector>
+#include <string>
+#include <memory>
 #include <sstream>
 #include "../sequence.hpp"
 #include "line.hpp"
+#include "search.hpp"
 #include "../enc.c2w.hpp"
 #include "../enc.utf8.hpp"
+#include "../sys.mmap.hpp"
 
 namespace contra {
 namespace limit {
@@ -43,9 +47,11 @@ namespace ansi {
 
   struct tstate_t;
   class term_t;
+  class term_view_t;
 
   void do_insert_graph(term_t& term, char32_t u);
   void do_insert_graphs(term_t& term, char32_t const* beg, char32_t const* end);
+  void do_insert_graphs(term_t& term, byte const* beg, byte const* end);
 
   enum mouse_mode_flags {
     mouse_report_mask   = 0xFF,
@@ -95,27 +101,131 @@ namespace ansi {
     funckey_mlevel_none           = 0xF,
   };
 
+  /*?lwiki
+   * @class term_search_result_t
+   *   検索で一致した範囲。y は論理行番号 (スクロールバッファの行は負) で、
+   *   x1, x2 はデータ部での位置 [x1, x2) である。
+   */
+  struct term_search_result_t {
+    std::uint32_t line_id;
+    curpos_t y;
+    curpos_t x1, x2;
+  };
+
   /*?lwiki
    * @class class term_scoll_buffer_t;
    * 0 個以上 m_capacity 個以下の行を保持する。
-   * 最初の要素は data[m_rotate] にある。
+   *
+   * 古い行は line_block_t::capacity 行毎に line_block_t に凍結して m_blocks に保持し、
+   * 新しい m_freeze_age 行程度は line_t のまま m_lines に保持する。
+   * 凍結した行は operator[] でアクセスした時にブロック単位で展開する。
+   * 展開したブロックは最大 thaw_cache_size 個まで保持し、
+   * 非 const の operator[] で参照したブロックだけを追い出す時に (選択範囲の変更などを反映する為に) 凍結し直す。
+   *
+   * 退避ファイルを有効にした時 (set_spill) は m_capacity を超えた古い行を破棄せずに、
+   * ブロック単位で退避ファイルに書き出して mmap で読み出す。
+   * この時 m_capacity はメモリ上に保持する行数の目安になり、
+   * 全体の行数には上限がなくなる。
+   * 退避したブロックを書き直す時は元の領域に収まればその場で上書きし、
+   * 収まらなければ末尾に追記する。使われなくなった領域が多くなればファイルを詰め直す。
    *
    * @remarks
-   * `data.size() < m_capacity` の時は常に `m_rotate = 0` である。
-   * `data.size() == m_capacity` の時は `m_rotate` は有限の値を取りうる。
-   * `data.size() > m_capacity` になる事はない。
+   * 行は古い順に、退避ファイル上のブロック (m_spilled)、
+   * メモリ上の凍結ブロック (m_blocks)、凍結していない行 (m_lines) に並ぶ。
+   * ブロックには最初に作られた順に通し番号を付ける。
+   * m_spilled[i] の通し番号は m_spill_serial + i で、
+   * m_blocks[i] の通し番号は m_block_serial + i である。
+   *
+   * m_blocks の各ブロックは常に line_block_t::capacity 行を保持する。
+   * 最初のブロックの先頭 m_block_skip 行は既に破棄された行である。
+   * 同様に m_spilled の最初のブロックの先頭 m_spill_skip 行は退避前に破棄された行である。
+   *
+   * 凍結した行に対して operator[] が返す参照は、
+   * 他のブロックが thaw_cache_size 回展開されるまで有効である。
+   *
+   * transfer で受け取った行はセルの領域ごと保持し、
+   * 破棄・凍結した行のセルの領域は m_line_pool に回収して盤面の新しい行で再利用する。
+   *
+   * 全文検索の索引 (m_search_index) には追加された全ての行を登録する。
+   * 索引の通し番号 m_search_index.begin() + i が i 行目に対応する。
+   * 索引が行に追いついていない時は行の追加毎に少しずつ登録し、検索の前に全て登録する。
+   *
+   * 端末の幅が変わった時 (set_width) はメモリ上の行を lattr_wrapped の連鎖毎に折り返し直す。
+   * 全ての行を一度に処理すると時間がかかるので、新しい行から順に必要になった分だけ処理する。
+   * 処理中 (m_reflow_active) は m_blocks と m_pending_lines の行が未処理で、
+   * m_lines の行は処理済みである。行は m_spilled, m_blocks, m_pending_lines, m_lines の順に並ぶ。
+   * 処理中は凍結と索引の更新を止め、索引は処理が終わった後に作り直す。
+   * 退避ファイルに書き出した行は折り返し直さない。
    */
   class term_scroll_buffer_t {
     typedef term_scroll_buffer_t self;
     typedef line_t value_type;
 
     attr_table* m_atable;
-    std::vector<value_type> data;
-    std::size_t m_rotate = 0;
     std::size_t m_capacity;
 
+    struct spilled_block_t {
+      std::uint64_t offset;
+      std::uint32_t size;
+      std::uint32_t extent; // ファイル上に確保した領域の大きさ (size 以上)
+      bool has_selection;
+    };
+    static constexpr std::uint64_t spill_compact_threshold = 1 << 20;
+    std::unique_ptr<contra::sys::spill_file> m_spill;
+    std::vector<spilled_block_t> m_spilled;
+    std::size_t m_spill_serial = 0; // m_spilled.front() の通し番号
+    std::size_t m_spill_skip = 0;
+    std::size_t m_spilled_count = 0; // 退避した行の数
+    std::uint64_t m_spill_dead = 0; // 退避ファイル上の使われなくなった領域の大きさ
+
+    contra::util::ring_deque<line_block_t> m_blocks;
+    std::size_t m_block_serial = 0; // m_blocks.front() の通し番号
+    std::size_t m_block_skip = 0;
+    std::size_t m_frozen_count = 0; // 凍結された行のうち破棄されていない行の数
+    contra::util::ring_deque<line_t> m_lines;
+    std::size_t m_freeze_age = 512;
+
+    // 折り返し直しの状態
+    static constexpr std::size_t reflow_chain_limit = 1024; // 一度に処理する連鎖の最大行数
+    curpos_t m_width = 0;
+    bool m_reflow_active = false;
+    contra::util::ring_deque<line_t> m_pending_lines;
+    std::uint32_t* m_line_id_source = nullptr; // 行が増えた時に新しい id を割り当てる
+    std::vector<line_t> m_reflow_input;
+    std::vector<line_t> m_reflow_output;
+
+    // 破棄・凍結した行のセルの領域 (盤面の新しい行で再利用する)
+    line_buffer_pool m_line_pool;
+    std::vector<line_t> m_freeze_buffer;
+    line_block_t m_spare_block; // 破棄したブロック (次に凍結する時に領域を再利用する)
+
+    static constexpr std::size_t thaw_cache_size = 4;
+    struct thawed_block_t {
+      std::size_t serial = (std::size_t) -1;
+      std::uint64_t last_access = 0;
+      bool dirty = false; // 展開後に変更された可能性がある
+      std::vector<line_t> lines;
+    };
+    std::vector<thawed_block_t> m_thawed;
+    std::uint64_t m_thaw_access = 0;
+
+    // 前回の GC 以降に追加された行の数。これらの行だけが新世代の拡張属性を参照し得る。
+    std::size_t m_young_count = 0;
+
+    static constexpr std::size_t search_index_step = 16; // 行の追加毎に索引に登録する最大行数
+    bool m_search_enabled = true;
+    text_search_index m_search_index;
+    std::u32string m_search_text;
+
+    // 一度に受信した出力の処理 (begin_batch/end_batch) の状態
+    std::size_t m_batch_depth = 0;
+    bool m_batch_deferred = false; // 凍結と索引の登録を end_batch まで遅らせる
+    std::size_t m_batch_count = 0; // 遅らせている間に追加した行の数
+
   public:
-    term_scroll_buffer_t(attr_table* atable, std::size_t capacity = 0): m_atable(atable), m_capacity(capacity) {}
+    term_scroll_buffer_t(attr_table* atable, std::size_t capacity = 0): m_atable(atable), m_capacity(0) {
+      set_capacity(capacity);
+    }
 
   public:
     std::size_t capacity() const {
@@ -123,52 +233,193 @@ namespace ansi {
     }
     void set_capacity(std::size_t value) {
       value = std::min<std::size_t>(value, limit::maximal_scroll_buffer_size);
-      if (data.size() < value) {
-        if (m_rotate > 0) {
-          std::rotate(data.begin(), data.begin() + m_rotate, data.end());
-          m_rotate = 0;
-        }
-      } else if (data.size() > value) {
-        std::size_t const new_begin = (m_rotate - value + m_capacity) % m_capacity;
-        if (new_begin)
-          contra::util::partial_rotate(data.begin(), data.begin() + new_begin, data.end(), value);
-        data.resize(value, line_t(this->m_atable));
-      }
       this->m_capacity = value;
-    }
+      // Note: LF の連続で凍結を遅らせた時 (begin_batch) は最大で m_capacity 行近くを一度に凍結して回収する。
+      //   上限が小さいと溢れた領域を解放して次の行で確保し直すので、メモリ上の行数まで保持できる様にする。
+      //   回収した領域の量は凍結前にメモリ上の行が使っていた量を超えない。
+      m_line_pool.set_max_buffers(std::max(line_buffer_pool::default_max_buffers, value + line_block_t::capacity));
+      evict_old_lines();
+    }
+
+    /*?lwiki
+     * @fn void set_freeze_age(std::size_t value);
+     *   value 行より古い行を凍結する様にする。0 を指定すると凍結しない。
+     *   既に凍結した行はそのまま残る。
+     * @fn bool set_spill(bool value);
+     *   退避ファイルを使うかどうかを設定する。
+     *   退避ファイルを作成できなかった時は false を返す。
+     *   無効にした時は退避済みの行を破棄する。
+     */
+    std::size_t freeze_age() const { return m_freeze_age; }
+    void set_freeze_age(std::size_t value) {
+      this->m_freeze_age = value;
+      freeze_old_lines();
+    }
+    bool is_spill_enabled() const { return m_spill != nullptr; }
+    bool set_spill(bool value);
+
+    /*?lwiki
+     * @fn void set_search_index(bool value);
+     *   全文検索の索引を使うかどうかを設定する。有効にした時は既存の行から索引を作り直す。
+     * @fn void search(search_pattern const& pattern, std::vector<term_search_result_t>& result) const;
+     *   pattern に一致する範囲を古い順に result に追加する。
+     *   索引が使える時は候補のグループに含まれる行だけを確認する。
+     */
+    bool is_search_index_enabled() const { return m_search_enabled; }
+    void set_search_index(bool value);
+    std::size_t search_index_memory_usage() const { return m_search_index.memory_usage(); }
+    void search(search_pattern const& pattern, std::vector<term_search_result_t>& result) const;
+
+    /*?lwiki
+     * @fn void set_width(curpos_t width);
+     *   端末の幅を設定する。幅が変わった時はメモリ上の行を全て未処理にして折り返し直しを始める。
+     * @fn void set_line_id_source(std::uint32_t* counter);
+     *   折り返し直しで行が増えた時に新しい行の id を割り当てるカウンタを設定する。
+     *   設定していない時は折り返し直しを行わない。
+     * @fn void reflow(std::size_t count);
+     *   末尾の count 行が処理済みになるまで折り返し直しを進める。
+     *   行数は処理に伴って変化するが、処理済みの行の添字は末尾からの位置が変わらない。
+     */
+    curpos_t width() const { return m_width; }
+    void set_width(curpos_t width);
+    void set_line_id_source(std::uint32_t* counter) { m_line_id_source = counter; }
+    bool is_reflow_active() const { return m_reflow_active; }
+    void reflow(std::size_t count) {
+      while (m_reflow_active && m_lines.size() < count && reflow_step());
+    }
+
+    /*?lwiki
+     * @fn void begin_batch(std::size_t expected_count);
+     * @fn void end_batch();
+     *   一度に受信した出力を処理する間 (term_t::write_bytes 等) を囲む。入れ子にできる。
+     *   expected_count には間に transfer される行数の見込み (LF の数など) を指定する。
+     *   見込みが容量を超える時 (LF の連続で大量の行が流れる時) は、
+     *   間に追加した行の凍結と索引の登録を end_batch までまとめて遅らせる。
+     *   これにより同じ間に容量を超えて破棄される行は凍結も索引の登録もせずに捨てる。
+     *   見込みが外れても end_batch で残った行を処理するので結果は変わらない。
+     */
+    void begin_batch(std::size_t expected_count) {
+      if (m_batch_depth++ == 0)
+        m_batch_deferred = !m_spill && m_capacity && expected_count > m_capacity;
+    }
+    void end_batch();
 
     void transfer(value_type&& line) {
       if (m_capacity == 0) return;
-      if (data.size() < m_capacity) {
-        data.emplace_back(std::move(line));
+      if (!m_spill && size() >= m_capacity) drop_front(size() - m_capacity + 1);
+      // Note: 折り返し直しは新しい行を追加する度に少しずつ進める。
+      if (m_reflow_active) reflow_step();
+      m_lines.emplace_back(std::move(line));
+      m_young_count = m_reflow_active ? size() : std::min(m_young_count + 1, size());
+      if (m_batch_deferred) {
+        m_batch_count++;
       } else {
-        auto check = data[m_rotate].cells().capacity();
-        data[m_rotate].transfer_from(line);
-        mwg_check(check == line.cells().capacity(),"%zu %zu", check, line.cells().capacity());
-        m_rotate = (m_rotate + 1) % m_capacity;
+        if (m_search_enabled && !m_reflow_active) update_search_index(search_index_step);
+        freeze_old_lines();
       }
+      if (m_spill) evict_old_lines();
     }
 
     value_type& operator[](std::size_t index) {
-      return data[(m_rotate + index) % data.size()];
+      return at(index, true);
     }
     value_type const& operator[](std::size_t index) const {
-      return data[(m_rotate + index) % data.size()];
+      // Note: 展開したブロックのキャッシュを更新するだけなので論理的には const である。
+      return const_cast<self&>(*this).at(index, false);
     }
 
-    std::size_t size() const { return data.size(); }
+    std::size_t size() const { return m_spilled_count + m_frozen_count + m_pending_lines.size() + m_lines.size(); }
 
     typedef contra::util::indexer_iterator<value_type, self, std::size_t> iterator;
     typedef contra::util::indexer_iterator<const value_type, const self, std::size_t> const_iterator;
     iterator begin() { return {this, (std::size_t) 0}; }
-    iterator end() { return {this, data.size()}; }
+    iterator end() { return {this, size()}; }
     const_iterator begin() const { return {this, (std::size_t) 0}; }
-    const_iterator end() const { return {this, data.size()}; }
+    const_iterator end() const { return {this, size()}; }
 
   public:
-    void gc_mark() {
-      for (auto& line : data) line.gc_mark();
+    // 以下は凍結した行を可能な限り展開せずに処理する。
+    std::uint32_t line_id(std::size_t index) const;
+    bool clear_selection(std::size_t index) {
+      if (index < m_spilled_count + m_frozen_count && !may_have_selection(index)) return false;
+      if (!at(index, false).clear_selection()) return false;
+      at(index, true); // 展開したブロックを書き戻す様に記録する
+      return true;
+    }
+    bool clear_selection() {
+      bool dirty = false;
+      for (std::size_t i = 0, iN = size(); i < iN; i++)
+        dirty |= clear_selection(i);
+      return dirty;
+    }
+    curpos_t extract_selection(std::size_t index, std::u32string& data) const {
+      if (index < m_spilled_count + m_frozen_count && !may_have_selection(index)) {
+        data.clear();
+        return 0;
+      }
+      return (*this)[index].extract_selection(data);
+    }
+
+    std::size_t frozen_count() const { return m_frozen_count; }
+    std::size_t frozen_memory_usage() const {
+      std::size_t result = 0;
+      for (line_block_t const& block : m_blocks) result += block.memory_usage();
+      return result;
+    }
+    std::size_t spilled_count() const { return m_spilled_count; }
+    std::uint64_t spill_file_size() const { return m_spill ? m_spill->size() : 0; }
+
+    line_buffer_pool& line_pool() { return m_line_pool; }
+    line_buffer_pool const& line_pool() const { return m_line_pool; }
+
+  private:
+    // modify は凍結した行を書き換える可能性があるかどうか。
+    value_type& at(std::size_t index, bool modify) {
+      if (index < m_spilled_count + m_frozen_count) return thaw(index, modify);
+      index -= m_spilled_count + m_frozen_count;
+      if (index < m_pending_lines.size()) return m_pending_lines[index];
+      return m_lines[index - m_pending_lines.size()];
+    }
+
+    // index 行目を含むブロックの通し番号と、ブロック内の位置を求める。
+    std::size_t locate_block(std::size_t index, std::size_t& line_index) const {
+      if (index < m_spilled_count) {
+        std::size_t const k = index + m_spill_skip;
+        line_index = k % line_block_t::capacity;
+        return m_spill_serial + k / line_block_t::capacity;
+      } else {
+        std::size_t const k = index - m_spilled_count + m_block_skip;
+        line_index = k % line_block_t::capacity;
+        return m_block_serial + k / line_block_t::capacity;
+      }
     }
+    bool may_have_selection(std::size_t index) const {
+      std::size_t line_index;
+      std::size_t const serial = locate_block(index, line_index);
+      for (thawed_block_t const& entry : m_thawed)
+        if (entry.serial == serial) return true;
+      if (serial < m_block_serial)
+        return m_spilled[serial - m_spill_serial].has_selection;
+      return m_blocks[serial - m_block_serial].has_selection();
+    }
+
+    void drop_front(std::size_t count);
+    void evict_old_lines();
+    void freeze_front_lines(contra::util::ring_deque<line_t>& source);
+    void freeze_old_lines();
+    bool unfreeze_back_block();
+    bool reflow_step();
+    void update_search_index(std::size_t count);
+    bool spill_front_block();
+    bool write_spilled_block(std::size_t serial, line_block_t const& block);
+    void compact_spill_file();
+    void load_block(std::size_t serial, std::vector<line_t>& lines);
+    line_t& thaw(std::size_t index, bool modify);
+
+  public:
+    void gc_mark();
+    void gc_mark_young();
+    void gc_promote() { m_young_count = 0; }
   };
 
   struct board_t {
@@ -235,6 +486,14 @@ namespace ansi {
       m_yunit = limit::term_yunit.clamp(yunit);
     }
 
+    /*?lwiki
+     * @fn void reflow(curpos_t width, curpos_t height, term_scroll_buffer_t* scroll_buffer);
+     *   大きさを変更する。幅が変わった時は lattr_wrapped で繋がった行を折り返し直し、
+     *   カーソルの位置も内容に合わせて移動する。
+     *   行が溢れた時はカーソルが画面内に残る範囲で上の行を scroll_buffer に移し、残りは下から捨てる。
+     */
+    void reflow(curpos_t width, curpos_t height, term_scroll_buffer_t* scroll_buffer);
+
   public:
     curpos_t x() const { return cur.x(); }
     curpos_t y() const { return cur.y(); }
@@ -269,8 +528,9 @@ namespace ansi {
       for (curpos_t y = y1; y < y2; y++)
         scroll_buffer.transfer(std::move(m_lines[y]));
     }
-    void initialize_lines(curpos_t y1, curpos_t y2, attr_t const& fill_attr) {
+    void initialize_lines(curpos_t y1, curpos_t y2, attr_t const& fill_attr, line_buffer_pool* pool = nullptr) {
       for (curpos_t y = y1; y < y2; y++) {
+        if (pool) pool->prepare(m_lines[y], m_width);
         m_lines[y].clear(m_width, fill_attr);
         m_lines[y].set_id(m_line_count++);
       }
@@ -288,13 +548,15 @@ namespace ansi {
       y1 = contra::clamp(y1, 0, m_height);
       y2 = contra::clamp(y2, 0, m_height);
       if (y1 >= y2 || count == 0) return;
+      // スクロールバッファに移した行は回収済みの領域で初期化する。
+      line_buffer_pool* const pool = scroll_buffer ? &scroll_buffer->line_pool() : nullptr;
       if (y1 == 0 && y2 == m_height) {
         if (count < 0) {
           count = -count;
           if (count > m_height) count = m_height;
           if (scroll_buffer)
             transfer_lines(0, count, *scroll_buffer);
-          initialize_lines(0, count, fill_attr);
+          initialize_lines(0, count, fill_attr, pool);
           m_lines.rotate(count);
         } else if (count > 0) {
           if (count > m_height) count = m_height;
@@ -307,20 +569,18 @@ namespace ansi {
       if (std::abs(count) >= y2 - y1) {
         if (count < 0 && scroll_buffer)
           transfer_lines(y1, y2, *scroll_buffer);
-        initialize_lines(y1, y2, fill_attr);
+        initialize_lines(y1, y2, fill_attr, pool);
       } else if (count > 0) {
-        auto const it1 = m_lines.begin() + y1;
-        auto const it2 = m_lines.begin() + y2;
-        std::move_backward(it1, it2 - count, it2);
+        // Note: 消える行のセルの領域を再利用する為に回転する。
+        //   line_t は移動せずに行の添字の表だけを並べ替える。
+        m_lines.rotate_range(y1, y2 - count, y2);
         initialize_lines(y1, y1 + count, fill_attr);
       } else {
         count = -count;
-        auto const it1 = m_lines.begin() + y1;
-        auto const it2 = m_lines.begin() + y2;
         if (scroll_buffer)
           transfer_lines(y1, y1 + count, *scroll_buffer);
-        std::move(it1 + count, it2, it1);
-        initialize_lines(y2 - count, y2, fill_attr);
+        m_lines.rotate_range(y1, y1 + count, y2);
+        initialize_lines(y2 - count, y2, fill_attr, pool);
       }
     }
     void clear_screen() {
@@ -334,6 +594,7 @@ namespace ansi {
     void clear_screen(term_scroll_buffer_t& scroll_buffer) {
       for (auto& line : m_lines) {
         scroll_buffer.transfer(std::move(line));
+        scroll_buffer.line_pool().prepare(line, m_width);
         line.clear();
         line.set_id(m_line_count++);
       }
@@ -350,8 +611,8 @@ namespace ansi {
       for (auto const& line : m_lines) {
         if (line.lflags() & lattr_used) {
           for (auto const& cell : line.cells()) {
-            if (cell.character.is_wide_extension()) continue;
-            char32_t c = (char32_t) (cell.character.value & unicode_mask);
+            if (cell.character().is_wide_extension()) continue;
+            char32_t c = (char32_t) (cell.character().value & unicode_mask);
             if (c == 0) c = '~';
             contra::encoding::put_u8(c, file);
           }
@@ -570,6 +831,18 @@ namespace ansi {
       set_mode(modeSpec, value);
     }
 
+    // 描画に使う状態 (パレット・既定色・モード・カーソル形状) だけを写す (term_t::copy_frame)。
+    void copy_display_state(tstate_t const& s) {
+      std::copy(std::begin(s.m_rgba256), std::end(s.m_rgba256), std::begin(m_rgba256));
+      std::copy(std::begin(s.m_mode_flags), std::end(s.m_mode_flags), std::begin(m_mode_flags));
+      m_default_fg_space = s.m_default_fg_space;
+      m_default_bg_space = s.m_default_bg_space;
+      m_default_fg_color = s.m_default_fg_color;
+      m_default_bg_color = s.m_default_bg_color;
+      m_cursor_shape = s.m_cursor_shape;
+      lflags = s.lflags;
+    }
+
     bool dcsm() const { return get_mode(mode_bdsm) || get_mode(mode_dcsm); }
 
     bool is_cursor_visible() const { return get_mode(mode_dectcem); }
@@ -612,12 +885,117 @@ namespace ansi {
     void add(frame_snapshot_t* snapshot);
   };
 
+  /*?lwiki
+   * @class sgr_cache_t
+   *   TUI アプリケーションは同じ SGR を何度も繰り返し送ってくるので、
+   *   (SGR パラメータのバイト列, mode_grcm, 適用前の属性) から
+   *   適用後の属性への対応を記録し、解析と attr_builder の操作を省略する。
+   *   拡張属性は attr_t ではなく attribute_t の値として保持するので、
+   *   attr_table の GC によって無効になることはない。
+   *
+   *   Note: キャッシュに当たった時は未知の SGR 値に対する警告も省略される。
+   */
+  class sgr_cache_t {
+  public:
+    static constexpr std::size_t max_key_length = 24;
+    static constexpr std::size_t table_size = 64;
+
+    struct entry_t {
+      byte key[max_key_length];
+      byte key_length = 0;
+      bool grcm = false;
+      bool valid = false;
+      attr_t old_attr = 0;
+      attribute_t old_attribute;
+      attr_t new_attr = 0;
+      attribute_t new_attribute;
+    };
+  private:
+    entry_t m_table[table_size];
+
+    std::size_t m_hit_count = 0;
+    std::size_t m_miss_count = 0;
+
+  public:
+    std::size_t hit_count() const { return m_hit_count; }
+    std::size_t miss_count() const { return m_miss_count; }
+
+  private:
+    static std::uint32_t hash(byte const* key, std::size_t length, bool grcm, attr_t attr, attribute_t const& attribute) {
+      // FNV-1a
+      std::uint32_t h = 2166136261u;
+      auto _mix = [&h] (std::uint32_t value) { h = (h ^ value) * 16777619u; };
+      for (std::size_t i = 0; i < length; i++) _mix(key[i]);
+      _mix(grcm);
+      _mix((std::uint32_t) attr);
+      _mix((std::uint32_t) attribute.aflags);
+      _mix((std::uint32_t) attribute.xflags);
+      _mix(attribute.fg);
+      _mix(attribute.bg);
+      _mix(attribute.dc);
+      return h ^ h >> 16;
+    }
+
+  public:
+    /*?lwiki
+     * @fn bool lookup(seq, grcm, abuild, slot);
+     *   一致する項目があれば abuild に結果を設定して true を返す。
+     *   見つからなかった場合は store で使う slot を設定して false を返す。
+     *   キーに収まらない長さの SGR は slot に nullptr を設定する。
+     */
+    bool lookup(sequence const& seq, bool grcm, attr_builder& abuild, entry_t*& slot) {
+      slot = nullptr;
+      std::size_t const length = seq.parameter_size();
+      if (length > max_key_length) {
+        m_miss_count++;
+        return false;
+      }
+
+      byte key[max_key_length];
+      char32_t const* param = seq.parameter();
+      for (std::size_t i = 0; i < length; i++) key[i] = (byte) param[i];
+
+      attr_t attr = 0;
+      attribute_t attribute;
+      abuild.get_sgr_state(attr, attribute);
+
+      entry_t& ent = m_table[hash(key, length, grcm, attr, attribute) % table_size];
+      if (ent.valid && ent.key_length == length && ent.grcm == grcm &&
+        ent.old_attr == attr && ent.old_attribute == attribute &&
+        std::equal(key, key + length, ent.key)
+      ) {
+        m_hit_count++;
+        abuild.set_sgr_state(ent.new_attr, ent.new_attribute);
+        return true;
+      }
+
+      m_miss_count++;
+      std::copy(key, key + length, ent.key);
+      ent.key_length = length;
+      ent.grcm = grcm;
+      ent.valid = false;
+      ent.old_attr = attr;
+      ent.old_attribute = attribute;
+      slot = &ent;
+      return false;
+    }
+    void store(entry_t* slot, attr_builder const& abuild) {
+      if (!slot) return;
+      abuild.get_sgr_state(slot->new_attr, slot->new_attribute);
+      slot->valid = true;
+    }
+    void clear() {
+      for (entry_t& ent : m_table) ent.valid = false;
+    }
+  };
+
   class term_t: public contra::idevice {
   private:
     attr_table m_atable;
     tstate_t m_state {this, &this->m_atable};
     board_t m_board;
     frame_snapshot_list m_snapshots;
+    sgr_cache_t m_sgr_cache;
   public:
     tstate_t& state() { return this->m_state; }
     tstate_t const& state() const { return this->m_state; }
@@ -627,16 +1005,55 @@ namespace ansi {
     attr_table const* atable() const { return &this->m_atable; }
     frame_snapshot_list& snapshots() { return m_snapshots; }
     frame_snapshot_list const& snapshots() const { return m_snapshots; }
-
+    sgr_cache_t& sgr_cache() { return m_sgr_cache; }
+    sgr_cache_t const& sgr_cache() const { return m_sgr_cache; }
+
+    /*?lwiki
+     * @fn void gc(std::uint32_t threshold = 0);
+     *   拡張属性の GC を行う。threshold が 0 の時、または旧世代に不要な項目が
+     *   溜まっている時は full GC を行う。それ以外の時は前回の GC 以降に
+     *   スクロールバッファに移された行と画面上の行だけを走査する。
+     */
     void gc(std::uint32_t threshold = 0);
 
+    struct gc_statistics {
+      std::size_t minor_count = 0;
+      std::size_t full_count = 0;
+      std::uint64_t last_pause_usec = 0;
+      std::uint64_t max_pause_usec = 0;
+      std::uint64_t total_pause_usec = 0;
+    };
+  private:
+    gc_statistics m_gc_stats;
+  public:
+    gc_statistics const& gc_stats() const { return m_gc_stats; }
+
   public:
-    void reset_size(curpos_t width, curpos_t height) {
-      m_board.reset_size(width, height);
-    }
+    /*?lwiki
+     * @fn void reset_size(curpos_t width, curpos_t height);
+     *   端末の大きさを変更する。幅が変わった時は盤面の行を折り返し直し、
+     *   スクロールバッファの行の折り返し直しを始める。
+     *   主画面の盤面で溢れた行はスクロールバッファに移す。
+     * @fn void reflow_scroll_buffer(std::size_t count);
+     *   スクロールバッファの末尾 count 行の折り返し直しを済ませる。
+     */
+    void reset_size(curpos_t width, curpos_t height);
     void reset_size(curpos_t width, curpos_t height, coord_t xunit, coord_t yunit) {
+      this->reset_size(width, height);
       m_board.reset_size(width, height, xunit, yunit);
     }
+    void reflow_scroll_buffer(std::size_t count) {
+      m_scroll_buffer.reflow(count);
+    }
+
+    /*?lwiki
+     * @fn void copy_frame(term_view_t& view);
+     *   view の表示内容 (表示中の行・カーソル・描画に使う状態) をこの term_t の盤面に写す。
+     *   構文解析と描画を別のスレッドで行う時に、描画側が参照する複製を作るのに使う。
+     *   行は id() と version() が前回写した行と同じ時は写さない。
+     *   view は事前に update() しておく必要はない。
+     */
+    void copy_frame(term_view_t& view);
 
   public: // todo: make private
     term_scroll_buffer_t m_scroll_buffer {&this->m_atable};
@@ -647,6 +1064,21 @@ namespace ansi {
     void set_scroll_capacity(std::size_t value) {
       this->m_scroll_buffer.set_capacity(value);
     }
+    void set_scroll_freeze_age(std::size_t value) {
+      this->m_scroll_buffer.set_freeze_age(value);
+    }
+    bool set_scroll_spill(bool value) {
+      return this->m_scroll_buffer.set_spill(value);
+    }
+    void set_scroll_search_index(bool value) {
+      this->m_scroll_buffer.set_search_index(value);
+    }
+
+    /*?lwiki
+     * @fn void search(search_pattern const& pattern, std::vector<term_search_result_t>& result) const;
+     *   スクロールバッファと盤面から pattern に一致する範囲を探し、古い順に result に格納する。
+     */
+    void search(search_pattern const& pattern, std::vector<term_search_result_t>& result) const;
 
   private:
     contra::idevice* m_send_target = nullptr;
@@ -668,7 +1100,11 @@ namespace ansi {
 
   public:
     term_t(curpos_t width, curpos_t height, coord_t xunit = 7, coord_t yunit = 13):
-      m_board(&m_atable, width, height, xunit, yunit) {}
+      m_board(&m_atable, width, height, xunit, yunit)
+    {
+      m_scroll_buffer.set_line_id_source(&m_board.m_line_count);
+      m_scroll_buffer.set_width(m_board.width());
+    }
 
   public:
     curpos_t width() const { return this->m_board.width(); }
@@ -683,8 +1119,7 @@ namespace ansi {
       bool dirty = false;
       for (auto& line: m_board.m_lines)
         dirty |= line.clear_selection();
-      for (auto& line: m_scroll_buffer)
-        dirty |= line.clear_selection();
+      dirty |= m_scroll_buffer.clear_selection();
       return true;
     }
 
@@ -764,9 +1199,9 @@ namespace ansi {
       curpos_t const dir = simd ? -1 : 1;
 
       cell_t cell;
-      cell.character = marker | charflag_marker;
+      cell.set_character(marker | charflag_marker);
       cell.attribute = m_board.cur.abuild.attr();
-      cell.width = 0;
+      cell.set_width(0);
       initialize_line(m_board.line());
       m_board.line().write_cells(m_board.cur.x(), &cell, 1, 1, dir);
     }
@@ -808,6 +1243,18 @@ namespace ansi {
 #endif
       }
     }
+    void process_chars(byte const* beg, byte const* end) {
+      // Note: sequence_decoder::decode_bytes から呼び出される。
+      //   印字可能 ASCII の連続なので marker は含まれない。
+      do_insert_graphs(*this, beg, end);
+
+#ifndef NDEBUG
+      board_t& b = board();
+      mwg_assert(b.cur.is_sane(b.width()),
+        "cur: {x=%d, xenl=%d, width=%d} after InsertLength=#%zu",
+        b.cur.x(), b.cur.xenl(), b.width(), end - beg);
+#endif
+    }
 
   public:
     void do_bel() {
@@ -840,9 +1287,6 @@ namespace ansi {
 
     void process_control_character(char32_t uchar);
 
-  public:
-    csi_parameters w_csiparams;
-
   public:
     std::uint64_t w_printt_state = 0;
     std::vector<char32_t> w_printt_buff;
@@ -851,7 +1295,18 @@ namespace ansi {
       char32_t* const q0 = &w_printt_buff[0];
       char32_t* q1 = q0;
       contra::encoding::utf8_decode(data, data + size, q1, q0 + size, w_printt_state);
+      m_scroll_buffer.begin_batch(std::count(q0, q1, (char32_t) ascii_lf));
       m_seqdecoder.decode(q0, q1);
+      m_scroll_buffer.end_batch();
+    }
+    /// @fn void write_bytes(const char* data, std::size_t size);
+    ///   UTF-8 の復号と制御文字の検出を一度の走査で行います。
+    ///   w_printt_buff を経由しないので write より高速です。
+    void write_bytes(const char* data, std::size_t const size) {
+      // Note: LF の数を流れる行数の見込みとしてスクロールバッファに伝える。
+      m_scroll_buffer.begin_batch(std::count(data, data + size, (char) ascii_lf));
+      m_seqdecoder.decode_bytes(data, data + size, w_printt_state);
+      m_scroll_buffer.end_batch();
     }
     void printt(const char* text) {
       write(text, std::strlen(text));
@@ -862,7 +1317,7 @@ namespace ansi {
 
   private:
     virtual void dev_write(char const* data, std::size_t size) override {
-      this->write(data, size);
+      this->write_bytes(data, size);
     }
 
   public:
@@ -946,12 +1401,21 @@ namespace ansi {
   public:
     void set_term(term_t* term) { this->m_term = term; }
     bool scroll(curpos_t delta) {
+      if (m_scroll_amount - delta > 0) m_term->reflow_scroll_buffer(m_scroll_amount - delta);
       curpos_t new_value = contra::clamp(m_scroll_amount - delta, 0, m_term->scroll_buffer().size());
       bool const dirty = new_value != m_scroll_amount;
       m_scroll_amount = new_value;
       return dirty;
     }
+    // 論理行 y が画面外にある時、画面の中央に来る様にスクロールする。
+    bool scroll_to(curpos_t y) {
+      curpos_t const ypos = y + m_scroll_amount;
+      if (0 <= ypos && ypos < height()) return false;
+      return scroll(ypos - height() / 2);
+    }
     void update() {
+      // Note: 表示するスクロールバッファの行は折り返し直しを済ませておく。
+      m_term->reflow_scroll_buffer(m_scroll_amount);
       m_scroll_amount = std::min(m_scroll_amount, (curpos_t) m_term->scroll_buffer().size());
       m_x = m_term->cursor().x();
       m_y = m_term->cursor().y() + m_scroll_amount;
@@ -1015,7 +1479,27 @@ namespace ansi {
       }
     }
     line_t& lline(curpos_t y) {
-      return const_cast<line_t&>(const_cast<term_view_t const*>(this)->lline(y));
+      if (y >= 0) return const_cast<line_t&>(const_cast<term_view_t const*>(this)->lline(y));
+      // Note: 書き換えた凍結行を書き戻す様に非 const の operator[] を使う。
+      auto& scroll_buffer = m_term->m_scroll_buffer;
+      return scroll_buffer[scroll_buffer.size() + y];
+    }
+
+    // 以下はスクロールバッファの凍結された行を不要に展開しない。
+    std::uint32_t lline_id(curpos_t y) const {
+      if (y >= 0) return lline(y).id();
+      auto const& scroll_buffer = m_term->scroll_buffer();
+      return scroll_buffer.line_id(scroll_buffer.size() + y);
+    }
+    bool clear_selection(curpos_t y) {
+      if (y >= 0) return lline(y).clear_selection();
+      auto& scroll_buffer = m_term->m_scroll_buffer;
+      return scroll_buffer.clear_selection(scroll_buffer.size() + y);
+    }
+    curpos_t extract_selection(curpos_t y, std::u32string& data) const {
+      if (y >= 0) return lline(y).extract_selection(data);
+      auto const& scroll_buffer = m_term->scroll_buffer();
+      return scroll_buffer.extract_selection(scroll_buffer.size() + y, data);
     }
     curpos_t logical_ybeg() const {
       return -(curpos_t) m_term->scroll_buffer().size();
@@ -1043,7 +1527,7 @@ namespace ansi {
     struct snapshot_line_t {
       std::uint32_t id = (std::uint32_t) -1;
       std::uint32_t version = 0;
-      std::vector<cell_t> content;
+      line_storage::buffer_type content;
     };
     std::vector<snapshot_line_t> lines;
 
@@ -1075,11 +1559,8 @@ namespace ansi {
     }
 
     void gc_mark(attr_table& atable) {
-      for (auto& line: lines) {
-        for (auto& cell: line.content) {
-          atable.mark(&cell.attribute);
-        }
-      }
+      for (auto& line: lines)
+        line_storage::for_each_attribute(line.content, [&atable] (attr_t& attr) { atable.mark(&attr); });
     }
   };
 
@@ -0,0 +1,391 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstdarg>
+#include <string>
+#include <memory>
+#include <iterator>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "contradef.hpp"
+#include "sequence.hpp"
+#include "enc.utf8.hpp"
+#include "ansi/term.hpp"
+#include "sys.mmap.hpp"
+
+// contra bench: term_t の処理速度の測定
+//
+//   contra bench [options] [file...]
+//
+//   -w WIDTH, -H HEIGHT   端末の大きさ (既定 80x24)
+//   -c SIZE[,SIZE...]     一度に write_bytes に渡す大きさ (既定 4096,16384)
+//                         pty から読み取る単位 (fd_read_buffer_size) に相当する。
+//   -s LINES              スクロールバッファの行数 (既定 1000)
+//   -m MIB                生成する標準コーパスの大きさ (既定 4)
+//   -r COUNT              繰り返し回数。最も速かった回の結果を表示する (既定 3)
+//   --save DIR            標準コーパスを DIR/<名前>.txt に書き出して終了する
+//
+// file を指定しない時は標準コーパスを生成して測定する。
+// file は mmap で読み込み、pty からの入力と同じ様に term_t::write_bytes に渡す。
+// 結果は MB/s, lines/s (LF の数), seqs/s (制御文字と制御機能の数) で表示する。
+// pool/alloc, pool/reuse は最後の回で行のセルの領域を新しく確保・再利用した回数 (line_buffer_pool)。
+//   定常的なスクロールでは pool/alloc は暖機の分 (スクロールバッファと盤面の行数程度) に留まる。
+//   入力の量に比例して増える時は回収した領域を捨てている。
+
+namespace contra::bench {
+namespace {
+
+  //---------------------------------------------------------------------------
+  // 標準コーパス
+
+  class corpus_writer {
+    std::vector<byte>& m_data;
+    std::uint32_t m_seed = 12345;
+
+  public:
+    corpus_writer(std::vector<byte>& data): m_data(data) {}
+
+    std::uint32_t next(std::uint32_t n) {
+      m_seed ^= m_seed << 13;
+      m_seed ^= m_seed >> 17;
+      m_seed ^= m_seed << 5;
+      return m_seed % n;
+    }
+
+    std::size_t size() const { return m_data.size(); }
+    void put(const char* str) {
+      m_data.insert(m_data.end(), str, str + std::strlen(str));
+    }
+    void put(char32_t u) { contra::encoding::put_u8(u, m_data); }
+    void putf(const char* fmt, ...) {
+      char buff[256];
+      va_list args;
+      va_start(args, fmt);
+      int const n = std::vsnprintf(buff, sizeof buff, fmt, args);
+      va_end(args);
+      if (n > 0) m_data.insert(m_data.end(), buff, buff + std::min<int>(n, sizeof buff - 1));
+    }
+    void put_word(std::size_t min_length, std::size_t max_length) {
+      std::size_t const n = min_length + next(max_length - min_length + 1);
+      for (std::size_t i = 0; i < n; i++) m_data.push_back('a' + next(26));
+    }
+  };
+
+  // ビルドやサーバのログの様な ASCII の行。
+  void generate_ascii_log(corpus_writer& w, std::size_t size) {
+    static const char* levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    for (std::uint32_t i = 0; w.size() < size; i++) {
+      w.putf("2024-03-%02u %02u:%02u:%02u.%03u [%s] ",
+        1 + i / 86400 % 28, i / 3600 % 24, i / 60 % 60, i % 60, w.next(1000), levels[w.next(6)]);
+      w.put_word(4, 10);
+      w.putf("-%u: ", w.next(16));
+      for (std::uint32_t k = 0, kN = 3 + w.next(8); k < kN; k++) {
+        w.put_word(2, 9);
+        w.put(k + 1 == kN ? "" : " ");
+      }
+      w.putf(" id=%u elapsed=%ums\r\n", w.next(1000000), w.next(5000));
+    }
+  }
+
+  // ls --color の出力。短い名前毎に SGR が切り替わる。
+  void generate_sgr_ls(corpus_writer& w, std::size_t size) {
+    static const char* colors[] = {"0", "01;34", "01;32", "01;36", "40;33;01", "01;31", "01;35", "30;42"};
+    while (w.size() < size) {
+      for (int k = 0; k < 6; k++) {
+        w.putf("\x1b[0m\x1b[%sm", colors[w.next(8)]);
+        w.put_word(3, 10);
+        if (w.next(3) == 0) w.put(".txt");
+        w.put("\x1b[0m  ");
+      }
+      w.put("\r\n");
+    }
+  }
+
+  // 24 bit 色の半ブロックによる画像の表示。
+  void generate_truecolor(corpus_writer& w, std::size_t size) {
+    for (std::uint32_t y = 0; w.size() < size; y++) {
+      for (std::uint32_t x = 0; x < 80; x++) {
+        w.putf("\x1b[38;2;%u;%u;%um\x1b[48;2;%u;%u;%um",
+          (x * 3 + y) % 256, (y * 5) % 256, (x * y) % 256,
+          (x * 3 + y + 1) % 256, (y * 5 + 2) % 256, (x * y + x) % 256);
+        w.put(U'▀');
+      }
+      w.put("\x1b[0m\r\n");
+    }
+  }
+
+  // 日本語・中国語の文章。全角文字の折り返しを含む。
+  void generate_cjk(corpus_writer& w, std::size_t size) {
+    static const char32_t* words[] = {
+      U"端末", U"文字", U"表示", U"です", U"の", U"を",
+      U"エミュレータ", U"。", U"、", U"中文测试",
+      U"漢字", U"かな", U"ASCII", U" ", U"（全角）",
+    };
+    while (w.size() < size) {
+      for (std::uint32_t k = 0, kN = 10 + w.next(40); k < kN; k++)
+        for (char32_t const* p = words[w.next(15)]; *p; p++) w.put(*p);
+      w.put("\r\n");
+    }
+  }
+
+  // vim の様な全画面の再描画。CUP, EL, 構文色付け, 状態行, スクロール領域を含む。
+  void generate_vim_redraw(corpus_writer& w, std::size_t size) {
+    static const char* syntax[] = {"38;5;130", "38;5;28", "1;38;5;21", "38;5;124", "0"};
+    for (std::uint32_t frame = 0; w.size() < size; frame++) {
+      w.put("\x1b[?25l");
+      if (frame % 4 == 0) {
+        // 全画面の再描画
+        w.put("\x1b[H\x1b[2J");
+        for (int y = 1; y <= 23; y++) {
+          w.putf("\x1b[%d;1H\x1b[38;5;130m%4u \x1b[m", y, frame + y);
+          for (std::uint32_t k = 0, kN = w.next(9); k < kN; k++) {
+            w.putf("\x1b[%sm", syntax[w.next(5)]);
+            w.put_word(1, 8);
+            w.put("\x1b[m ");
+          }
+          w.put("\x1b[K");
+        }
+      } else {
+        // スクロール領域を使った 1 行のスクロール
+        w.put("\x1b[1;23r\x1b[23;1H\n\x1b[r");
+        w.putf("\x1b[23;1H\x1b[38;5;130m%4u \x1b[m", frame);
+        w.put_word(4, 40);
+        w.put("\x1b[K");
+      }
+      w.putf("\x1b[24;1H\x1b[7m main.cpp [+] %u,%u \x1b[27m\x1b[K", frame % 1000, w.next(80));
+      w.putf("\x1b[%u;%uH\x1b[?25h", 1 + w.next(23), 6 + w.next(60));
+    }
+  }
+
+  // 右書きの文字を含む文章。SDS による双方向文字列と SPD による行の向きの切り替えを含む。
+  void generate_bidi(corpus_writer& w, std::size_t size) {
+    static const char32_t* words[] = {
+      U"שלום", U"עולם", U"مرحبا",
+      U"العالم", U"hello", U"123", U" ", U" ",
+    };
+    for (std::uint32_t i = 0; w.size() < size; i++) {
+      if (i % 50 == 0) w.put(i % 100 == 0 ? "\x1b[3 S" : "\x1b[0 S");
+      for (std::uint32_t k = 0, kN = 4 + w.next(12); k < kN; k++) {
+        bool const sds = w.next(4) == 0;
+        if (sds) w.put("\x1b[2]");
+        for (char32_t const* p = words[w.next(8)]; *p; p++) w.put(*p);
+        if (sds) w.put("\x1b[0]");
+      }
+      w.put("\r\n");
+    }
+    w.put("\x1b[0 S");
+  }
+
+  struct corpus_t {
+    std::string name;
+    std::vector<byte> buffer;
+    std::unique_ptr<contra::sys::mapped_file> file;
+    char const* data = nullptr;
+    std::size_t size = 0;
+  };
+
+  struct generator_t {
+    const char* name;
+    void (*generate)(corpus_writer& w, std::size_t size);
+  };
+  constexpr generator_t generators[] = {
+    {"ascii-log", &generate_ascii_log},
+    {"sgr-ls", &generate_sgr_ls},
+    {"truecolor", &generate_truecolor},
+    {"cjk", &generate_cjk},
+    {"vim-redraw", &generate_vim_redraw},
+    {"bidi", &generate_bidi},
+  };
+
+  //---------------------------------------------------------------------------
+  // 測定
+
+  // 制御文字と制御機能の数を数える。
+  struct sequence_counter {
+    std::size_t count = 0;
+    void process_invalid_sequence(sequence const&) { count++; }
+    void process_escape_sequence(sequence const&) { count++; }
+    void process_control_sequence(sequence const&) { count++; }
+    void process_command_string(sequence const&) { count++; }
+    void process_character_string(sequence const&) { count++; }
+    void process_control_character(char32_t) { count++; }
+    void process_char(char32_t) {}
+    void process_chars(char32_t const*, char32_t const*) {}
+    void process_chars(byte const*, byte const*) {}
+  };
+
+  std::size_t count_sequences(char const* data, std::size_t size) {
+    sequence_counter counter;
+    sequence_decoder_config config;
+    sequence_decoder<sequence_counter> decoder(&counter, &config);
+    std::uint64_t utf8_state = 0;
+    decoder.decode_bytes(data, data + size, utf8_state);
+    return counter.count;
+  }
+
+  struct bench_params {
+    contra::ansi::curpos_t width = 80, height = 24;
+    std::vector<std::size_t> chunk_sizes {4096, 16384};
+    std::size_t scroll_buffer_size = 1000;
+    std::size_t corpus_size = 4 << 20;
+    int repeat = 3;
+    const char* save_directory = nullptr;
+    std::vector<const char*> files;
+  };
+
+  struct measure_result {
+    double time = -1.0; // 最も速かった回の時間 [s]
+    std::size_t pool_allocations = 0;
+    std::size_t pool_recycles = 0;
+  };
+
+  measure_result measure(bench_params const& params, corpus_t const& corpus, std::size_t chunk_size) {
+    measure_result result;
+    for (int r = 0; r < params.repeat; r++) {
+      contra::ansi::term_t term(params.width, params.height);
+      term.set_scroll_capacity(params.scroll_buffer_size);
+
+      auto const time0 = std::chrono::high_resolution_clock::now();
+      for (std::size_t offset = 0; offset < corpus.size; offset += chunk_size)
+        term.write_bytes(corpus.data + offset, std::min(chunk_size, corpus.size - offset));
+      auto const time1 = std::chrono::high_resolution_clock::now();
+
+      double const sec = std::chrono::duration<double>(time1 - time0).count();
+      if (result.time < 0.0 || sec < result.time) result.time = sec;
+      result.pool_allocations = term.scroll_buffer().line_pool().allocation_count();
+      result.pool_recycles = term.scroll_buffer().line_pool().recycle_count();
+    }
+    return result;
+  }
+
+  bool parse_sizes(const char* arg, std::vector<std::size_t>& result) {
+    result.clear();
+    while (*arg) {
+      char* end;
+      unsigned long const value = std::strtoul(arg, &end, 10);
+      if (end == arg || value == 0) return false;
+      result.push_back(value);
+      arg = *end == ',' ? end + 1 : end;
+      if (*end && *end != ',') return false;
+    }
+    return result.size();
+  }
+
+  bool parse_args(int argc, char** argv, bench_params& params) {
+    for (int i = 2; i < argc; i++) {
+      const char* const arg = argv[i];
+      auto _value = [&] () -> const char* {
+        if (i + 1 < argc) return argv[++i];
+        std::fprintf(stderr, "contra bench: missing value for \"%s\"\n", arg);
+        return nullptr;
+      };
+      if (std::strcmp(arg, "-w") == 0 || std::strcmp(arg, "-H") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        (arg[1] == 'w' ? params.width : params.height) = std::clamp(std::atoi(value), 1, 9999);
+      } else if (std::strcmp(arg, "-c") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        if (!parse_sizes(value, params.chunk_sizes)) {
+          std::fprintf(stderr, "contra bench: invalid chunk sizes \"%s\"\n", value);
+          return false;
+        }
+      } else if (std::strcmp(arg, "-s") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        params.scroll_buffer_size = std::strtoul(value, nullptr, 10);
+      } else if (std::strcmp(arg, "-m") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        params.corpus_size = std::max<std::size_t>(std::strtoul(value, nullptr, 10), 1) << 20;
+      } else if (std::strcmp(arg, "-r") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        params.repeat = std::max(std::atoi(value), 1);
+      } else if (std::strcmp(arg, "--save") == 0) {
+        if (!(params.save_directory = _value())) return false;
+      } else if (arg[0] == '-' && arg[1]) {
+        std::fprintf(stderr, "contra bench: unknown option \"%s\"\n", arg);
+        return false;
+      } else {
+        params.files.push_back(arg);
+      }
+    }
+    return true;
+  }
+
+}
+}
+
+namespace contra::bench {
+
+  bool run(int argc, char** argv) {
+    bench_params params;
+    if (!parse_args(argc, argv, params)) return false;
+
+    std::vector<corpus_t> corpora;
+    if (params.files.empty()) {
+      corpora.resize(std::size(generators));
+      for (std::size_t i = 0; i < std::size(generators); i++) {
+        corpus_t& corpus = corpora[i];
+        corpus.name = generators[i].name;
+        corpus_writer writer(corpus.buffer);
+        corpus.buffer.reserve(params.corpus_size + 4096);
+        generators[i].generate(writer, params.corpus_size);
+        corpus.data = reinterpret_cast<char const*>(corpus.buffer.data());
+        corpus.size = corpus.buffer.size();
+      }
+
+      if (params.save_directory) {
+        for (corpus_t const& corpus : corpora) {
+          std::string const path = std::string(params.save_directory) + "/" + corpus.name + ".txt";
+          std::FILE* const file = std::fopen(path.c_str(), "wb");
+          if (!file || std::fwrite(corpus.data, 1, corpus.size, file) != corpus.size) {
+            std::fprintf(stderr, "contra bench: failed to write \"%s\"\n", path.c_str());
+            if (file) std::fclose(file);
+            return false;
+          }
+          std::fclose(file);
+        }
+        return true;
+      }
+    } else {
+      corpora.resize(params.files.size());
+      for (std::size_t i = 0; i < params.files.size(); i++) {
+        corpus_t& corpus = corpora[i];
+        corpus.name = params.files[i];
+        if (std::size_t const slash = corpus.name.rfind('/'); slash != std::string::npos)
+          corpus.name = corpus.name.substr(slash + 1);
+        corpus.file = std::make_unique<contra::sys::mapped_file>();
+        if (!corpus.file->open(params.files[i])) {
+          std::fprintf(stderr, "contra bench: failed to open \"%s\"\n", params.files[i]);
+          return false;
+        }
+        corpus.data = corpus.file->data();
+        corpus.size = corpus.file->size();
+      }
+    }
+
+    std::printf("# term %dx%d, scroll buffer %zu, best of %d\n",
+      params.width, params.height, params.scroll_buffer_size, params.repeat);
+    std::printf("%-16s %6s %10s %9s %9s %11s %11s %10s %10s\n", "corpus", "chunk", "bytes", "time/ms", "MB/s",
+      "lines/s", "seqs/s", "pool/alloc", "pool/reuse");
+    for (corpus_t const& corpus : corpora) {
+      std::size_t const lines = std::count(corpus.data, corpus.data + corpus.size, (char) ascii_lf);
+      std::size_t const seqs = count_sequences(corpus.data, corpus.size);
+      for (std::size_t const chunk_size : params.chunk_sizes) {
+        measure_result const result = measure(params, corpus, chunk_size);
+        double const sec = result.time;
+        double const rate = sec > 0.0 ? 1.0 / sec : 0.0;
+        std::printf("%-16s %6zu %10zu %9.2f %9.1f %11.0f %11.0f %10zu %10zu\n",
+          corpus.name.c_str(), chunk_size, corpus.size, sec * 1000.0,
+          corpus.size * rate / 1e6, lines * rate, seqs * rate,
+          result.pool_allocations, result.pool_recycles);
+      }
+    }
+    return true;
+  }
+
+}
@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include "pty.hpp"
+#include "manager.hpp"
+#include "sys.signal.hpp"
+
+// contra bench-sessions: 多数の端末を同時に動かした時の構文解析の処理量の測定
+//
+//   contra bench-sessions [options]
+//
+//   -n SESSIONS   同時に動かす端末の数 (既定 8)
+//   -m MIB        各端末で yes が出力する量 (既定 32)
+//   -j THREADS    構文解析を共有するスレッドの数 (session_parse_threads)。
+//                 0 の時は端末毎に構文解析スレッドを作る (既定 0)
+//   --serial      構文解析を主スレッドで順番に行う (session_threaded_parse=false)
+//
+// 各端末で "yes | head -c SIZE" を実行して、全ての端末が終了するまでの時間を測る。
+// 最初の端末を前面にして、前面と背景の端末が終了するまでの時間も表示する。
+// 描画はしないが、描画の時刻毎に前面の端末の frame の複製 (update_frame) は行う。
+
+namespace contra::bench {
+namespace {
+
+  struct session_bench_params {
+    std::size_t session_count = 8;
+    std::size_t output_size = 32 << 20;
+    std::size_t parse_threads = 0;
+    bool threaded_parse = true;
+  };
+
+  bool parse_session_args(int argc, char** argv, session_bench_params& params) {
+    for (int i = 2; i < argc; i++) {
+      const char* const arg = argv[i];
+      auto _value = [&] () -> const char* {
+        if (i + 1 < argc) return argv[++i];
+        std::fprintf(stderr, "contra bench-sessions: missing value for \"%s\"\n", arg);
+        return nullptr;
+      };
+      if (std::strcmp(arg, "-n") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        params.session_count = std::max<std::size_t>(std::strtoul(value, nullptr, 10), 1);
+      } else if (std::strcmp(arg, "-m") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        params.output_size = std::max<std::size_t>(std::strtoul(value, nullptr, 10), 1) << 20;
+      } else if (std::strcmp(arg, "-j") == 0) {
+        const char* const value = _value();
+        if (!value) return false;
+        params.parse_threads = std::strtoul(value, nullptr, 10);
+      } else if (std::strcmp(arg, "--serial") == 0) {
+        params.threaded_parse = false;
+      } else {
+        std::fprintf(stderr, "contra bench-sessions: unknown option \"%s\"\n", arg);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  class null_events: public contra::term::terminal_events {};
+
+}
+}
+
+namespace contra::bench {
+
+  bool run_sessions(int argc, char** argv) {
+    using namespace contra::term;
+    session_bench_params params;
+    if (!parse_session_args(argc, argv, params)) return false;
+
+    null_events events;
+    terminal_manager manager;
+    manager.set_events(events);
+    manager.reset_size(80, 24, 7, 13);
+    manager.watch_fd(contra::sys::signal_notify_fd());
+
+    typedef std::chrono::steady_clock clock_type;
+    auto const start = clock_type::now();
+
+    struct session_t {
+      terminal_application* app;
+      double finish = -1.0; // [s]
+    };
+    std::vector<session_t> sessions;
+    std::u32string command = U"yes | head -c " + [] (std::size_t value) {
+      std::string const str = std::to_string(value);
+      return std::u32string(str.begin(), str.end());
+    }(params.output_size) + U"; exit\n";
+    for (std::size_t i = 0; i < params.session_count; i++) {
+      terminal_session_parameters sparams;
+      sparams.col = manager.width();
+      sparams.row = manager.height();
+      sparams.shell = "/bin/sh";
+      sparams.threaded_parse = params.threaded_parse;
+      sparams.parse_threads = params.parse_threads;
+      std::unique_ptr<terminal_application> sess = create_terminal_session(sparams);
+      if (!sess) {
+        std::fprintf(stderr, "contra bench-sessions: failed to create a session\n");
+        return false;
+      }
+      {
+        std::lock_guard<terminal_application> lock(*sess);
+        sess->input_paste(command);
+      }
+      sessions.push_back({sess.get()});
+      std::lock_guard<terminal_manager> lock(manager);
+      manager.add_app(std::move(sess));
+    }
+
+    for (;;) {
+      int timeout;
+      {
+        std::lock_guard<terminal_manager> lock(manager);
+        manager.do_events();
+        timeout = manager.frame_timeout();
+        if (timeout == 0) {
+          manager.app().update_frame();
+          manager.frame_rendered();
+        }
+        contra::sys::process_signals();
+
+        // Note: 終了した app は manager.is_alive() で削除されるので、その前に終了時刻を記録する。
+        double const elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+        for (session_t& session : sessions)
+          if (session.finish < 0.0 && !session.app->is_alive())
+            session.finish = elapsed;
+        if (!manager.is_alive()) break;
+      }
+      manager.wait_events(timeout < 0 ? 100 : timeout);
+    }
+    double const total = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    // Note: 終了時刻の記録と manager.is_alive() の間に終了した端末は finish < 0 のまま残る。
+    //   その様な端末は n/a として平均・最大から除く。
+    double background_sum = 0.0, background_max = 0.0;
+    std::size_t background_count = 0;
+    for (std::size_t i = 1; i < sessions.size(); i++) {
+      if (sessions[i].finish < 0.0) continue;
+      background_sum += sessions[i].finish;
+      background_max = std::max(background_max, sessions[i].finish);
+      background_count++;
+    }
+
+    double const mib = (double) params.output_size * sessions.size() / (1 << 20);
+    if (!params.threaded_parse)
+      std::printf("# %zu sessions x %zu MiB (yes), serial\n", sessions.size(), params.output_size >> 20);
+    else if (params.parse_threads)
+      std::printf("# %zu sessions x %zu MiB (yes), parser pool %zu threads\n",
+        sessions.size(), params.output_size >> 20, params.parse_threads);
+    else
+      std::printf("# %zu sessions x %zu MiB (yes), a parser thread per session\n",
+        sessions.size(), params.output_size >> 20);
+    std::printf("total      %8.1f MiB %8.3f s %8.1f MiB/s\n", mib, total, mib / total);
+    if (sessions[0].finish < 0.0)
+      std::printf("foreground %8s\n", "n/a");
+    else
+      std::printf("foreground %8.3f s\n", sessions[0].finish);
+    if (sessions.size() > 1) {
+      std::size_t const unknown = sessions.size() - 1 - background_count;
+      if (background_count == 0)
+        std::printf("background %8s\n", "n/a");
+      else if (unknown)
+        std::printf("background %8.3f s (mean) %8.3f s (max), %zu n/a\n",
+          background_sum / background_count, background_max, unknown);
+      else
+        std::printf("background %8.3f s (mean) %8.3f s (max)\n",
+          background_sum / background_count, background_max);
+    }
+    return true;
+  }
+
+}
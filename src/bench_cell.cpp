@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include "ansi/line.hpp"
+
+// cell_t の配置 (8 byte) と以前の配置 (12 byte) の比較。
+//
+//   ./bench_cell [width [height [scrollback]]]
+//
+// 盤面とスクロールバッファの大きさ、行の比較 (ttty/buffer.hpp の差分検出に相当)、
+// 文字幅の積算 (order_cells_in 等の走査に相当) の時間を表示する。
+
+using namespace contra;
+using namespace contra::ansi;
+
+namespace {
+
+  struct legacy_cell_t {
+    character_t   character;
+    attr_t       attribute = 0;
+    std::uint32_t width;
+
+    bool operator==(legacy_cell_t const& rhs) const {
+      return character == rhs.character && attribute == rhs.attribute && width == rhs.width;
+    }
+    bool operator!=(legacy_cell_t const& rhs) const { return !(*this == rhs); }
+  };
+
+  void set_cell(cell_t& cell, std::uint32_t c, std::uint32_t w, attr_t attr) {
+    cell.set_character(c);
+    cell.set_width(w);
+    cell.attribute = attr;
+  }
+  void set_cell(legacy_cell_t& cell, std::uint32_t c, std::uint32_t w, attr_t attr) {
+    cell.character = c;
+    cell.width = w;
+    cell.attribute = attr;
+  }
+  std::uint32_t get_width(cell_t const& cell) { return cell.width(); }
+  std::uint32_t get_width(legacy_cell_t const& cell) { return cell.width; }
+
+  template<typename Cell>
+  void fill_lines(std::vector<std::vector<Cell>>& lines, std::size_t width, std::size_t height) {
+    std::uint32_t seed = 12345;
+    lines.resize(height);
+    for (auto& line : lines) {
+      line.resize(width);
+      for (std::size_t x = 0; x < width; x++) {
+        seed = seed * 1103515245 + 12345;
+        std::uint32_t const c = ascii_A + (seed >> 16) % 26;
+        std::uint32_t const w = (seed >> 8) % 16 == 0 ? 2 : 1;
+        set_cell(line[x], c, w, (seed >> 4) % 8 == 0 ? attr_t(attr_bold_set) : attr_t(0));
+      }
+    }
+  }
+
+  template<typename Cell>
+  void run(const char* name, std::size_t width, std::size_t height, std::size_t scrollback) {
+    typedef std::chrono::steady_clock clock;
+    std::vector<std::vector<Cell>> board, snapshot, history;
+    fill_lines(board, width, height);
+    fill_lines(snapshot, width, height);
+    fill_lines(history, width, scrollback);
+    snapshot[height / 2][width / 2].attribute = attr_selected;
+
+    std::size_t const bytes = sizeof(Cell) * width * (2 * height + scrollback);
+
+    // 差分検出
+    auto const time0 = clock::now();
+    std::size_t diff = 0;
+    for (int rep = 0; rep < 8; rep++) {
+      for (std::size_t y = 0; y < height; y++) {
+        Cell const* a = board[y].data();
+        Cell const* b = snapshot[y].data();
+        for (std::size_t x = 0; x < width; x++)
+          if (a[x] != b[x]) diff++;
+      }
+    }
+
+    // 文字幅の積算
+    auto const time1 = clock::now();
+    std::uint64_t total = 0;
+    for (auto const& line : history)
+      for (Cell const& cell : line)
+        total += get_width(cell);
+    auto const time2 = clock::now();
+
+    auto const _msec = [] (clock::duration d) {
+      return std::chrono::duration<double, std::milli>(d).count();
+    };
+    std::printf("%-8s sizeof=%2zu memory=%8.1f MiB diff=%8.2f ms scan=%8.2f ms (%zu/%llu)\n",
+      name, sizeof(Cell), bytes / (1024.0 * 1024.0),
+      _msec(time1 - time0), _msec(time2 - time1), diff, (unsigned long long) total);
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t const width = argc > 1 ? std::atoi(argv[1]) : 2048;
+  std::size_t const height = argc > 2 ? std::atoi(argv[2]) : 2048;
+  std::size_t const scrollback = argc > 3 ? std::atoi(argv[3]) : 10000;
+  run<legacy_cell_t>("12-byte", width, height, scrollback);
+  run<cell_t>("8-byte", width, height, scrollback);
+  return 0;
+}
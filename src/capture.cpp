@@ -0,0 +1,110 @@
+#include "capture.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+namespace contra {
+namespace term {
+
+  static constexpr char capture_magic[] = "contra-capture 1 ";
+  static constexpr std::size_t capture_record_header_size = 16;
+
+  static void capture_put_u32(byte* p, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = byte(value >> 8 * i);
+  }
+  static void capture_put_u64(byte* p, std::uint64_t value) {
+    for (int i = 0; i < 8; i++) p[i] = byte(value >> 8 * i);
+  }
+  static std::uint32_t capture_get_u32(byte const* p) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= std::uint32_t(p[i]) << 8 * i;
+    return value;
+  }
+  static std::uint64_t capture_get_u64(byte const* p) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= std::uint64_t(p[i]) << 8 * i;
+    return value;
+  }
+
+  bool capture_writer::open(const char* path, std::uint32_t width, std::uint32_t height) {
+    close();
+    m_file = std::fopen(path, "wb");
+    if (!m_file) return false;
+    std::fprintf(m_file, "%s%u %u\n", capture_magic, (unsigned) width, (unsigned) height);
+    m_start = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  void capture_writer::close() {
+    if (!m_file) return;
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+
+  void capture_writer::write_record(capture_record_type type, char const* data, std::size_t size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) return;
+    std::uint64_t const time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - m_start).count();
+    byte header[capture_record_header_size] = {};
+    header[0] = (byte) type;
+    capture_put_u32(header + 4, (std::uint32_t) size);
+    capture_put_u64(header + 8, time);
+    std::fwrite(header, 1, sizeof header, m_file);
+    std::fwrite(data, 1, size, m_file);
+    // Note: 端末が異常終了しても直前までの記録が残る様に毎回書き出す。
+    std::fflush(m_file);
+  }
+
+  void capture_writer::write_resize(std::uint32_t width, std::uint32_t height) {
+    byte data[8];
+    capture_put_u32(data, width);
+    capture_put_u32(data + 4, height);
+    write_record(capture_resize, reinterpret_cast<char const*>(data), sizeof data);
+  }
+
+  bool capture_reader::open(const char* path) {
+    if (!m_file.open(path)) return false;
+
+    char const* const data = m_file.data();
+    std::size_t const size = m_file.size();
+    std::size_t const magic_size = sizeof capture_magic - 1;
+    char const* const eol = data ? reinterpret_cast<char const*>(std::memchr(data, '\n', std::min<std::size_t>(size, 64))) : nullptr;
+    if (!eol || std::memcmp(data, capture_magic, std::min<std::size_t>(size, magic_size)) != 0 || eol - data < (std::ptrdiff_t) magic_size) {
+      m_file.close();
+      return false;
+    }
+
+    char* p;
+    m_width = std::strtoul(data + magic_size, &p, 10);
+    m_height = std::strtoul(p, nullptr, 10);
+    if (m_width == 0 || m_height == 0) {
+      m_file.close();
+      return false;
+    }
+    m_header_size = m_offset = eol + 1 - data;
+    return true;
+  }
+
+  bool capture_reader::next(capture_record& record) {
+    std::size_t const size = m_file.size();
+    if (m_offset + capture_record_header_size > size) return false;
+    byte const* const header = reinterpret_cast<byte const*>(m_file.data() + m_offset);
+    record.type = (capture_record_type) header[0];
+    record.size = capture_get_u32(header + 4);
+    record.time = capture_get_u64(header + 8);
+    if (m_offset + capture_record_header_size + record.size > size) return false;
+    record.data = m_file.data() + m_offset + capture_record_header_size;
+    record.width = record.height = 0;
+    if (record.type == capture_resize) {
+      if (record.size < 8) return false;
+      byte const* const payload = reinterpret_cast<byte const*>(record.data);
+      record.width = capture_get_u32(payload);
+      record.height = capture_get_u32(payload + 4);
+    }
+    m_offset += capture_record_header_size + record.size;
+    return true;
+  }
+
+}
+}
@@ -0,0 +1,100 @@
+// -*- mode: c++; indent-tabs-mode: nil -*-
+#ifndef contra_capture_hpp
+#define contra_capture_hpp
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include "contradef.hpp"
+#include "sys.mmap.hpp"
+
+namespace contra {
+namespace term {
+
+  /*?lwiki
+   * 端末セッションの記録 (capture) の形式。
+   *
+   * - ヘッダ: `contra-capture 1 <列数> <行数>\n`
+   * - レコード: 16 byte の固定部 `{type: u8, 0: u8 x 3, size: u32, time: u64}` と size byte のデータ
+   *
+   * 整数はリトルエンディアンで、time は記録を開始してからの経過時間 [ns] である。
+   * capture_output のデータは pty から一度に読み取った内容で、読み取りの区切りを保持する。
+   * capture_resize のデータは新しい列数と行数 (u32 x 2) である。
+   */
+  enum capture_record_type {
+    capture_output = 0,
+    capture_resize = 1,
+  };
+
+  struct capture_record {
+    capture_record_type type;
+    std::uint64_t time;
+    char const* data;
+    std::size_t size;
+    std::uint32_t width, height; // capture_resize の時
+  };
+
+  /*?lwiki
+   * @class capture_writer
+   *   pty から受信したデータを時刻と共に記録する。
+   *   terminal_session の受信データの書込先 (multicast_device) に追加して使う。
+   *   pty を別スレッドで読み取る時は読取スレッドで記録する (pty_reader_thread)。
+   *   write_resize は別のスレッドから呼び出してもよい。
+   * @fn bool open(const char* path, std::uint32_t width, std::uint32_t height);
+   *   記録を開始する。width, height は端末の初期の大きさ。
+   * @fn void write_resize(std::uint32_t width, std::uint32_t height);
+   *   端末の大きさの変更を記録する。
+   */
+  class capture_writer: public idevice {
+    std::FILE* m_file = nullptr;
+    std::chrono::steady_clock::time_point m_start;
+    std::mutex m_mutex; // 読取スレッドと write_resize の間の排他
+
+  public:
+    capture_writer() {}
+    ~capture_writer() { close(); }
+    capture_writer(capture_writer const&) = delete;
+    capture_writer& operator=(capture_writer const&) = delete;
+
+    bool open(const char* path, std::uint32_t width, std::uint32_t height);
+    void close();
+    bool is_open() const { return m_file != nullptr; }
+    void write_resize(std::uint32_t width, std::uint32_t height);
+
+  private:
+    void write_record(capture_record_type type, char const* data, std::size_t size);
+    virtual void dev_write(char const* data, std::size_t size) override {
+      write_record(capture_output, data, size);
+    }
+  };
+
+  /*?lwiki
+   * @class capture_reader
+   *   capture_writer で記録したファイルを mmap で読み出す。
+   * @fn bool open(const char* path);
+   *   ファイルを開いてヘッダを読み取る。形式が異なる時は false を返す。
+   * @fn bool next(capture_record& record);
+   *   次のレコードを読み取る。末尾に達したか壊れたレコードの時は false を返す。
+   *   record.data はこのオブジェクトが開いている間有効である。
+   * @fn void rewind();
+   *   最初のレコードに戻る。
+   */
+  class capture_reader {
+    contra::sys::mapped_file m_file;
+    std::size_t m_header_size = 0;
+    std::size_t m_offset = 0;
+    std::uint32_t m_width = 80, m_height = 24;
+
+  public:
+    bool open(const char* path);
+    std::uint32_t width() const { return m_width; }
+    std::uint32_t height() const { return m_height; }
+    bool next(capture_record& record);
+    void rewind() { m_offset = m_header_size; }
+  };
+
+}
+}
+
+#endif
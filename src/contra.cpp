@@ -16,6 +16,10 @@ namespace contra::twin {
 namespace contra::ttty {
   bool run(contra::app::context& actx);
 }
+namespace contra::bench {
+  bool run(int argc, char** argv);
+  bool run_sessions(int argc, char** argv);
+}
 
 int main(int argc, char** argv) {
   contra::initialize_errdev();
@@ -76,6 +80,10 @@ int main(int argc, char** argv) {
       std::fputc('\n', stdout);
     }
 
+  } else if (std::strcmp(argv[1], "bench") == 0) {
+    if (!contra::bench::run(argc, argv)) return 1;
+  } else if (std::strcmp(argv[1], "bench-sessions") == 0) {
+    if (!contra::bench::run_sessions(argc, argv)) return 1;
   } else if (std::strcmp(argv[1], "--help") == 0) {
     std::cout
 #ifdef use_twin
@@ -83,6 +91,8 @@ int main(int argc, char** argv) {
 #else
       << "usage: contra [x11|tty]\n"
 #endif
+      << "usage: contra bench [-w WIDTH] [-H HEIGHT] [-c CHUNK,...] [-s LINES] [-m MIB] [-r COUNT] [--save DIR] [FILE...]\n"
+      << "usage: contra bench-sessions [-n SESSIONS] [-m MIB] [-j THREADS] [--serial]\n"
       << "usage: contra --help\n"
       << std::endl;
     return 0;
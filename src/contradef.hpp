@@ -182,6 +182,8 @@ namespace contra {
     charflag_iso2022_mosaic_beg = 0x01100000,
     charflag_iso2022_mosaic_end = 0x01100000 + 96 * 96,
 
+    // Note: bit 22-23 は ansi::cell_t が文字幅を格納するのに使う。
+
     charflag_wide_extension    = 0x10000000,
     charflag_cluster_extension = 0x20000000,
     charflag_marker            = 0x40000000,
@@ -285,16 +285,16 @@ void tty_writer::print_screen(board_t const& b) {
     curpos_t const ncell = (curpos_t) line.cells().size();
     for (curpos_t x = 0; x < ncell; x++) {
       cell_t const& cell = line.cells()[x];
-      if (cell.character.is_wide_extension()) continue;
-      if (cell.character.is_marker()) continue;
-      if (cell.character.value == ascii_nul) {
-        wskip += cell.width;
+      if (cell.character().is_wide_extension()) continue;
+      if (cell.character().is_marker()) continue;
+      if (cell.character().value == ascii_nul) {
+        wskip += cell.width();
         continue;
       }
 
       if (wskip > 0) put_skip(wskip);
       apply_attr(cell.attribute);
-      put_u32(cell.character.value);
+      put_u32(cell.character().value);
     }
 
     put('\n');
@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <algorithm>
 #include <cstdio>
 #include <vector>
 #include <string>
@@ -7,6 +8,11 @@
 #include "enc.utf8.hpp"
 #include "contradef.hpp"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define contra_enc_utf8_simd_x86
+#endif
+
 namespace contra {
 namespace encoding {
 
@@ -63,6 +69,104 @@ namespace encoding {
     return true;
   }
 
+  //---------------------------------------------------------------------------
+  // ASCII 高速経路
+
+  // @fn utf8_widen_ascii_*(ibeg, iend, obeg, oend)
+  //   入力先頭の連続する ASCII 文字を char32_t に変換して出力する。
+  //   非 ASCII のバイトに達するか入出力の何れかが尽きた時点で停止する。
+  //   非 ASCII バイトは消費しない (状態機械の側で処理する)。
+  typedef void utf8_widen_ascii_t(byte const*& ibeg, byte const* iend, char32_t*& obeg, char32_t* oend);
+
+  static void utf8_widen_ascii_scalar(byte const*& ibeg, byte const* iend, char32_t*& obeg, char32_t* oend) {
+    byte const* p = ibeg;
+    char32_t* q = obeg;
+    std::size_t const n = std::min<std::size_t>(iend - p, oend - q);
+    byte const* const pend = p + n;
+    while (p != pend && *p < 0x80) *q++ = *p++;
+    ibeg = p;
+    obeg = q;
+  }
+
+#if defined(contra_enc_utf8_simd_x86) && defined(__SSE2__)
+  static void utf8_widen_ascii_sse2(byte const*& ibeg, byte const* iend, char32_t*& obeg, char32_t* oend) {
+    byte const* p = ibeg;
+    char32_t* q = obeg;
+    __m128i const zero = _mm_setzero_si128();
+    while (iend - p >= 16 && oend - q >= 16) {
+      __m128i const v = _mm_loadu_si128((__m128i const*) p);
+      int const mask = _mm_movemask_epi8(v);
+      if (mask) {
+        // Note: 非 ASCII の手前までは ASCII なので其処まで変換する。
+        int const n = __builtin_ctz(mask);
+        for (int i = 0; i < n; i++) *q++ = *p++;
+        ibeg = p;
+        obeg = q;
+        return;
+      }
+      __m128i const lo = _mm_unpacklo_epi8(v, zero);
+      __m128i const hi = _mm_unpackhi_epi8(v, zero);
+      _mm_storeu_si128((__m128i*) q + 0, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128((__m128i*) q + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128((__m128i*) q + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128((__m128i*) q + 3, _mm_unpackhi_epi16(hi, zero));
+      p += 16;
+      q += 16;
+    }
+    ibeg = p;
+    obeg = q;
+    utf8_widen_ascii_scalar(ibeg, iend, obeg, oend);
+  }
+#endif
+
+#if defined(contra_enc_utf8_simd_x86)
+  __attribute__((target("avx2")))
+  static void utf8_widen_ascii_avx2(byte const*& ibeg, byte const* iend, char32_t*& obeg, char32_t* oend) {
+    byte const* p = ibeg;
+    char32_t* q = obeg;
+    while (iend - p >= 32 && oend - q >= 32) {
+      __m256i const v = _mm256_loadu_si256((__m256i const*) p);
+      std::uint32_t const mask = (std::uint32_t) _mm256_movemask_epi8(v);
+      if (mask) {
+        int const n = __builtin_ctz(mask);
+        for (int i = 0; i < n; i++) *q++ = *p++;
+        ibeg = p;
+        obeg = q;
+        return;
+      }
+      __m128i const lo = _mm256_castsi256_si128(v);
+      __m128i const hi = _mm256_extracti128_si256(v, 1);
+      _mm256_storeu_si256((__m256i*) q + 0, _mm256_cvtepu8_epi32(lo));
+      _mm256_storeu_si256((__m256i*) q + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+      _mm256_storeu_si256((__m256i*) q + 2, _mm256_cvtepu8_epi32(hi));
+      _mm256_storeu_si256((__m256i*) q + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+      p += 32;
+      q += 32;
+    }
+    ibeg = p;
+    obeg = q;
+    utf8_widen_ascii_scalar(ibeg, iend, obeg, oend);
+  }
+#endif
+
+  static utf8_widen_ascii_t* utf8_widen_ascii_select() {
+#if defined(contra_enc_utf8_simd_x86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &utf8_widen_ascii_avx2;
+# if defined(__SSE2__)
+    return &utf8_widen_ascii_sse2;
+# endif
+#endif
+    return &utf8_widen_ascii_scalar;
+  }
+
+  static void utf8_widen_ascii(byte const*& ibeg, byte const* iend, char32_t*& obeg, char32_t* oend) {
+    static utf8_widen_ascii_t* const impl = utf8_widen_ascii_select();
+    impl(ibeg, iend, obeg, oend);
+  }
+
+  //---------------------------------------------------------------------------
+
   void utf8_decode(char const*& ibeg, char const* iend, char32_t*& obeg, char32_t* oend, std::uint64_t& state, std::int32_t error_char) {
     // flush
     if (ibeg == iend) {
@@ -86,6 +190,15 @@ namespace encoding {
     // 最低でも norm bit では表現しきれない事を要求する。
 
     while (ibeg != iend && obeg != oend) {
+      // Note: 組み立て中の文字がない時は ASCII の連続をまとめて変換する。
+      //   マルチバイト文字の途中 (mode != 0) は必ず状態機械で処理する。
+      if (!mode && (byte) *ibeg < 0x80) {
+        byte const* p = (byte const*) ibeg;
+        utf8_widen_ascii(p, (byte const*) iend, obeg, oend);
+        ibeg = (char const*) p;
+        continue;
+      }
+
       byte const c = *ibeg++;
 
       if (mode) {
@@ -8,10 +8,12 @@
 #include <iterator>
 #include <memory>
 #include <chrono>
+#include <algorithm>
 #include "ansi/line.hpp"
 #include "ansi/term.hpp"
 #include "enc.utf8.hpp"
 #include "context.hpp"
+#include "sys.poll.hpp"
 
 namespace contra {
 namespace term {
@@ -57,8 +59,31 @@ namespace term {
       return true;
     }
 
+  public:
+    /*?lwiki
+     * 構文解析を別スレッドで行う端末 (terminal_session の threaded_parse) の為の排他。
+     * 既定の実装は何もしない。
+     * @fn void lock(); void unlock();
+     *   term() や view() に触れる間は lock() しておく。
+     * @fn void update_frame();
+     *   (lock() した状態で) view() の内容を描画用の frame_view() に写す。
+     * @fn void lock_frame(); void unlock_frame();
+     *   frame_view() を描画する間は lock_frame() しておく。lock() は不要。
+     */
+    virtual void lock() {}
+    virtual void unlock() {}
+    virtual void update_frame() {}
+    virtual void lock_frame() {}
+    virtual void unlock_frame() {}
+    virtual contra::ansi::term_view_t& frame_view() { return m_view; }
+
+    // 前面 (表示中) の端末かどうか。構文解析の優先度に使う。
+    virtual void set_foreground([[maybe_unused]] bool value) {}
+
   public:
     virtual bool process() { return false; }
+    // process() で読み取るデータの到着を待つ為の fd。無ければ -1。
+    virtual int fd() const { return -1; }
     virtual bool is_active() const { return true; }
     virtual bool is_alive() { return true; }
     virtual void terminate() {}
@@ -290,9 +315,16 @@ namespace term {
     void select_app(int index, bool force_update = false) {
       std::size_t const new_iapp = !m_apps.size() ? 0 : contra::clamp(index, 0, m_apps.size() - 1);
       if (!force_update && new_iapp == m_active_iapp) return;
-      if (m_active_iapp < m_apps.size()) m_events->on_leave_app();
+      if (m_active_iapp < m_apps.size()) {
+        m_events->on_leave_app();
+        m_apps[m_active_iapp]->set_foreground(false);
+      }
       m_active_iapp = new_iapp;
-      if (m_active_iapp < m_apps.size()) m_events->on_enter_app();
+      if (m_active_iapp < m_apps.size()) {
+        if (m_locked) lock_app(m_apps[m_active_iapp]);
+        m_apps[m_active_iapp]->set_foreground(true);
+        m_events->on_enter_app();
+      }
       if (m_apps.size()) {
         app().reset_size(m_width, m_height, m_xunit, m_yunit);
         m_dirty = true;
@@ -305,58 +337,140 @@ namespace term {
     template<typename T>
     void add_app(T&& app) {
       m_apps.emplace_back(std::forward<T>(app));
+      m_poller.add(m_apps.back()->fd());
+      if (m_locked) lock_app(m_apps.back());
       if (m_apps.size() == 1) select_app(0, true);
     }
     void set_events(terminal_events& events) { this->m_events = &events; }
 
   private:
-    // ToDo: foreground/background で優先順位をつけたい。
-    // 後、現在 process1 を呼び出す度に全ての app に対して処理を行っているが、
-    // 一度 processed = false になった物は何度も試さない様にする。
+    bool m_locked = false;
+    std::vector<std::shared_ptr<terminal_application> > m_locked_apps;
+    void lock_app(std::shared_ptr<terminal_application> const& app) {
+      if (std::find(m_locked_apps.begin(), m_locked_apps.end(), app) != m_locked_apps.end()) return;
+      app->lock();
+      m_locked_apps.push_back(app);
+    }
+  public:
+    // 前面の app を lock() する。std::lock_guard で使う。
+    // Note: 背景の app の term には触れないので lock しない (背景の構文解析を待たない為)。
+    //   lock 中に前面にした app や追加した app も lock し、lock 中に削除した app は unlock まで保持する。
+    void lock() {
+      m_locked = true;
+      if (m_active_iapp < m_apps.size()) lock_app(m_apps[m_active_iapp]);
+    }
+    void unlock() {
+      for (auto const& app : m_locked_apps) app->unlock();
+      m_locked_apps.clear();
+      m_locked = false;
+    }
+
+  private:
+    contra::sys::fd_poller m_poller;
+  public:
+    // Note: 端末以外の入力 (キーボードや X サーバとの接続、タイマー) の fd も
+    //   ここに登録して wait_events で一緒に待つ。
+    void watch_fd(int fd) { m_poller.add(fd); }
+    void unwatch_fd(int fd) { m_poller.remove(fd); }
+
+    /*?lwiki
+     * @fn bool wait_events(int timeout_msec);
+     *   端末または watch_fd で登録した fd が読み取り可能になるまで待つ。
+     *   timeout_msec < 0 の時は無期限に待つ。シグナルを受信した時も戻る。
+     */
+    bool wait_events(int timeout_msec) {
+      return m_poller.wait(timeout_msec);
+    }
+
+  private:
+    // Note: 前面の端末を先に処理する。構文解析を別スレッドで行う端末 (threaded_parse) は
+    //   ここでは通知を受け取るだけで、優先順位は parser_pool 等の側で付ける。
     bool process1() {
       bool processed = false;
-      for (auto const& app : m_apps)
-        if (app->process())
+      if (m_active_iapp < m_apps.size() && m_apps[m_active_iapp]->process())
+        processed = true;
+      for (std::size_t i = 0; i < m_apps.size(); i++)
+        if (i != m_active_iapp && m_apps[i]->process())
           processed = true;
       return processed;
     }
-    bool process2() {
-      for (int i = 0; i < 100; i++) {
-        bool const result = process1();
-        if (result) return result;
-        usleep(10);
-      }
-      return process1();
-    }
-    bool do_events_implA() {
+  public:
+    // Note: 受信データがある限り最大 20ms まで読み取りを続ける。
+    //   受信データがなくなったら直ぐに戻るので、呼び出し元は描画してから wait_events で待つ。
+    //   次の描画の時刻 (前回の描画から m_frame_interval 後) になった時も描画の為に戻る。
+    bool do_events() {
       bool processed = false;
-      auto const time0 = std::chrono::high_resolution_clock::now();
-      while (this->process2()) {
+      auto const time0 = frame_clock::now();
+      auto const deadline = std::min(time0 + std::chrono::milliseconds(20), m_frame_time + m_frame_interval);
+      while (this->process1()) {
         processed = true;
-        auto const time1 = std::chrono::high_resolution_clock::now();
-        auto const msec = std::chrono::duration_cast<std::chrono::milliseconds>(time1 - time0);
-        if (msec.count() > 20) break;
+        if (frame_clock::now() >= deadline) break;
       }
-      if (processed) m_dirty = true;
-      return processed;
-    }
-    bool do_events_implB() {
-      bool processed = false;
-      auto const time0 = std::chrono::high_resolution_clock::now();
-      for (;;) {
-        bool const result = this->process1();
-        if (result) processed = true;
-        auto const time1 = std::chrono::high_resolution_clock::now();
-        auto const msec = std::chrono::duration_cast<std::chrono::milliseconds>(time1 - time0);
-        if (msec.count() > 20) break;
-        if (!result) usleep(10);
-      }
-      if (processed) m_dirty = true;
+      if (processed) m_output_dirty = true;
       return processed;
     }
+
+  private:
+    typedef std::chrono::steady_clock frame_clock;
+    frame_clock::time_point m_frame_time;
+    frame_clock::time_point m_sync_time;
+    std::chrono::milliseconds m_frame_interval {16};
+    std::chrono::milliseconds m_sync_timeout {200};
+    bool m_output_dirty = false;
+    bool m_input_pending = false;
+    bool m_sync_active = false;
   public:
-    bool do_events() {
-      return do_events_implB();
+    void set_frame_interval(int frame_interval_msec, int sync_timeout_msec) {
+      m_frame_interval = std::chrono::milliseconds(std::max(frame_interval_msec, 0));
+      m_sync_timeout = std::chrono::milliseconds(std::max(sync_timeout_msec, 0));
+    }
+    // 設定 term_frame_interval, term_sync_timeout [ms] を読み取る。
+    void configure_frame(contra::app::context& actx) {
+      int frame_interval = (int) m_frame_interval.count();
+      int sync_timeout = (int) m_sync_timeout.count();
+      actx.read("term_frame_interval", frame_interval);
+      actx.read("term_sync_timeout", sync_timeout);
+      set_frame_interval(frame_interval, sync_timeout);
+    }
+
+    /*?lwiki
+     * @fn int frame_timeout();
+     *   次に描画するまでの待ち時間 [ms] を返す。0 の時は直ぐに描画する。描画が不要な時は -1 を返す。
+     *   lock() した状態で呼び出し、0 の時は描画して frame_rendered() を呼び出す。
+     *   - m_dirty (キー入力による表示位置の変更やウィンドウの操作など) は直ぐに描画する。
+     *   - 端末の出力による更新は、前回の描画から m_frame_interval 経つまで纏める。
+     *     但し、キー入力の後の最初の出力は直ぐに描画する (エコーバックを遅らせない為)。
+     *   - 同期更新モード (DECSET 2026) の間は、解除されるか m_sync_timeout 経つまで描画しない。
+     * @fn void frame_rendered();
+     *   描画した事を記録する。
+     */
+    int frame_timeout() {
+      if (!m_dirty && !m_output_dirty) return -1;
+      auto const now = frame_clock::now();
+      auto _remaining = [now] (frame_clock::time_point time) {
+        if (time <= now) return 0;
+        return (int) std::chrono::ceil<std::chrono::milliseconds>(time - now).count();
+      };
+
+      bool const sync = m_apps.size() && app().state().get_mode(ansi::mode_SynchronizedOutput);
+      if (sync) {
+        if (!m_sync_active) {
+          m_sync_active = true;
+          m_sync_time = now;
+        }
+        if (int const timeout = _remaining(m_sync_time + m_sync_timeout)) return timeout;
+      } else {
+        m_sync_active = false;
+      }
+
+      if (m_dirty || m_input_pending) return 0;
+      return _remaining(m_frame_time + m_frame_interval);
+    }
+    void frame_rendered() {
+      m_frame_time = frame_clock::now();
+      m_dirty = false;
+      m_output_dirty = false;
+      m_input_pending = false;
     }
 
     bool is_active() {
@@ -372,6 +486,7 @@ namespace term {
           m_apps.begin(), m_apps.end(),
           [&] (auto const& app) {
             if (!app->is_alive()) {
+              m_poller.remove(app->fd());
               if (iapp == m_active_iapp) {
                 m_events->on_leave_app();
                 is_active_app_dead = true;
@@ -441,6 +556,9 @@ namespace term {
       case ascii_c:
         do_create_app();
         return true;
+      case ascii_slash:
+        m_dirty |= do_search(true);
+        return true;
       }
       return false;
     }
@@ -496,6 +614,13 @@ namespace term {
           do_create_app();
           return true;
 
+        case ascii_f:
+          m_dirty |= do_search(true);
+          return true;
+        case ascii_g:
+          m_dirty |= do_search(false);
+          return true;
+
         case ascii_v:
         case ascii_v | modifier_control:
           clipboard_paste();
@@ -507,8 +632,10 @@ namespace term {
         default:
           return false;
         }
-      } else
+      } else {
+        m_input_pending = true;
         return app().input_key(key);
+      }
     }
 
   private:
@@ -549,7 +676,7 @@ namespace term {
 
       curpos_t const ybeg = view.logical_ybeg();
       if (ybeg <= m_sel_beg_y && m_sel_beg_y < term.height() &&
-        view.lline(m_sel_beg_y).id() == m_sel_beg_lineid)
+        view.lline_id(m_sel_beg_y) == m_sel_beg_lineid)
         return true;
 
       for (curpos_t i = 0; i < term.height(); i++) {
@@ -559,7 +686,7 @@ namespace term {
         }
       }
       for (curpos_t i = scroll_buffer.size(); --i >= 0; ) {
-        if (scroll_buffer[i].id() == m_sel_beg_lineid) {
+        if (scroll_buffer.line_id(i) == m_sel_beg_lineid) {
           m_sel_beg_y = i - scroll_buffer.size();
           return true;
         }
@@ -609,11 +736,11 @@ namespace term {
 
         curpos_t i = ybeg;
         while (i < y1)
-          m_dirty |= view.lline(i++).clear_selection();
+          m_dirty |= view.clear_selection(i++);
         while (i <= y2)
           m_dirty |= view.lline(i++).set_selection(x1, x2 + 1, truncate, gatm, true);
         while (i < yend)
-          m_dirty |= view.lline(i++).clear_selection();
+          m_dirty |= view.clear_selection(i++);
       } else {
         if (y1 > y2) {
           std::swap(y1, y2);
@@ -631,7 +758,7 @@ namespace term {
         // 選択状態の更新 (前回と同じ場合は skip できたりしないか?)
         curpos_t i = ybeg;
         while (i < y1)
-          m_dirty |= view.lline(i++).clear_selection();
+          m_dirty |= view.clear_selection(i++);
         if (y1 == y2) {
           m_dirty |= view.lline(i++).set_selection(x1, x2 + 1, truncate, gatm, true);
         } else if (y1 < y2) {
@@ -641,7 +768,7 @@ namespace term {
           m_dirty |= view.lline(i++).set_selection(0, x2 + 1, truncate, gatm, true);
         }
         while (i < yend)
-          m_dirty |= view.lline(i++).clear_selection();
+          m_dirty |= view.clear_selection(i++);
       }
 
       return true;
@@ -663,7 +790,7 @@ namespace term {
         bool started = false;
         std::u32string line_data;
         for (curpos_t iline = ybeg; iline < yend; iline++) {
-          curpos_t const x = view.lline(iline).extract_selection(line_data);
+          curpos_t const x = view.extract_selection(iline, line_data);
           if (line_data.size() || (y1 <= iline && iline <= y2)) {
             if (started && skipped_line_count)
               lines.resize(lines.size() + skipped_line_count, std::make_pair(0, std::u32string()));
@@ -720,7 +847,7 @@ namespace term {
         curpos_t skipped_line_count = 0;
         std::u32string line_data;
         for (curpos_t iline = ybeg; iline < yend; iline++) {
-          curpos_t x = view.lline(iline).extract_selection(line_data);
+          curpos_t x = view.extract_selection(iline, line_data);
           if (line_data.size() || (y1 <= iline && iline <= y2)) {
             if (started) result.append(skipped_line_count + 1, U'\n');
             //if (iline == y1 && x >= x1) x = 0;
@@ -743,6 +870,67 @@ namespace term {
         selection_extract_characters(data);
     }
 
+  private:
+    contra::ansi::search_pattern m_search_pattern;
+    std::vector<contra::ansi::term_search_result_t> m_search_result;
+    std::u32string m_search_match; // 前回強調表示した一致の文字列
+    std::uint32_t m_search_line_id = (std::uint32_t) -1;
+    curpos_t m_search_x = 0;
+
+    // 選択範囲の文字列 (選択範囲がなければ前回の検索語) を探して強調表示する。
+    // Note: 検索語を入力する UI はまだないので選択範囲を検索語として使う。
+    //   前回の一致を強調表示した状態で再度呼び出すと次の一致に移動する。
+    bool do_search(bool backward) {
+      using namespace contra::ansi;
+      std::u32string query;
+      selection_extract(query);
+      query = query.substr(0, query.find(U'\n'));
+      if (query.size() && query != m_search_match) {
+        m_search_pattern.compile(query, 0);
+        m_search_line_id = (std::uint32_t) -1;
+      }
+      if (m_search_pattern.empty()) return false;
+
+      term_view_t& view = app().view();
+      app().term().search(m_search_pattern, m_search_result);
+      auto const& result = m_search_result;
+      if (result.empty()) return false;
+
+      // 次の一致を決める。前回の一致が見つからない時は画面上の位置を起点にする。
+      std::size_t index;
+      auto const current = std::find_if(result.begin(), result.end(), [this] (term_search_result_t const& e) {
+        return e.line_id == m_search_line_id && e.x1 == m_search_x;
+      });
+      if (current != result.end()) {
+        std::size_t const i = current - result.begin();
+        if (backward)
+          index = i ? i - 1 : result.size() - 1;
+        else
+          index = i + 1 < result.size() ? i + 1 : 0;
+      } else if (backward) {
+        curpos_t const yend = view.height() - view.scroll_amount();
+        auto const it = std::find_if(result.rbegin(), result.rend(),
+          [yend] (term_search_result_t const& e) { return e.y < yend; });
+        index = it != result.rend() ? result.rend() - it - 1 : result.size() - 1;
+      } else {
+        curpos_t const ybeg = -view.scroll_amount();
+        auto const it = std::find_if(result.begin(), result.end(),
+          [ybeg] (term_search_result_t const& e) { return e.y >= ybeg; });
+        index = it != result.end() ? it - result.begin() : 0;
+      }
+
+      term_search_result_t const match = result[index];
+      selection_clear();
+      bool const gatm = app().state().get_mode(mode_gatm);
+      line_t& line = view.lline(match.y);
+      line.set_selection(match.x1, match.x2, false, gatm, true);
+      line.extract_selection(m_search_match);
+      m_search_line_id = match.line_id;
+      m_search_x = match.x1;
+      view.scroll_to(match.y);
+      return true;
+    }
+
   private:
     std::u32string m_clipboard_data;
     void clipboard_paste() {
@@ -755,6 +943,7 @@ namespace term {
     }
   public:
     void input_paste(std::u32string const& data) {
+      m_input_pending = true;
       app().input_paste(data);
     }
 
@@ -845,11 +1034,11 @@ namespace term {
           m_word_selection_level++;
 
         for (curpos_t y1 = ybeg; y1 < yend; y1++) {
-          line_t& line = view.lline(y1);
           bool dirty = false;
           if (y1 != ylog) {
-            dirty = line.clear_selection();
+            dirty = view.clear_selection(y1);
           } else {
+            line_t& line = view.lline(y1);
             switch (m_word_selection_level % 3) {
             case 0:
               {
@@ -951,16 +1140,20 @@ namespace term {
     void reset_size(curpos_t width, curpos_t height) {
       this->m_width = width;
       this->m_height = height;
-      if (m_apps.size())
+      if (m_apps.size()) {
         app().reset_size(width, height);
+        m_dirty = true;
+      }
     }
     void reset_size(curpos_t width, curpos_t height, coord_t xunit, coord_t yunit) {
       this->m_width = width;
       this->m_height = height;
       this->m_xunit = xunit;
       this->m_yunit = yunit;
-      if (m_apps.size())
+      if (m_apps.size()) {
         app().reset_size(width, height, xunit, yunit);
+        m_dirty = true;
+      }
     }
 
   };
@@ -15,14 +15,26 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 #include <string>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <tuple>
+#include <cerrno>
+#include <poll.h>
 
 #include "pty.hpp"
 #include "contradef.hpp"
 #include "manager.hpp"
+#include "capture.hpp"
+#include "util.hpp"
 
 namespace contra {
 namespace term {
@@ -222,6 +234,447 @@ namespace term {
     }
   };
 
+  static bool fd_create_pipe(int (&fds)[2]) {
+    if (::pipe(fds) < 0) {
+      fds[0] = fds[1] = -1;
+      return false;
+    }
+    for (int const fd : fds) {
+      fd_set_nonblock(fd, true);
+      ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return true;
+  }
+  static void fd_drain(int fd) {
+    char buff[64];
+    while (::read(fd, buff, sizeof buff) > 0);
+  }
+  static void fd_notify(int fd) {
+    char const c = 0;
+    [[maybe_unused]] ssize_t const result = ::write(fd, &c, 1);
+  }
+
+  /*?lwiki
+   * @class pty_reader_thread
+   *   pty の master から別スレッドで読み取り、spsc_byte_ring に溜める。
+   *   描画中も子プロセスの出力を受け取り続けるので、pty のカーネルバッファが一杯になって
+   *   子プロセスが待たされることがない。構文解析は consume を呼び出すスレッドで行う。
+   *
+   *   読取スレッドから呼び出し側へはデータの到着を notify_fd() のパイプで知らせる。
+   *   リングバッファが一杯の時、読取スレッドは consume で空きができるまで待つ。
+   *
+   * @fn bool start(int fd);
+   *   読取スレッドを開始する。
+   * @fn int notify_fd() const;
+   *   データが到着すると読み取り可能になる fd。fd_poller に登録して使う。
+   * @fn std::size_t consume(contra::idevice* dst, std::size_t limit);
+   *   溜まっているデータを最大 limit byte まで dst に書き込む。
+   * @fn void set_notify_handler(std::function<void()> handler);
+   *   データの到着を notify_fd() の代わりに handler の呼び出しで知らせる。start の前に呼び出す。
+   *   handler は読取スレッドで呼び出される。
+   * @fn void set_capture_device(contra::idevice* dev);
+   *   読み取ったデータを読取スレッドで直ぐに dev にも書き込む。start の前に呼び出す。
+   *   受信の時刻と read の区切りを記録する為に使う (capture_writer)。
+   */
+  class pty_reader_thread {
+    contra::util::spsc_byte_ring m_ring;
+    int m_fd = -1;
+    int m_notify[2] = {-1, -1}; // 読取スレッド → consume (データ到着)
+    int m_wake[2] = {-1, -1};   // consume, stop → 読取スレッド (空き・停止)
+    std::atomic<bool> m_notified {false};
+    std::atomic<bool> m_waiting_space {false};
+    std::atomic<bool> m_stop {false};
+    std::thread m_thread;
+    std::function<void()> m_notify_handler;
+    contra::idevice* m_capture = nullptr;
+
+  public:
+    explicit pty_reader_thread(std::size_t capacity): m_ring(capacity) {}
+    ~pty_reader_thread() {
+      stop();
+      for (int const fd : {m_notify[0], m_notify[1], m_wake[0], m_wake[1]})
+        if (fd >= 0) ::close(fd);
+    }
+    pty_reader_thread(pty_reader_thread const&) = delete;
+    pty_reader_thread& operator=(pty_reader_thread const&) = delete;
+
+    int notify_fd() const { return m_notify[0]; }
+    void set_notify_handler(std::function<void()> handler) {
+      mwg_assert(!m_thread.joinable());
+      m_notify_handler = std::move(handler);
+    }
+    void set_capture_device(contra::idevice* dev) {
+      mwg_assert(!m_thread.joinable());
+      m_capture = dev;
+    }
+
+    bool start(int fd) {
+      if (m_thread.joinable()) return true;
+      if (!fd_create_pipe(m_notify) || !fd_create_pipe(m_wake)) return false;
+      m_fd = fd;
+      m_thread = std::thread([this] { this->run(); });
+      return true;
+    }
+    void stop() {
+      if (!m_thread.joinable()) return;
+      m_stop = true;
+      fd_notify(m_wake[1]);
+      m_thread.join();
+    }
+
+    std::size_t consume(contra::idevice* dst, std::size_t limit) {
+      // Note: 通知を解除してからリングを確認する。読取スレッドはリングに公開した後に
+      //   m_notified を確認するので、この後に公開されたデータについては再び通知される。
+      fd_drain(m_notify[0]);
+      m_notified.store(false);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      std::size_t total = 0;
+      while (total < limit) {
+        auto const [data, size] = m_ring.read_span();
+        if (!size) break;
+        std::size_t const count = std::min(size, limit - total);
+        dst->dev_write(data, count);
+        m_ring.commit_read(count);
+        total += count;
+      }
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (total && m_waiting_space.exchange(false))
+        fd_notify(m_wake[1]);
+      return total;
+    }
+
+  private:
+    void run() {
+      while (!m_stop.load(std::memory_order_relaxed)) {
+        auto [buff, size] = m_ring.write_span();
+        if (!size) {
+          // 空きができるまで待つ。
+          m_waiting_space.store(true);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          std::tie(buff, size) = m_ring.write_span();
+          if (!size) {
+            wait_fds(-1);
+            continue;
+          }
+          m_waiting_space.store(false);
+        }
+
+        ssize_t const nread = ::read(m_fd, buff, size);
+        if (nread > 0) {
+          if (m_capture) m_capture->dev_write(buff, nread);
+          m_ring.commit_write(nread);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if (!m_notified.exchange(true))
+            notify();
+        } else if (nread < 0 && (errno == EAGAIN || errno == EINTR)) {
+          wait_fds(m_fd);
+        } else {
+          // EOF (子プロセスが pty を閉じた)
+          notify();
+          break;
+        }
+      }
+    }
+    void notify() {
+      if (m_notify_handler)
+        m_notify_handler();
+      else
+        fd_notify(m_notify[1]);
+    }
+    void wait_fds(int fd) {
+      struct pollfd fds[2];
+      fds[0].fd = m_wake[0];
+      fds[0].events = POLLIN;
+      fds[1].fd = fd;
+      fds[1].events = POLLIN;
+      ::poll(fds, fd >= 0 ? 2 : 1, -1);
+      fd_drain(m_wake[0]);
+    }
+  };
+
+  /*?lwiki
+   * @class parser_pool
+   *   複数の端末の構文解析を共有の作業スレッドで行う (session_parse_threads)。
+   *   データが到着した端末 (task) を実行待ちの列に入れ、空いている作業スレッドが取り出して
+   *   task::parse() を一回呼び出す。処理しきれなかった task は列の末尾に戻すので、
+   *   出力し続ける端末が他の端末を待たせる事はない。一つの task を同時に二つのスレッドで
+   *   実行する事はない。
+   *
+   *   前面の端末 (task::is_foreground()) は別の列に入れて背景の端末より先に実行する。
+   *
+   * @fn static std::shared_ptr<parser_pool> instance(std::size_t thread_count);
+   *   プロセスで共有する parser_pool を返す。thread_count は最初に作成する時にだけ使う。
+   *   全ての端末が解放すると作業スレッドも終了する。
+   * @fn void schedule(task* t);
+   *   t を実行待ちにする。t の実行中に呼び出された時は、実行の後にもう一度実行する。
+   * @fn void remove(task* t);
+   *   t の実行が終わるのを待ってから列から取り除く。以降 schedule を呼び出してはならない。
+   */
+  class parser_pool {
+  public:
+    class task {
+      friend class parser_pool;
+      bool m_queued = false;
+      bool m_running = false;
+      bool m_rerun = false;
+      std::atomic<bool> m_foreground {false};
+
+    public:
+      virtual ~task() {}
+      bool is_foreground() const { return m_foreground.load(std::memory_order_relaxed); }
+      void set_foreground(bool value) { m_foreground.store(value, std::memory_order_relaxed); }
+      // 一回分の構文解析を行う。まだデータが残っているかもしれない時は true を返す。
+      virtual bool parse() = 0;
+    };
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond_queued;
+    std::condition_variable m_cond_finished;
+    std::deque<task*> m_foreground_queue;
+    std::deque<task*> m_background_queue;
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+
+  public:
+    explicit parser_pool(std::size_t thread_count) {
+      m_workers.reserve(thread_count);
+      for (std::size_t i = 0; i < thread_count; i++)
+        m_workers.emplace_back([this] { this->run(); });
+    }
+    ~parser_pool() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_cond_queued.notify_all();
+      for (std::thread& worker : m_workers) worker.join();
+    }
+    parser_pool(parser_pool const&) = delete;
+    parser_pool& operator=(parser_pool const&) = delete;
+
+    static std::shared_ptr<parser_pool> instance(std::size_t thread_count) {
+      static std::mutex mutex;
+      static std::weak_ptr<parser_pool> instance;
+      std::lock_guard<std::mutex> lock(mutex);
+      std::shared_ptr<parser_pool> pool = instance.lock();
+      if (!pool) instance = pool = std::make_shared<parser_pool>(thread_count);
+      return pool;
+    }
+
+    void schedule(task* t) {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (t->m_running) {
+          t->m_rerun = true;
+          return;
+        }
+        if (t->m_queued) return;
+        enqueue(t);
+      }
+      m_cond_queued.notify_one();
+    }
+    void remove(task* t) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond_finished.wait(lock, [t] { return !t->m_running; });
+      if (t->m_queued) {
+        for (std::deque<task*>* queue : {&m_foreground_queue, &m_background_queue})
+          queue->erase(std::remove(queue->begin(), queue->end(), t), queue->end());
+        t->m_queued = false;
+      }
+    }
+
+  private:
+    void enqueue(task* t) {
+      t->m_queued = true;
+      (t->is_foreground() ? m_foreground_queue : m_background_queue).push_back(t);
+    }
+    void run() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      for (;;) {
+        m_cond_queued.wait(lock, [this] {
+          return m_stop || !m_foreground_queue.empty() || !m_background_queue.empty();
+        });
+        if (m_stop) break;
+
+        std::deque<task*>& queue = !m_foreground_queue.empty() ? m_foreground_queue : m_background_queue;
+        task* const t = queue.front();
+        queue.pop_front();
+        t->m_queued = false;
+        t->m_running = true;
+
+        lock.unlock();
+        bool const remaining = t->parse();
+        lock.lock();
+
+        t->m_running = false;
+        if (remaining || t->m_rerun) {
+          t->m_rerun = false;
+          enqueue(t);
+        }
+        m_cond_finished.notify_all();
+      }
+    }
+  };
+
+  /*?lwiki
+   * @class pty_parser_thread
+   *   pty_reader_thread が溜めたデータを別スレッドで構文解析する。
+   *   pool を指定しない時は専用のスレッドで、指定した時は parser_pool の作業スレッドで構文解析する。
+   *   構文解析は term を lock() した状態で少しずつ行う。一度に構文解析する量は、前面の端末では
+   *   read_limit byte にして lock を短くし (描画側を待たせない為)、背景の端末では
+   *   その background_batch_factor 倍にして処理量を優先する。
+   *
+   *   描画側は描画の時刻に update_frame() で term_t::copy_frame を呼び出して
+   *   変更された行だけを描画用の複製 (frame) に写し、lock_frame() して frame_view() を描画する。
+   *   描画中も構文解析は止まらない。
+   *
+   *   Note: 構文解析スレッドは frame を写さない。出力が続いている間に描画されない frame を
+   *     何度も作らない為。前回の update_frame() の後に最初に構文解析した時と、
+   *     同期更新 (DECSET 2026) が解除された時にだけ notify_fd() で描画側を起こす。
+   */
+  class pty_parser_thread: public parser_pool::task {
+    static constexpr std::size_t background_batch_factor = 16;
+
+    pty_reader_thread* m_reader;
+    contra::idevice* m_dev;
+    contra::ansi::term_view_t* m_view;
+    std::size_t m_read_limit;
+    std::shared_ptr<parser_pool> m_pool;
+
+    std::recursive_mutex m_term_mutex;
+    std::atomic<int> m_ui_waiting {0}; // lock() で待っている UI の数
+    std::mutex m_handoff_mutex;
+    std::condition_variable m_handoff_cond;
+    std::mutex m_frame_mutex;
+    contra::ansi::term_t m_frame;
+    contra::ansi::term_view_t m_frame_view;
+    bool m_sync = false;
+
+    int m_notify[2] = {-1, -1}; // 構文解析スレッド → UI
+    int m_wake[2] = {-1, -1};   // stop → 構文解析スレッド
+    std::atomic<bool> m_dirty {false};
+    std::atomic<bool> m_notified {false};
+    std::atomic<bool> m_stop {false};
+    std::thread m_thread;
+
+  public:
+    // Note: pool を使う時は reader を開始する前に作成する (データの到着の通知先を設定する為)。
+    pty_parser_thread(
+      pty_reader_thread* reader, contra::idevice* dev, contra::ansi::term_view_t* view,
+      std::size_t read_limit, std::shared_ptr<parser_pool> pool
+    ):
+      m_reader(reader), m_dev(dev), m_view(view), m_read_limit(read_limit), m_pool(std::move(pool)),
+      m_frame(view->width(), view->height())
+    {
+      m_frame_view.set_term(&m_frame);
+      if (m_pool)
+        m_reader->set_notify_handler([this] { m_pool->schedule(this); });
+    }
+    ~pty_parser_thread() {
+      stop();
+      for (int const fd : {m_notify[0], m_notify[1], m_wake[0], m_wake[1]})
+        if (fd >= 0) ::close(fd);
+    }
+    pty_parser_thread(pty_parser_thread const&) = delete;
+    pty_parser_thread& operator=(pty_parser_thread const&) = delete;
+
+    int notify_fd() const { return m_notify[0]; }
+    contra::ansi::term_view_t& frame_view() { return m_frame_view; }
+
+    bool start() {
+      if (m_notify[0] < 0 && !fd_create_pipe(m_notify)) return false;
+      if (m_pool) {
+        m_pool->schedule(this); // start までに到着したデータ
+        return true;
+      }
+      if (m_thread.joinable()) return true;
+      if (m_wake[0] < 0 && !fd_create_pipe(m_wake)) return false;
+      m_thread = std::thread([this] { this->run(); });
+      return true;
+    }
+    // Note: pool を使う時は reader も停止する (以降 schedule されない様にする為)。
+    void stop() {
+      if (m_pool) {
+        m_reader->stop();
+        m_pool->remove(this);
+      } else if (m_thread.joinable()) {
+        m_stop = true;
+        fd_notify(m_wake[1]);
+        m_thread.join();
+      }
+    }
+
+    // Note: std::recursive_mutex は公平でないので、構文解析スレッドが解放直後に取り直して
+    //   UI が待たされ続けない様に、UI が待っている間は構文解析スレッドが次の lock を控える。
+    void lock() {
+      m_ui_waiting.fetch_add(1);
+      m_term_mutex.lock();
+      if (m_ui_waiting.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> handoff(m_handoff_mutex);
+        m_handoff_cond.notify_all();
+      }
+    }
+    void unlock() { m_term_mutex.unlock(); }
+    void lock_frame() { m_frame_mutex.lock(); }
+    void unlock_frame() { m_frame_mutex.unlock(); }
+
+    // (UI) lock() した状態で呼び出す。
+    void update_frame() {
+      std::lock_guard<std::mutex> lock(m_frame_mutex);
+      m_frame.copy_frame(*m_view);
+      m_dirty.store(false);
+    }
+    // (UI) 前回の呼び出しの後に通知があれば true を返す。
+    // Note: パイプを空にしてから m_notified を解除する。逆順だと間に来た通知のバイトを
+    //   読み捨てたまま m_notified が true で残り、以降の通知が止まる。
+    bool consume_notification() {
+      fd_drain(m_notify[0]);
+      return m_notified.exchange(false);
+    }
+
+    virtual bool parse() override {
+      std::size_t const limit = is_foreground() ? m_read_limit : m_read_limit * background_batch_factor;
+      std::size_t consumed;
+      bool sync_released = false;
+      if (m_ui_waiting.load()) {
+        std::unique_lock<std::mutex> handoff(m_handoff_mutex);
+        m_handoff_cond.wait(handoff, [this] { return m_ui_waiting.load() == 0; });
+      }
+      {
+        std::lock_guard<std::recursive_mutex> lock(m_term_mutex);
+        consumed = m_reader->consume(m_dev, limit);
+        if (consumed) {
+          bool const sync = m_view->state().get_mode(contra::ansi::mode_SynchronizedOutput);
+          sync_released = m_sync && !sync;
+          m_sync = sync;
+        }
+      }
+      if (consumed && (!m_dirty.exchange(true) || sync_released)) notify();
+      return consumed >= limit;
+    }
+
+  private:
+    void run() {
+      struct pollfd fds[2];
+      fds[0].fd = m_reader->notify_fd();
+      fds[0].events = POLLIN;
+      fds[1].fd = m_wake[0];
+      fds[1].events = POLLIN;
+      while (!m_stop.load(std::memory_order_relaxed)) {
+        if (parse()) continue;
+        ::poll(fds, 2, -1);
+        fd_drain(m_wake[0]);
+      }
+    }
+    void notify() {
+      if (!m_notified.exchange(true))
+        fd_notify(m_notify[1]);
+    }
+  };
+
   class terminal_session: public terminal_application {
     typedef terminal_application base;
   private:
@@ -231,6 +684,45 @@ namespace term {
     contra::idevice& input_device() { return m_pty; }
     contra::multicast_device& output_device() { return m_dev; }
 
+  private:
+    std::unique_ptr<pty_reader_thread> m_reader;
+    std::unique_ptr<pty_parser_thread> m_parser;
+    std::size_t m_read_limit = 0;
+  public:
+    // pty からの読み取りを別スレッドで行う設定。
+    // parse の時は構文解析も別スレッドで行う (描画には frame_view() を使う)。
+    // parse_threads > 0 の時は構文解析を共有の parser_pool で行う。
+    bool setup_threads(std::size_t capacity, std::size_t read_limit, bool parse, std::size_t parse_threads) {
+      if (m_reader) return true;
+      m_reader = std::make_unique<pty_reader_thread>(capacity);
+      m_read_limit = read_limit;
+      if (m_dev_capture) m_reader->set_capture_device(m_dev_capture.get());
+      if (parse) {
+        std::shared_ptr<parser_pool> pool;
+        if (parse_threads) pool = parser_pool::instance(parse_threads);
+        m_parser = std::make_unique<pty_parser_thread>(m_reader.get(), &m_dev, &base::view(), m_read_limit, std::move(pool));
+      }
+      if (!m_reader->start(m_pty.fd()) || (m_parser && !m_parser->start())) {
+        m_parser.reset();
+        m_reader.reset();
+        if (m_dev_capture) m_dev.push(m_dev_capture.get()); // 主スレッドでの読み取りに戻る
+        return false;
+      }
+      return true;
+    }
+
+    virtual void lock() override { if (m_parser) m_parser->lock(); }
+    virtual void unlock() override { if (m_parser) m_parser->unlock(); }
+    virtual void update_frame() override { if (m_parser) m_parser->update_frame(); }
+    virtual void lock_frame() override { if (m_parser) m_parser->lock_frame(); }
+    virtual void unlock_frame() override { if (m_parser) m_parser->unlock_frame(); }
+    virtual contra::ansi::term_view_t& frame_view() override {
+      return m_parser ? m_parser->frame_view() : base::view();
+    }
+    virtual void set_foreground(bool value) override {
+      if (m_parser) m_parser->set_foreground(value);
+    }
+
   private:
     std::unique_ptr<contra::term::fd_device> m_dev_tee;
   public:
@@ -251,6 +743,22 @@ namespace term {
       m_dev.push(m_dev_seq.get());
     }
 
+  private:
+    std::unique_ptr<contra::term::capture_writer> m_dev_capture;
+  public:
+    // これは性能の測定の為に受信したデータを時刻と共に記録する設定。
+    // 読取スレッドを使う時は m_dev には追加せず、読取スレッドで記録する (setup_threads)。
+    void setup_capture(const char* fname, curpos_t width, curpos_t height, bool threaded) {
+      if (m_dev_capture) return;
+      m_dev_capture = std::make_unique<contra::term::capture_writer>();
+      if (!m_dev_capture->open(fname, width, height)) {
+        contra::xprint(errdev(), "contra: failed to open the capture file\n");
+        m_dev_capture.reset();
+        return;
+      }
+      if (!threaded) m_dev.push(m_dev_capture.get());
+    }
+
   public:
     bool initialize(terminal_session_parameters const& params) {
       if (m_pty.is_active()) return true;
@@ -259,9 +767,18 @@ namespace term {
 
       if (!m_pty.start(params)) return false;
 
+      // Note: 受信した時刻を記録する為に term より先に追加する。
+      bool const threaded = params.threaded_read || params.threaded_parse;
+      if (!params.dbg_capture_file.empty())
+        setup_capture(params.dbg_capture_file.c_str(), params.col, params.row, threaded);
+
       base::term().set_input_device(m_pty);
       m_dev.push(&base::term());
       base::term().set_scroll_capacity(params.scroll_buffer_size);
+      base::term().set_scroll_freeze_age(params.scroll_freeze_age);
+      if (params.scroll_spill && !base::term().set_scroll_spill(true))
+        contra::xprint(errdev(), "contra: failed to create the scrollback spill file\n");
+      base::term().set_scroll_search_index(params.scroll_search_index);
 
       // for diagnostics
       if (params.dbg_fd_tee)
@@ -269,9 +786,27 @@ namespace term {
       if (params.dbg_sequence_logfile)
         setup_sequence_log(params.dbg_sequence_logfile);
 
+      if (threaded &&
+        !setup_threads(params.read_ring_size, params.fd_read_buffer_size, params.threaded_parse, params.parse_threads))
+        contra::xprint(errdev(), "contra: failed to start the pty reader thread\n");
+
       return true;
     }
-    virtual bool process() override { return m_pty.read(&m_dev); }
+    ~terminal_session() {
+      // Note: m_dev の書込先より先にスレッドを止める。
+      m_parser.reset();
+      m_reader.reset();
+    }
+
+    virtual bool process() override {
+      if (m_parser) return m_parser->consume_notification();
+      if (m_reader) return m_reader->consume(&m_dev, m_read_limit);
+      return m_pty.read(&m_dev);
+    }
+    virtual int fd() const override {
+      if (m_parser) return m_parser->notify_fd();
+      return m_reader ? m_reader->notify_fd() : m_pty.fd();
+    }
     virtual bool is_active() const override { return m_pty.is_active(); }
     virtual bool is_alive() override { return m_pty.is_alive(); }
     virtual void terminate() override { return m_pty.terminate(); }
@@ -281,6 +816,8 @@ namespace term {
       base::reset_size(width, height, xunit, yunit);
       if (m_pty.is_active())
         m_pty.set_winsize(width, height, xunit, yunit);
+      if (m_dev_capture)
+        m_dev_capture->write_resize(width, height);
     }
   };
 
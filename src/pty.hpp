@@ -48,15 +48,23 @@ namespace term {
   struct terminal_session_parameters {
     curpos_t col = 80, row = 24, xunit = 7, yunit = 13;
     curpos_t scroll_buffer_size = 1000;
+    curpos_t scroll_freeze_age = 512;
+    bool scroll_spill = false;
+    bool scroll_search_index = true;
     exec_error_handler_t exec_error_handler = nullptr;
     std::uintptr_t exec_error_param = 0u;
     struct termios* termios = nullptr;
     std::unordered_map<std::string, std::string> env;
     std::string shell;
     std::size_t fd_read_buffer_size = 4096;
+    bool threaded_read = false; // pty を別スレッドで読み取る
+    bool threaded_parse = false; // 構文解析も別スレッドで行う (threaded_read を含む)
+    std::size_t parse_threads = 0; // 構文解析を共有するスレッドの数 (0 の時は端末毎にスレッドを作る)
+    std::size_t read_ring_size = 1 << 20;
 
     int dbg_fd_tee = -1;
     const char* dbg_sequence_logfile = nullptr;
+    std::string dbg_capture_file; // 受信データを記録するファイル (./replay で再生する)
   };
 
   std::unique_ptr<terminal_application> create_terminal_session(terminal_session_parameters& params);
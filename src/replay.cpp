@@ -0,0 +1,219 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "ansi/term.hpp"
+#include "ttty/buffer.hpp"
+#include "capture.hpp"
+
+// 受信データの記録 (session_capture_file) を再生して、フレーム毎の処理時間を測る。
+//
+//   ./replay [options] capture-file
+//
+//   -t, --realtime     記録した時刻に合わせて再生する (既定は最大速度で再生する)
+//   -f MSEC            フレームの間隔 (既定 16)。記録した時刻でこの間隔毎に区切って描画する。
+//   -n, --no-render    描画しない
+//   -s LINES           スクロールバッファの行数 (既定 1000)
+//   -v                 フレーム毎の結果を表示する
+//
+// 描画は tty_observer で /dev/null に出力する。
+// 構文解析 (term_t::write_bytes) と描画の時間、その間のメモリ確保の回数と量を表示する。
+
+namespace {
+  std::size_t g_allocation_count = 0;
+  std::size_t g_allocation_bytes = 0;
+}
+
+// メモリ確保を数える為に置き換える。
+// Note: delete を inline 展開させると -Wmismatched-new-delete が出るので noinline にする。
+void* operator new(std::size_t size) {
+  g_allocation_count++;
+  g_allocation_bytes += size;
+  if (void* const ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* ptr) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+  using namespace contra::ansi;
+
+  struct replay_params {
+    bool realtime = false;
+    bool render = true;
+    bool verbose = false;
+    std::uint64_t frame_interval = 16000000; // [ns]
+    std::size_t scroll_buffer_size = 1000;
+    const char* filename = nullptr;
+  };
+
+  struct frame_result {
+    std::size_t bytes = 0;
+    double parse_time = 0.0;  // [us]
+    double render_time = 0.0; // [us]
+    std::size_t allocation_count = 0;
+    std::size_t allocation_bytes = 0;
+  };
+
+  template<typename F>
+  void print_statistics(const char* name, std::vector<frame_result> const& frames, F get) {
+    std::vector<double> values;
+    values.reserve(frames.size());
+    double total = 0.0;
+    for (frame_result const& frame : frames) {
+      values.push_back(get(frame));
+      total += values.back();
+    }
+    std::sort(values.begin(), values.end());
+    auto _percentile = [&] (double p) {
+      return values[std::min(values.size() - 1, (std::size_t) (p * values.size()))];
+    };
+    std::printf("%-14s %12.1f %12.1f %12.1f %12.1f %14.1f\n", name,
+      total / values.size(), _percentile(0.5), _percentile(0.99), values.back(), total);
+  }
+
+  bool parse_args(int argc, char** argv, replay_params& params) {
+    for (int i = 1; i < argc; i++) {
+      const char* const arg = argv[i];
+      if (std::strcmp(arg, "-t") == 0 || std::strcmp(arg, "--realtime") == 0) {
+        params.realtime = true;
+      } else if (std::strcmp(arg, "-n") == 0 || std::strcmp(arg, "--no-render") == 0) {
+        params.render = false;
+      } else if (std::strcmp(arg, "-v") == 0) {
+        params.verbose = true;
+      } else if (std::strcmp(arg, "-f") == 0 && i + 1 < argc) {
+        params.frame_interval = std::max(std::atoi(argv[++i]), 1) * UINT64_C(1000000);
+      } else if (std::strcmp(arg, "-s") == 0 && i + 1 < argc) {
+        params.scroll_buffer_size = std::strtoul(argv[++i], nullptr, 10);
+      } else if (arg[0] == '-') {
+        std::fprintf(stderr, "replay: unknown option \"%s\"\n", arg);
+        return false;
+      } else {
+        params.filename = arg;
+      }
+    }
+    if (!params.filename) {
+      std::fprintf(stderr, "usage: replay [-t] [-f MSEC] [-n] [-s LINES] [-v] capture-file\n");
+      return false;
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  contra::initialize_errdev();
+
+  replay_params params;
+  if (!parse_args(argc, argv, params)) return 2;
+
+  contra::term::capture_reader reader;
+  if (!reader.open(params.filename)) {
+    std::fprintf(stderr, "replay: failed to open the capture file \"%s\"\n", params.filename);
+    return 1;
+  }
+
+  term_t term(reader.width(), reader.height());
+  term.set_scroll_capacity(params.scroll_buffer_size);
+  term_view_t view(&term);
+
+  std::FILE* const null_file = std::fopen("/dev/null", "w");
+  if (!null_file) return 1;
+  contra::dict::termcap_sgr_type sgrcap;
+  sgrcap.initialize();
+  contra::ttty::tty_observer renderer(null_file, &sgrcap);
+  renderer.reset_size(reader.width(), reader.height());
+
+  typedef std::chrono::steady_clock clock_type;
+  auto _elapsed_us = [] (clock_type::time_point t0, clock_type::time_point t1) {
+    return std::chrono::duration<double, std::micro>(t1 - t0).count();
+  };
+
+  std::vector<frame_result> frames;
+  frame_result frame;
+  bool frame_active = false;
+  std::uint64_t frame_end = 0;
+  std::size_t record_count = 0, total_bytes = 0;
+
+  auto _flush_frame = [&] () {
+    if (!frame_active) return;
+    if (params.render) {
+      std::size_t const count0 = g_allocation_count, bytes0 = g_allocation_bytes;
+      auto const time0 = clock_type::now();
+      renderer.update(view);
+      auto const time1 = clock_type::now();
+      frame.render_time = _elapsed_us(time0, time1);
+      frame.allocation_count += g_allocation_count - count0;
+      frame.allocation_bytes += g_allocation_bytes - bytes0;
+    }
+    if (params.verbose)
+      std::printf("frame %zu: bytes=%zu parse=%.1fus render=%.1fus alloc=%zu (%zu bytes)\n",
+        frames.size(), frame.bytes, frame.parse_time, frame.render_time,
+        frame.allocation_count, frame.allocation_bytes);
+    frames.push_back(frame);
+    frame = frame_result();
+    frame_active = false;
+  };
+
+  auto const start = clock_type::now();
+  contra::term::capture_record record;
+  while (reader.next(record)) {
+    // 記録した時刻でフレームに区切る。
+    if (frame_active && record.time >= frame_end) _flush_frame();
+    if (!frame_active) {
+      frame_active = true;
+      frame_end = (record.time / params.frame_interval + 1) * params.frame_interval;
+    }
+    if (params.realtime)
+      std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.time));
+
+    record_count++;
+    switch (record.type) {
+    case contra::term::capture_output:
+      {
+        std::size_t const count0 = g_allocation_count, bytes0 = g_allocation_bytes;
+        auto const time0 = clock_type::now();
+        term.write_bytes(record.data, record.size);
+        auto const time1 = clock_type::now();
+        frame.parse_time += _elapsed_us(time0, time1);
+        frame.allocation_count += g_allocation_count - count0;
+        frame.allocation_bytes += g_allocation_bytes - bytes0;
+        frame.bytes += record.size;
+        total_bytes += record.size;
+      }
+      break;
+    case contra::term::capture_resize:
+      term.reset_size(record.width, record.height);
+      renderer.reset_size(record.width, record.height);
+      break;
+    }
+  }
+  _flush_frame();
+  auto const finish = clock_type::now();
+  std::fclose(null_file);
+
+  if (frames.empty()) {
+    std::printf("no records\n");
+    return 0;
+  }
+
+  std::printf("# %s: %ux%u, %zu records, %zu bytes, %zu frames (%llums), %s\n",
+    params.filename, reader.width(), reader.height(), record_count, total_bytes, frames.size(),
+    (unsigned long long) (params.frame_interval / 1000000), params.realtime ? "realtime" : "max speed");
+  std::printf("%-14s %12s %12s %12s %12s %14s\n", "per frame", "mean", "p50", "p99", "max", "total");
+  print_statistics("parse/us", frames, [] (frame_result const& f) { return f.parse_time; });
+  if (params.render)
+    print_statistics("render/us", frames, [] (frame_result const& f) { return f.render_time; });
+  print_statistics("alloc/count", frames, [] (frame_result const& f) { return (double) f.allocation_count; });
+  print_statistics("alloc/bytes", frames, [] (frame_result const& f) { return (double) f.allocation_bytes; });
+  std::printf("line pool: %zu allocations, %zu recycles\n",
+    term.scroll_buffer().line_pool().allocation_count(), term.scroll_buffer().line_pool().recycle_count());
+  std::printf("elapsed %.1fms\n", _elapsed_us(start, finish) / 1000.0);
+  return 0;
+}
@@ -15,6 +15,7 @@
 #include <mwg/except.h>
 #include "enc.utf8.hpp"
 #include "iso2022.hpp"
+#include "util.hpp"
 
 namespace contra {
 
@@ -123,6 +124,182 @@ namespace contra {
     }
   };
 
+  //---------------------------------------------------------------------------
+  // CSI parameters
+
+  typedef std::uint32_t csi_param_t;
+
+  class csi_parameters {
+    struct csi_param_holder {
+      csi_param_t value;
+      bool isColon;
+      bool isDefault;
+    };
+
+    // Note: 通常の CSI は高々数個の引数しか持たないので内部配列に保持する。
+    //   16 個を超える場合 (SGR の羅列など) にだけ動的確保に切り替わる。
+    util::small_vector<csi_param_holder, 16> m_data;
+    std::size_t m_private_prefix_count;
+    std::size_t m_index;
+
+    // 逐次解析の途中状態
+    csi_param_holder m_param;
+    bool m_isSet;
+
+  public:
+    enum result_code_t {
+      parse_incomplete = -1,
+      parse_ok = 0,
+      parse_invalid = 1,
+      parse_overflow = 2,
+    };
+  private:
+    result_code_t m_result_code;
+
+  public:
+    void initialize() {
+      m_data.clear();
+      m_index = 0;
+      m_private_prefix_count = 0;
+      m_isColonAppeared = false;
+      m_param = {0, false, true};
+      m_isSet = false;
+      m_result_code = parse_incomplete;
+    }
+    void initialize(char32_t const* begin, char32_t const* end) {
+      initialize();
+      read_parameters(begin, end);
+    }
+    void initialize(char32_t const* s, std::size_t n) { initialize(s, s + n); }
+    void initialize(sequence const& seq) { initialize(seq.parameter(), seq.parameter_end()); }
+
+    csi_parameters(): m_result_code(parse_incomplete) {}
+    template<typename... Args>
+    explicit csi_parameters(Args&&... args) {
+      this->initialize(std::forward<Args>(args)...);
+    }
+
+    operator bool() const { return this->m_result_code == parse_ok; }
+    bool operator!() const { return !this->operator bool(); }
+    result_code_t result_code() const { return this->m_result_code; }
+
+  public:
+    std::size_t private_prefix_count() const { return m_private_prefix_count; }
+    std::size_t size() const {return m_data.size();}
+    void push_back(csi_param_holder const& value) {m_data.push_back(value);}
+
+  public:
+    /*?lwiki
+     * @fn void push_char(char32_t c);
+     *   パラメータ文字 (0x30-0x3F) を一文字ずつ受け取って解析を進める。
+     *   sequence_decoder が CSI を受信しながら呼び出す。
+     * @fn void finish();
+     *   パラメータ部分の終端で呼び出し、解析結果を確定する。
+     */
+    void push_char(char32_t c) {
+      if (m_result_code != parse_incomplete) return;
+
+      if (!m_isSet && m_data.empty() && ascii_less <= c && c <= ascii_question) {
+        m_private_prefix_count++;
+        return;
+      }
+
+      if (!(ascii_0 <= c && c <= ascii_semicolon)) {
+        m_result_code = parse_invalid;
+        return;
+      }
+
+      if (c <= ascii_9) {
+        int const digit = c - ascii_0;
+
+        // overflow check
+        constexpr auto max_value = std::numeric_limits<csi_param_t>::max();
+        if (m_param.value > (max_value - digit) / 10) {
+          m_result_code = parse_overflow;
+          return;
+        }
+
+        m_isSet = true;
+        m_param.value = m_param.value * 10 + digit;
+        m_param.isDefault = false;
+      } else {
+        m_data.push_back(m_param);
+        m_isSet = true;
+        m_param.value = 0;
+        m_param.isColon = c == ascii_colon;
+        m_param.isDefault = true;
+      }
+    }
+    void finish() {
+      if (m_result_code != parse_incomplete) return;
+      if (m_isSet) m_data.push_back(m_param);
+      m_result_code = parse_ok;
+    }
+
+    // 解析済みの引数を先頭から読み直す。
+    void rewind() {
+      m_index = 0;
+      m_isColonAppeared = false;
+    }
+
+  private:
+    bool read_parameters(char32_t const* begin, char32_t const* end) {
+      while (begin != end) push_char(*begin++);
+      finish();
+      return m_result_code == parse_ok;
+    }
+
+  private:
+    bool m_isColonAppeared;
+
+  public:
+    bool read_param(csi_param_t& result, std::uint32_t defaultValue) {
+      while (m_index < m_data.size()) {
+        csi_param_holder const& param = m_data[m_index++];
+        if (!param.isColon) {
+          m_isColonAppeared = false;
+          if (!param.isDefault)
+            result = param.value;
+          else
+            result = defaultValue;
+          return true;
+        }
+      }
+      result = defaultValue;
+      return false;
+    }
+
+    bool read_arg(csi_param_t& result, bool toAllowSemicolon, csi_param_t defaultValue) {
+      if (m_index < m_data.size()
+        && (m_data[m_index].isColon || (toAllowSemicolon && !m_isColonAppeared))
+      ) {
+        csi_param_holder const& param = m_data[m_index++];
+        if (param.isColon) m_isColonAppeared = true;
+        if (!param.isDefault)
+          result = param.value;
+        else
+          result = defaultValue;
+        return true;
+      }
+
+      result = defaultValue;
+      return false;
+    }
+
+    void debug_print(std::FILE* file) const {
+      bool is_first = true;
+      for (auto const& entry : m_data) {
+        if (entry.isColon)
+          std::putc(':', file);
+        else if (!is_first)
+          std::putc(';', file);
+        if (!entry.isDefault)
+          std::fprintf(file, "%u", entry.value);
+        is_first = false;
+      }
+    }
+  };
+
   struct sequence_decoder_config {
     bool c1_8bit_representation_enabled     = true; // 8bit C1 制御文字を有効にする。
     bool osc_sequence_terminated_by_bel     = true; // OSC シーケンスが BEL で終わっても良い。
@@ -154,11 +331,20 @@ namespace contra {
     decode_state m_dstate = decode_default;
 
     sequence m_seq;
+    csi_parameters m_csiparams;
     bool m_iso2022_trivial = true;
 
   public:
     sequence_decoder(Processor* proc, sequence_decoder_config* config): m_proc(proc), m_config(config) {}
 
+    /*?lwiki
+     * @fn csi_parameters& csi_params();
+     *   m_proc->process_control_sequence(seq) の呼び出し中に限り、
+     *   seq のパラメータを解析した結果を返す。
+     *   パラメータは受信と同時に解析されているので再走査は不要である。
+     */
+    csi_parameters& csi_params() { return m_csiparams; }
+
   private:
     // 以下の charset_t のメンバの値は、全て charset_t に加えて、
     // その文字集合が 94 であるか 96 であるかを識別する為のフラグを付加した物である。
@@ -491,6 +677,7 @@ namespace contra {
           switch (uchar) {
           case ascii_csi:
             m_seq.set_type((byte) uchar);
+            m_csiparams.initialize();
             goto decode_csiseq;
             break;
           case ascii_sos:
@@ -554,7 +741,7 @@ namespace contra {
       case decode_iso2022:
       decode_iso2022:
         {
-          if (!_next_char_raw()) return decode_default;
+          if (!_next_char_raw()) return decode_iso2022;
 
           if (uchar < 0x100 && 0x20 <= (uchar & 0x7F)) {
             process_char_iso2022_graphic(uchar);
@@ -643,6 +830,7 @@ namespace contra {
           // P..P
           while (0x30 <= uchar && uchar <= 0x3F) {
             m_seq.append(uchar);
+            m_csiparams.push_char(uchar);
             if (!_next_char_csi())
               return decode_csiseq;
           }
@@ -667,6 +855,7 @@ namespace contra {
           }
 
         process_control_sequence:
+          m_csiparams.finish();
           m_proc->process_control_sequence(this->m_seq);
           this->m_seq.clear();
           goto decode_plain;
@@ -757,6 +946,57 @@ namespace contra {
       decode(&uchar, &uchar + 1);
     }
 
+  private:
+    static constexpr bool is_ascii_graphic(byte b) {
+      return 0x20 <= b && b < 0x7F;
+    }
+    // Note: 状態が変化し得る (シーケンスの終端になり得る) ASCII バイト。
+    static constexpr bool is_ascii_delimiter(byte b) {
+      return b < 0x20 || (0x40 <= b && b < 0x80);
+    }
+
+  public:
+    /*?lwiki
+     * @fn void decode_bytes(char const* beg, char const* end, std::uint64_t& utf8_state);
+     *   UTF-8 バイト列を直接読み取って処理します。
+     *   既定の状態にある時、印字可能 ASCII の連続は char32_t に変換せずに
+     *   `process_chars(byte const*, byte const*)` で直接 Processor に渡します。
+     *   それ以外の部分は区切りになり得るバイトまでを小さな一時領域に復号して
+     *   `decode_impl` で処理します。
+     * @param[in,out] utf8_state
+     *   `encoding::utf8_decode` の状態です。
+     */
+    void decode_bytes(char const* beg, char const* end, std::uint64_t& utf8_state) {
+      constexpr std::size_t buffer_size = 256;
+      char32_t buff[buffer_size];
+
+      byte const* p = reinterpret_cast<byte const*>(beg);
+      byte const* const pend = reinterpret_cast<byte const*>(end);
+      while (p != pend) {
+        if (m_dstate == decode_default && m_iso2022_trivial && !utf8_state && is_ascii_graphic(*p)) {
+          byte const* const batch_begin = p;
+          do p++; while (p != pend && is_ascii_graphic(*p));
+          m_proc->process_chars(batch_begin, p);
+          continue;
+        }
+
+        // 次に状態が変わり得るバイトまで (それを含む) を一括で復号
+        byte const* q = p;
+        std::size_t const max_size = std::min<std::size_t>(pend - p, buffer_size - 1);
+        while (q != p + max_size && !is_ascii_delimiter(*q)) q++;
+        if (q != p + max_size) q++;
+
+        char const* ibeg = reinterpret_cast<char const*>(p);
+        char const* const iend = reinterpret_cast<char const*>(q);
+        while (ibeg != iend) {
+          char32_t* obeg = buff;
+          contra::encoding::utf8_decode(ibeg, iend, obeg, buff + buffer_size, utf8_state);
+          m_dstate = decode_impl(buff, obeg);
+        }
+        p = q;
+      }
+    }
+
     void process_end() {
       switch (m_dstate) {
       case decode_esc:
@@ -911,157 +1151,6 @@ namespace contra {
     }
   };
 
-  //---------------------------------------------------------------------------
-  // CSI parameters
-
-  typedef std::uint32_t csi_param_t;
-
-  class csi_parameters {
-    struct csi_param_holder {
-      csi_param_t value;
-      bool isColon;
-      bool isDefault;
-    };
-
-    std::vector<csi_param_holder> m_data;
-    std::size_t m_private_prefix_count;
-    std::size_t m_index;
-
-  public:
-    enum result_code_t {
-      parse_incomplete = -1,
-      parse_ok = 0,
-      parse_invalid = 1,
-      parse_overflow = 2,
-    };
-  private:
-    result_code_t m_result_code;
-
-  public:
-    void initialize() {
-      m_data.clear();
-      m_index = 0;
-      m_private_prefix_count = 0;
-      m_isColonAppeared = false;
-      m_result_code = parse_incomplete;
-    }
-    void initialize(char32_t const* begin, char32_t const* end) {
-      initialize();
-      read_parameters(begin, end);
-    }
-    void initialize(char32_t const* s, std::size_t n) { initialize(s, s + n); }
-    void initialize(sequence const& seq) { initialize(seq.parameter(), seq.parameter_end()); }
-
-    csi_parameters(): m_result_code(parse_incomplete) {}
-    template<typename... Args>
-    explicit csi_parameters(Args&&... args) {
-      this->initialize(std::forward<Args>(args)...);
-    }
-
-    operator bool() const { return this->m_result_code == parse_ok; }
-    bool operator!() const { return !this->operator bool(); }
-    result_code_t result_code() const { return this->m_result_code; }
-
-  public:
-    std::size_t private_prefix_count() const { return m_private_prefix_count; }
-    std::size_t size() const {return m_data.size();}
-    void push_back(csi_param_holder const& value) {m_data.push_back(value);}
-
-  private:
-    bool read_parameters(char32_t const* begin, char32_t const* end) {
-      bool isSet = false;
-      csi_param_holder param {0, false, true};
-
-      while (begin != end && ascii_less <= *begin && *begin <= ascii_question) {
-        begin++;
-        m_private_prefix_count++;
-      }
-
-      while (begin != end) {
-        char32_t const c = *begin++;
-        if (!(ascii_0 <= c && c <= ascii_semicolon)) {
-          m_result_code = parse_invalid;
-          return false;
-        }
-
-        if (c <= ascii_9) {
-          int const digit = c - ascii_0;
-
-          // overflow check
-          constexpr auto max_value = std::numeric_limits<csi_param_t>::max();
-          if (param.value > (max_value - digit) / 10) {
-            m_result_code = parse_overflow;
-            return false;
-          }
-
-          isSet = true;
-          param.value = param.value * 10 + digit;
-          param.isDefault = false;
-        } else {
-          m_data.push_back(param);
-          isSet = true;
-          param.value = 0;
-          param.isColon = c == ascii_colon;
-          param.isDefault = true;
-        }
-      }
-
-      if (isSet) m_data.push_back(param);
-      m_result_code = parse_ok;
-      return true;
-    }
-
-  private:
-    bool m_isColonAppeared;
-
-  public:
-    bool read_param(csi_param_t& result, std::uint32_t defaultValue) {
-      while (m_index < m_data.size()) {
-        csi_param_holder const& param = m_data[m_index++];
-        if (!param.isColon) {
-          m_isColonAppeared = false;
-          if (!param.isDefault)
-            result = param.value;
-          else
-            result = defaultValue;
-          return true;
-        }
-      }
-      result = defaultValue;
-      return false;
-    }
-
-    bool read_arg(csi_param_t& result, bool toAllowSemicolon, csi_param_t defaultValue) {
-      if (m_index < m_data.size()
-        && (m_data[m_index].isColon || (toAllowSemicolon && !m_isColonAppeared))
-      ) {
-        csi_param_holder const& param = m_data[m_index++];
-        if (param.isColon) m_isColonAppeared = true;
-        if (!param.isDefault)
-          result = param.value;
-        else
-          result = defaultValue;
-        return true;
-      }
-
-      result = defaultValue;
-      return false;
-    }
-
-    void debug_print(std::FILE* file) const {
-      bool is_first = true;
-      for (auto const& entry : m_data) {
-        if (entry.isColon)
-          std::putc(':', file);
-        else if (!is_first)
-          std::putc(';', file);
-        if (!entry.isDefault)
-          std::fprintf(file, "%u", entry.value);
-        is_first = false;
-      }
-    }
-  };
-
   //---------------------------------------------------------------------------
   // input_decoder
 
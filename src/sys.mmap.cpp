@@ -0,0 +1,138 @@
+#include "sys.mmap.hpp"
+#include <cstdlib>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// open, write, ftruncate, unlink
+#include <fcntl.h>
+#include <unistd.h>
+
+// mmap, munmap
+#include <sys/mman.h>
+
+// fstat
+#include <sys/stat.h>
+
+namespace contra::sys {
+
+  bool spill_file::open() {
+    if (m_fd >= 0) return true;
+
+    std::string path;
+    if (const char* tmpdir = std::getenv("TMPDIR"); tmpdir && *tmpdir)
+      path = tmpdir;
+    else
+      path = "/tmp";
+    path += "/contra-scrollback.XXXXXX";
+
+    std::vector<char> buff(path.begin(), path.end());
+    buff.push_back('\0');
+    int const fd = ::mkstemp(&buff[0]);
+    if (fd < 0) return false;
+    ::unlink(&buff[0]);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    m_fd = fd;
+    m_size = 0;
+    return true;
+  }
+
+  void spill_file::close() {
+    if (m_map) {
+      ::munmap(m_map, m_map_size);
+      m_map = nullptr;
+      m_map_size = 0;
+    }
+    if (m_fd >= 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+    m_size = 0;
+  }
+
+  bool spill_file::write_at(std::uint64_t offset, void const* data, std::size_t size) {
+    char const* p = reinterpret_cast<char const*>(data);
+    std::size_t rest = size;
+    while (rest) {
+      ssize_t const n = ::pwrite(m_fd, p, rest, offset + (size - rest));
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      p += n;
+      rest -= n;
+    }
+    return true;
+  }
+
+  bool spill_file::append(void const* data, std::size_t size, std::uint64_t& offset) {
+    if (m_fd < 0) return false;
+    if (!write_at(m_size, data, size)) {
+      // 途中まで書き込んだ分は無かった事にする。
+      if (::ftruncate(m_fd, m_size) != 0) {}
+      return false;
+    }
+    offset = m_size;
+    m_size += size;
+    return true;
+  }
+
+  bool spill_file::overwrite(std::uint64_t offset, void const* data, std::size_t size) {
+    if (m_fd < 0 || offset + size > m_size) return false;
+    // Note: MAP_SHARED で map しているので書き込んだ内容は map した領域にも反映される。
+    return write_at(offset, data, size);
+  }
+
+  std::uint8_t const* spill_file::map(std::uint64_t offset, std::size_t size) {
+    if (m_fd < 0 || offset + size > m_size) return nullptr;
+    if (offset + size > m_map_size) {
+      // Note: ファイルの末尾を越えて map しておき、追記の度に map し直さなくても良い様にする。
+      //   書き込み済みの範囲しか読まないので SIGBUS にはならない。
+      std::size_t const unit = 1 << 20;
+      std::size_t new_size = std::max<std::size_t>(m_map_size * 2, unit);
+      while (new_size < offset + size) new_size *= 2;
+      if (m_map) ::munmap(m_map, m_map_size);
+      m_map = ::mmap(nullptr, new_size, PROT_READ, MAP_SHARED, m_fd, 0);
+      if (m_map == MAP_FAILED) {
+        m_map = nullptr;
+        m_map_size = 0;
+        return nullptr;
+      }
+      m_map_size = new_size;
+    }
+    return reinterpret_cast<std::uint8_t const*>(m_map) + offset;
+  }
+
+  bool mapped_file::open(const char* path) {
+    close();
+    int const fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    if (st.st_size > 0) {
+      void* const map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        ::close(fd);
+        return false;
+      }
+      m_map = map;
+      m_size = st.st_size;
+    }
+    // Note: map した後はファイル記述子は不要。
+    ::close(fd);
+    return true;
+  }
+
+  void mapped_file::close() {
+    if (m_map) ::munmap(m_map, m_size);
+    m_map = nullptr;
+    m_size = 0;
+  }
+
+}
@@ -0,0 +1,76 @@
+// -*- mode: c++; indent-tabs-mode: nil -*-
+#ifndef contra_sys_mmap_hpp
+#define contra_sys_mmap_hpp
+#include <cstddef>
+#include <cstdint>
+
+namespace contra::sys {
+
+  /*?lwiki
+   * @class spill_file
+   *   追記と書き込み済みの範囲の上書きを行う一時ファイル。書き込んだ内容は mmap を通して読み出す。
+   *   ファイルは作成直後に unlink するので、プロセスの終了と共に消える。
+   *
+   * @fn bool open();
+   *   一時ファイルを作成する。$TMPDIR または /tmp に作成する。
+   * @fn bool append(void const* data, std::size_t size, std::uint64_t& offset);
+   *   ファイルの末尾に書き込み、書き込んだ位置を offset に設定する。
+   * @fn bool overwrite(std::uint64_t offset, void const* data, std::size_t size);
+   *   書き込み済みの範囲 [offset, offset + size) を上書きする。範囲がファイルを越える時は失敗する。
+   * @fn std::uint8_t const* map(std::uint64_t offset, std::size_t size);
+   *   指定した範囲を読み出す為のポインタを返す。
+   *   ポインタは次に map または append を呼び出すまで有効である。
+   */
+  class spill_file {
+    int m_fd = -1;
+    std::uint64_t m_size = 0;
+    void* m_map = nullptr;
+    std::size_t m_map_size = 0;
+
+    bool write_at(std::uint64_t offset, void const* data, std::size_t size);
+
+  public:
+    spill_file() {}
+    ~spill_file() { close(); }
+    spill_file(spill_file const&) = delete;
+    spill_file& operator=(spill_file const&) = delete;
+
+    bool open();
+    void close();
+    bool is_open() const { return m_fd >= 0; }
+    std::uint64_t size() const { return m_size; }
+
+    bool append(void const* data, std::size_t size, std::uint64_t& offset);
+    bool overwrite(std::uint64_t offset, void const* data, std::size_t size);
+    std::uint8_t const* map(std::uint64_t offset, std::size_t size);
+  };
+
+  /*?lwiki
+   * @class mapped_file
+   *   既存のファイルの内容を読み取り専用で mmap する。
+   *
+   * @fn bool open(const char* path);
+   *   path を開いて全体を map する。空のファイルも成功として扱う。
+   * @fn char const* data() const;
+   * @fn std::size_t size() const;
+   *   map した内容を返す。
+   */
+  class mapped_file {
+    void* m_map = nullptr;
+    std::size_t m_size = 0;
+
+  public:
+    mapped_file() {}
+    ~mapped_file() { close(); }
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    bool open(const char* path);
+    void close();
+    char const* data() const { return reinterpret_cast<char const*>(m_map); }
+    std::size_t size() const { return m_size; }
+  };
+
+}
+
+#endif
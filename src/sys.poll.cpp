@@ -0,0 +1,113 @@
+#include "sys.poll.hpp"
+#include <cerrno>
+#include <algorithm>
+
+// close, read
+#include <unistd.h>
+
+#ifdef __linux__
+# include <sys/epoll.h>
+# include <sys/timerfd.h>
+#else
+# include <poll.h>
+#endif
+
+namespace contra::sys {
+
+#ifdef __linux__
+  fd_poller::fd_poller() {
+    m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  }
+  fd_poller::~fd_poller() {
+    if (m_epoll >= 0) ::close(m_epoll);
+  }
+#else
+  fd_poller::fd_poller() {}
+  fd_poller::~fd_poller() {}
+#endif
+
+  bool fd_poller::add(int fd) {
+    if (fd < 0) return false;
+    if (std::find(m_fds.begin(), m_fds.end(), fd) != m_fds.end()) return true;
+#ifdef __linux__
+    if (m_epoll < 0) return false;
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+#endif
+    m_fds.push_back(fd);
+    return true;
+  }
+
+  void fd_poller::remove(int fd) {
+    auto const it = std::find(m_fds.begin(), m_fds.end(), fd);
+    if (it == m_fds.end()) return;
+    m_fds.erase(it);
+#ifdef __linux__
+    ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+  }
+
+  bool fd_poller::wait(int timeout_msec) {
+#ifdef __linux__
+    if (m_epoll < 0) return false;
+    struct epoll_event events[16];
+    int const count = ::epoll_wait(m_epoll, events, std::size(events), timeout_msec);
+    if (count <= 0) return false;
+    for (int i = 0; i < count; i++)
+      if (events[i].events & (EPOLLHUP | EPOLLERR))
+        remove(events[i].data.fd);
+    return true;
+#else
+    std::vector<struct pollfd> fds(m_fds.size());
+    for (std::size_t i = 0; i < m_fds.size(); i++) {
+      fds[i].fd = m_fds[i];
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+    int const count = ::poll(fds.data(), fds.size(), timeout_msec);
+    if (count <= 0) return false;
+    for (struct pollfd const& pfd : fds)
+      if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
+        remove(pfd.fd);
+    return true;
+#endif
+  }
+
+#ifdef __linux__
+  interval_timer::interval_timer() {
+    m_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  }
+  interval_timer::~interval_timer() {
+    if (m_fd >= 0) ::close(m_fd);
+  }
+  bool interval_timer::start(int interval_msec) {
+    if (m_fd < 0 || interval_msec <= 0) return false;
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = interval_msec / 1000;
+    spec.it_interval.tv_nsec = interval_msec % 1000 * 1000000L;
+    spec.it_value = spec.it_interval;
+    return ::timerfd_settime(m_fd, 0, &spec, nullptr) == 0;
+  }
+  void interval_timer::stop() {
+    if (m_fd < 0) return;
+    struct itimerspec spec = {};
+    ::timerfd_settime(m_fd, 0, &spec, nullptr);
+    consume();
+  }
+  std::uint64_t interval_timer::consume() {
+    if (m_fd < 0) return 0;
+    std::uint64_t count = 0;
+    if (::read(m_fd, &count, sizeof count) != (ssize_t) sizeof count) return 0;
+    return count;
+  }
+#else
+  interval_timer::interval_timer() {}
+  interval_timer::~interval_timer() {}
+  bool interval_timer::start(int) { return false; }
+  void interval_timer::stop() {}
+  std::uint64_t interval_timer::consume() { return 0; }
+#endif
+
+}
@@ -0,0 +1,67 @@
+// -*- mode: c++; indent-tabs-mode: nil -*-
+#ifndef contra_sys_poll_hpp
+#define contra_sys_poll_hpp
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace contra::sys {
+
+  /*?lwiki
+   * @class fd_poller
+   *   複数の fd が読み取り可能になるのを待つ。Linux では epoll を使い、それ以外では poll を使う。
+   *
+   * @fn bool add(int fd);
+   * @fn void remove(int fd);
+   *   監視する fd を登録・解除する。負の fd は無視する。
+   * @fn bool wait(int timeout_msec);
+   *   何れかの fd が読み取り可能になるまで待つ。timeout_msec < 0 の時は無期限に待つ。
+   *   読み取り可能な fd があれば true を返し、タイムアウトまたはシグナルで中断した時は false を返す。
+   *   Note: 相手が閉じた (HUP) fd は以降の待機で毎回起きない様に登録を解除する。
+   *     残っているデータは呼び出し元が EOF まで読み取る。
+   */
+  class fd_poller {
+    int m_epoll = -1;
+    std::vector<int> m_fds;
+
+  public:
+    fd_poller();
+    ~fd_poller();
+    fd_poller(fd_poller const&) = delete;
+    fd_poller& operator=(fd_poller const&) = delete;
+
+    bool add(int fd);
+    void remove(int fd);
+    bool wait(int timeout_msec);
+  };
+
+  /*?lwiki
+   * @class interval_timer
+   *   一定間隔で読み取り可能になる fd (Linux の timerfd)。fd_poller に登録して使う。
+   *   timerfd のない環境では start が false を返す。
+   *
+   * @fn bool start(int interval_msec);
+   *   タイマーを (再) 開始する。最初の満了は interval_msec 後。
+   * @fn void stop();
+   *   タイマーを停止する。fd は閉じないので fd_poller に登録したままで良い。
+   * @fn std::uint64_t consume();
+   *   前回の呼び出し以降に満了した回数を返す。満了していなければ 0 を返す。
+   */
+  class interval_timer {
+    int m_fd = -1;
+
+  public:
+    interval_timer();
+    ~interval_timer();
+    interval_timer(interval_timer const&) = delete;
+    interval_timer& operator=(interval_timer const&) = delete;
+
+    int fd() const { return m_fd; }
+    bool start(int interval_msec);
+    void stop();
+    std::uint64_t consume();
+  };
+
+}
+
+#endif
@@ -3,6 +3,10 @@
 #include <mwg/except.h>
 #include "sys.signal.hpp"
 
+// pipe, read, write, fcntl
+#include <unistd.h>
+#include <fcntl.h>
+
 namespace contra::sys {
 
   static void process_default_handler(int sig, signal_handler_t handler) {
@@ -15,6 +19,31 @@ namespace contra::sys {
     }
   }
 
+  // Note: ハンドラから poll/epoll の待機を起こす為の self-pipe。
+  static int signal_pipe[2] = {-1, -1};
+  static void notify_signal() {
+    if (signal_pipe[1] < 0) return;
+    char const c = 0;
+    [[maybe_unused]] ssize_t const result = ::write(signal_pipe[1], &c, 1);
+  }
+  static void setup_signal_pipe() {
+    if (signal_pipe[0] >= 0) return;
+    if (::pipe(signal_pipe) < 0) {
+      signal_pipe[0] = signal_pipe[1] = -1;
+      return;
+    }
+    for (int const fd : signal_pipe) {
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+      ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  }
+  static void drain_signal_pipe() {
+    if (signal_pipe[0] < 0) return;
+    char buff[64];
+    while (::read(signal_pipe[0], buff, sizeof buff) > 0);
+  }
+  int signal_notify_fd() { return signal_pipe[0]; }
+
   static bool sigwinch_raised = false;
   static signal_handler_t sigwinch_default_handler = nullptr;
   static std::vector<signal_handler_t> sigwinch_handlers;
@@ -22,12 +51,22 @@ namespace contra::sys {
     // シグナル処理中に別のシグナルを受けると処理系定義なので
     // ここでは記録だけしてできるだけ早く抜ける様にする。
     sigwinch_raised = true;
+    notify_signal();
+  }
+
+  // Note: 子プロセスの終了を待機中に検出する為に、SIGCHLD でも待機を起こす。
+  //   pty の HUP を受け取った時点ではまだ waitpid で終了を確認できないことがある。
+  static void trap_chld(int) {
+    notify_signal();
   }
 
   void setup_signal() {
+    setup_signal_pipe();
     sigwinch_default_handler = std::signal(SIGWINCH, &trap_winch);
+    std::signal(SIGCHLD, &trap_chld);
   }
   void process_signals() {
+    drain_signal_pipe();
     if (sigwinch_raised) {
       process_default_handler(SIGWINCH, sigwinch_default_handler);
       for (auto handler : sigwinch_handlers) handler(SIGWINCH);
@@ -7,6 +7,10 @@ namespace contra::sys {
   void setup_signal();
   void process_signals();
   void add_sigwinch_handler(signal_handler_t h);
+
+  // シグナルを受信すると読み取り可能になる fd (fd_poller で待機する為)。
+  // setup_signal の前は -1 を返す。
+  int signal_notify_fd();
 }
 
 #endif
@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <iterator>
+#include <unistd.h>
+#include "capture.hpp"
+
+// capture_writer で記録したファイルを capture_reader で読み戻す確認。
+
+using namespace contra::term;
+
+namespace {
+  int failure_count = 0;
+
+  void check(bool ok, const char* message) {
+    if (ok) return;
+    failure_count++;
+    std::printf("FAIL: %s\n", message);
+  }
+
+  bool write_file(std::string const& path, const char* data, std::size_t size) {
+    std::FILE* const file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool const ok = std::fwrite(data, 1, size, file) == size;
+    std::fclose(file);
+    return ok;
+  }
+
+  void test_round_trip(std::string const& path) {
+    static const char* const outputs[] = {"hello", "", "\x1b[31mred\x1b[m\r\n", "\0\xff\n"};
+    static const std::size_t sizes[] = {5, 0, 14, 3};
+    {
+      capture_writer writer;
+      check(writer.open(path.c_str(), 80, 24), "open a capture file for write");
+      contra::idevice& dev = writer;
+      dev.dev_write(outputs[0], sizes[0]);
+      dev.dev_write(outputs[1], sizes[1]);
+      writer.write_resize(132, 43);
+      dev.dev_write(outputs[2], sizes[2]);
+      dev.dev_write(outputs[3], sizes[3]);
+    }
+
+    capture_reader reader;
+    check(reader.open(path.c_str()), "open a capture file for read");
+    check(reader.width() == 80 && reader.height() == 24, "the initial size");
+
+    for (int pass = 0; pass < 2; pass++) {
+      capture_record record;
+      std::uint64_t time = 0;
+      std::size_t index = 0;
+      int count = 0;
+      while (reader.next(record)) {
+        check(record.time >= time, "timestamps are not monotonic");
+        time = record.time;
+        if (count++ == 2) {
+          check(record.type == capture_resize, "the resize record type");
+          check(record.width == 132 && record.height == 43, "the resize record size");
+          continue;
+        }
+        check(record.type == capture_output, "the output record type");
+        check(index < std::size(sizes) && record.size == sizes[index] &&
+          std::memcmp(record.data, outputs[index], record.size) == 0, "the output record data");
+        index++;
+      }
+      check(count == 5, "the number of records");
+      reader.rewind();
+    }
+  }
+
+  void test_broken(std::string const& path) {
+    capture_reader reader;
+    static const char bad_header[] = "contra-capture 2 80 24\n";
+    check(write_file(path, bad_header, sizeof bad_header - 1), "write a file");
+    check(!reader.open(path.c_str()), "a wrong header was accepted");
+
+    // 途中で切れたレコードは読み取らない。
+    {
+      capture_writer writer;
+      writer.open(path.c_str(), 10, 5);
+      static_cast<contra::idevice&>(writer).dev_write("abcdef", 6);
+    }
+    check(truncate(path.c_str(), std::strlen("contra-capture 1 10 5\n") + 16 + 3) == 0, "truncate a file");
+    check(reader.open(path.c_str()), "open a truncated file");
+    capture_record record;
+    check(!reader.next(record), "a truncated record was read");
+  }
+}
+
+int main() {
+  char dir[] = "/tmp/contra-test-capture.XXXXXX";
+  if (!::mkdtemp(dir)) {
+    std::printf("test_capture: failed to create a temporary directory\n");
+    return 1;
+  }
+  std::string const path = std::string(dir) + "/capture.bin";
+  test_round_trip(path);
+  test_broken(path);
+  ::unlink(path.c_str());
+  ::rmdir(dir);
+
+  if (failure_count) {
+    std::printf("test_capture: %d failures\n", failure_count);
+    return 1;
+  }
+  std::printf("test_capture: ok\n");
+  return 0;
+}
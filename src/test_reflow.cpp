@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "ansi/term.hpp"
+#include "ansi/search.hpp"
+
+// 端末の幅を変えた時の折り返し直し (board_t::reflow) の確認。
+//   折り返しと復元の往復、カーソル位置、溢れた行、EL/ED と代替画面からの復帰を確認する。
+
+using namespace contra::ansi;
+
+namespace {
+  int failure_count = 0;
+
+  void check(bool ok, const char* name, const char* message) {
+    if (ok) return;
+    failure_count++;
+    std::printf("FAIL: %s: %s\n", name, message);
+  }
+
+  void write(term_t& term, const char* data) {
+    term.write_bytes(data, std::strlen(data));
+  }
+
+  // 行の内容を末尾の空白を除いて取り出す。
+  std::string line_string(line_t const& line) {
+    std::u32string text;
+    line_text(line, text);
+    while (text.size() && text.back() == U' ') text.pop_back();
+    return std::string(text.begin(), text.end());
+  }
+  std::string row(term_t& term, curpos_t y) {
+    return line_string(term.board().line(y));
+  }
+
+  void check_row(term_t& term, curpos_t y, const char* expected, const char* name) {
+    std::string const text = row(term, y);
+    if (text == expected) return;
+    failure_count++;
+    std::printf("FAIL: %s: row %d is \"%s\" (expected \"%s\")\n", name, (int) y, text.c_str(), expected);
+  }
+  void check_cursor(term_t& term, curpos_t x, curpos_t y, const char* name) {
+    board_t const& b = term.board();
+    if (b.cur.x() == x && b.cur.y() == y) return;
+    failure_count++;
+    std::printf("FAIL: %s: cursor is (%d, %d) (expected (%d, %d))\n",
+      name, (int) b.cur.x(), (int) b.cur.y(), (int) x, (int) y);
+  }
+
+  void test_round_trip() {
+    const char* const name = "round trip";
+    term_t term(10, 5);
+    write(term, "abcdefghijklmno\r\nxyz");
+    check_row(term, 0, "abcdefghij", name);
+    check_row(term, 1, "klmno", name);
+    check_cursor(term, 3, 2, name);
+
+    term.reset_size(20, 5);
+    check_row(term, 0, "abcdefghijklmno", name);
+    check_row(term, 1, "xyz", name);
+    check_row(term, 2, "", name);
+    check_cursor(term, 3, 1, name);
+
+    term.reset_size(10, 5);
+    check_row(term, 0, "abcdefghij", name);
+    check_row(term, 1, "klmno", name);
+    check_row(term, 2, "xyz", name);
+    check_cursor(term, 3, 2, name);
+
+    // 折り返した行の中のカーソル
+    write(term, "\x1b[2;3H");
+    term.reset_size(20, 5);
+    check_cursor(term, 12, 0, name);
+    term.reset_size(10, 5);
+    check_cursor(term, 2, 1, name);
+  }
+
+  void test_overflow() {
+    const char* const name = "overflow";
+    term_t term(10, 3);
+    term.set_scroll_capacity(100);
+    write(term, "0123456789abcd\r\nxyz\x1b[1;1H");
+    check_cursor(term, 0, 0, name);
+
+    // 4 行になるので 1 行はスクロールバッファに移す。カーソル行より下の行も残す。
+    term.reset_size(5, 3);
+    check(term.scroll_buffer().size() == 1, name, "the overflowed row was not moved to the scroll buffer");
+    if (term.scroll_buffer().size() == 1)
+      check(line_string(term.scroll_buffer()[0]) == "01234", name, "unexpected row in the scroll buffer");
+    check_row(term, 0, "56789", name);
+    check_row(term, 1, "abcd", name);
+    check_row(term, 2, "xyz", name);
+    check_cursor(term, 0, 0, name);
+  }
+
+  void test_erase() {
+    const char* const name = "erase";
+    term_t term(10, 5);
+    write(term, "abcdefghijklmno");
+    write(term, "\x1b[1;5H\x1b[K");
+    term.reset_size(20, 5);
+    check_row(term, 0, "abcd", name);
+    check_row(term, 1, "klmno", name);
+
+    term_t term2(10, 5);
+    write(term2, "abcdefghijklmno\x1b[H\x1b[J");
+    write(term2, "\x1b[2;1Hxyz");
+    term2.reset_size(20, 5);
+    check_row(term2, 0, "", name);
+    check_row(term2, 1, "xyz", name);
+  }
+
+  void test_decdhl() {
+    const char* const name = "decdhl";
+    term_t term(10, 5);
+    write(term, "\x1b[9906mabcdef\x1b[m");
+    std::string const row0 = row(term, 0), row1 = row(term, 1);
+    term.reset_size(20, 5);
+    check(row(term, 0) == row0 && row(term, 1) == row1, name, "a double-width row was reflowed");
+  }
+
+  void test_altscreen() {
+    const char* const name = "altscreen";
+    term_t term(10, 5);
+    write(term, "abcdefghijklmno");
+    check_cursor(term, 5, 1, name);
+
+    write(term, "\x1b[?1049h");
+    term.reset_size(20, 5);
+    write(term, "\x1b[3;3H");
+    write(term, "\x1b[?1049l");
+    check_row(term, 0, "abcdefghijklmno", name);
+    check_cursor(term, 15, 0, name);
+
+    write(term, "\x1b[?47h");
+    term.reset_size(10, 5);
+    write(term, "\x1b[?47l");
+    check_row(term, 1, "klmno", name);
+    check_cursor(term, 5, 1, name);
+  }
+}
+
+int main() {
+  test_round_trip();
+  test_overflow();
+  test_erase();
+  test_decdhl();
+  test_altscreen();
+  if (failure_count) {
+    std::printf("test_reflow: %d failures\n", failure_count);
+    return 1;
+  }
+  std::printf("test_reflow: ok\n");
+  return 0;
+}
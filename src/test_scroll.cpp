@@ -0,0 +1,141 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "ansi/term.hpp"
+#include "ansi/search.hpp"
+
+// スクロールバッファ (term_scroll_buffer_t) の確認。
+
+using namespace contra::ansi;
+
+namespace {
+  int failure_count = 0;
+
+  void check(bool ok, const char* name, const char* message) {
+    if (ok) return;
+    failure_count++;
+    std::printf("FAIL: %s: %s\n", name, message);
+  }
+
+  // 同じ行を chunk_size バイトずつに分けて line_count 行書き込む。
+  void write_lines(term_t& term, std::size_t chunk_size, std::size_t line_count) {
+    static const char line[] = "y\r\n";
+    std::string chunk;
+    while (chunk.size() < chunk_size) chunk += line;
+    chunk.resize(chunk_size);
+
+    std::size_t const total = line_count * (sizeof line - 1);
+    for (std::size_t written = 0; written < total; written += chunk_size)
+      term.write_bytes(chunk.data(), std::min(chunk_size, total - written));
+  }
+
+  // 暖機の後は行の領域を回収して使い回し、新しく確保しない。
+  //   一度に多数の LF を受信すると凍結を end_batch まで遅らせるので、
+  //   一度に回収する行数が多くても回収した領域を捨てない事を確認する。
+  void test_pool_steady_state(std::size_t chunk_size) {
+    char name[64];
+    std::snprintf(name, sizeof name, "pool steady state (chunk %zu)", chunk_size);
+
+    term_t term(80, 24);
+    term.set_scroll_capacity(1000);
+    line_buffer_pool const& pool = term.scroll_buffer().line_pool();
+
+    write_lines(term, chunk_size, 20000);
+    std::size_t const allocation_count = pool.allocation_count();
+    std::size_t const recycle_count = pool.recycle_count();
+    write_lines(term, chunk_size, 200000);
+    check(pool.allocation_count() == allocation_count, name, "line buffers were allocated after warm-up");
+    check(pool.recycle_count() > recycle_count, name, "line buffers were not recycled");
+  }
+
+  // 凍結・退避した行の選択範囲の変更は、展開したブロックを追い出した後も残る。
+  void test_thaw_write_back(bool spill) {
+    const char* const name = spill ? "thaw write-back (spilled)" : "thaw write-back (frozen)";
+    term_t term(20, 5);
+    term.set_scroll_capacity(spill ? 200 : 2000);
+    term.set_scroll_freeze_age(64);
+    if (spill && !term.set_scroll_spill(true)) {
+      std::printf("test_scroll: skipped %s (no spill file)\n", name);
+      return;
+    }
+    for (int i = 0; i < 1000; i++) {
+      char buff[32];
+      std::snprintf(buff, sizeof buff, "line %d\r\n", i);
+      term.write_bytes(buff, std::strlen(buff));
+    }
+
+    term_scroll_buffer_t& scroll_buffer = term.m_scroll_buffer;
+    term_scroll_buffer_t const& cscroll_buffer = scroll_buffer;
+    check(spill ? scroll_buffer.spilled_count() > 100 : scroll_buffer.frozen_count() > 100, name, "lines were not frozen");
+    check(scroll_buffer[10].set_selection(0, 4, false, true, true), name, "failed to select");
+
+    // 他のブロックを展開して追い出す。
+    std::u32string text;
+    for (std::size_t k = 1; k <= 8; k++) line_text(cscroll_buffer[10 + 64 * k], text);
+    std::uint64_t const file_size = scroll_buffer.spill_file_size();
+
+    std::u32string data;
+    check(cscroll_buffer.extract_selection(10, data) == 0 && data == U"line", name, "the selection was lost");
+    check(cscroll_buffer.extract_selection(11, data) == 0 && data.empty(), name, "an unexpected selection");
+    line_text(cscroll_buffer[10], text);
+    check(text.compare(0, 7, U"line 10") == 0, name, "the line content changed");
+
+    // 読むだけならば書き戻さない。
+    for (int pass = 0; pass < 3; pass++)
+      for (std::size_t k = 0; k <= 8; k++) line_text(cscroll_buffer[20 + 64 * k], text);
+    check(scroll_buffer.spill_file_size() == file_size, name, "unchanged blocks were written again");
+  }
+
+  // 退避したブロックを繰り返し書き直しても退避ファイルは大きくならない。
+  void test_spill_rewrite() {
+    const char* const name = "spill rewrite";
+    term_t term(20, 5);
+    term.set_scroll_capacity(200);
+    term.set_scroll_freeze_age(64);
+    if (!term.set_scroll_spill(true)) {
+      std::printf("test_scroll: skipped %s (no spill file)\n", name);
+      return;
+    }
+    for (int i = 0; i < 1000; i++) {
+      char buff[32];
+      std::snprintf(buff, sizeof buff, "line %d\r\n", i);
+      term.write_bytes(buff, std::strlen(buff));
+    }
+
+    term_scroll_buffer_t& scroll_buffer = term.m_scroll_buffer;
+    term_scroll_buffer_t const& cscroll_buffer = scroll_buffer;
+    std::u32string text;
+    std::uint64_t file_size = 0;
+    for (int round = 0; round < 100; round++) {
+      if (round % 2 == 0)
+        scroll_buffer[10].set_selection(0, 4 + round % 3, false, true, true);
+      else
+        scroll_buffer.clear_selection(10);
+      for (std::size_t k = 1; k <= 8; k++) line_text(cscroll_buffer[10 + 64 * k], text);
+      if (round == 1) file_size = scroll_buffer.spill_file_size();
+    }
+    check(scroll_buffer.spill_file_size() == file_size, name, "the spill file grew while rewriting the same block");
+
+    std::u32string data;
+    check(cscroll_buffer.extract_selection(10, data) == 0 && data.empty(), name, "the selection was not cleared");
+    line_text(cscroll_buffer[10], text);
+    check(text.compare(0, 7, U"line 10") == 0, name, "the line content changed");
+  }
+}
+
+int main() {
+  test_pool_steady_state(64);
+  test_pool_steady_state(1999);
+  test_pool_steady_state(2001);
+  test_pool_steady_state(4096);
+  test_pool_steady_state(65536);
+  test_thaw_write_back(false);
+  test_thaw_write_back(true);
+  test_spill_rewrite();
+  if (failure_count) {
+    std::printf("test_scroll: %d failures\n", failure_count);
+    return 1;
+  }
+  std::printf("test_scroll: ok\n");
+  return 0;
+}
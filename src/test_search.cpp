@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ansi/search.hpp"
+
+// text_search_index による絞り込みが線形探索と同じ結果になる事の確認。
+//   正規表現から索引用の部分文字列を取り出す処理 (search_regex_literal) も含めて確認する。
+
+using namespace contra::ansi;
+
+namespace {
+  int failure_count = 0;
+
+  void check(bool ok, const char* message, std::u32string const& pattern) {
+    if (ok) return;
+    failure_count++;
+    std::printf("FAIL: %s: ", message);
+    for (char32_t c : pattern) std::putchar(c < 0x80 ? (int) c : '?');
+    std::putchar('\n');
+  }
+
+  std::u32string to_u32(const char* str) {
+    return std::u32string(str, str + std::char_traits<char>::length(str));
+  }
+
+  // 線形探索と索引による探索で一致する行の一覧を比べる。
+  void check_pattern(std::vector<std::u32string> const& lines, text_search_index const& index, const char* source, int flags) {
+    std::u32string const pattern = to_u32(source);
+    search_pattern pat;
+    if (!pat.compile(pattern, flags)) {
+      check(false, "compile", pattern);
+      return;
+    }
+
+    std::size_t const offset = index.begin();
+    auto _match = [&] (std::size_t i) {
+      std::size_t begin, end;
+      return pat.find(lines[i], 0, begin, end);
+    };
+
+    std::vector<std::size_t> expected, actual;
+    for (std::size_t i = offset; i < lines.size(); i++)
+      if (_match(i)) expected.push_back(i);
+
+    std::vector<std::uint64_t> groups;
+    if (index.candidates(pat.literal(), groups)) {
+      for (std::uint64_t const group : groups) {
+        std::size_t const beg = std::max<std::size_t>(group * text_search_index::group_size, offset);
+        std::size_t const end = std::min<std::size_t>((group + 1) * text_search_index::group_size, lines.size());
+        for (std::size_t i = beg; i < end; i++)
+          if (_match(i)) actual.push_back(i);
+      }
+    } else {
+      actual = expected;
+    }
+    check(expected.size() > 0, "no matches in the test data", pattern);
+    check(actual == expected, "indexed search differs from the linear scan", pattern);
+  }
+
+  // 一致範囲を文字の位置で確認する。非 ASCII の文字も一文字として扱う。
+  void check_find(std::u32string const& text, std::u32string const& pattern, int flags, std::size_t offset, std::size_t expected_begin, std::size_t expected_end) {
+    search_pattern pat;
+    std::size_t begin = 0, end = 0;
+    bool const found = pat.compile(pattern, flags) && pat.find(text, offset, begin, end);
+    check(found && begin == expected_begin && end == expected_end, "the match range", pattern);
+  }
+  void check_not_found(std::u32string const& text, std::u32string const& pattern, int flags) {
+    search_pattern pat;
+    std::size_t begin, end;
+    check(pat.compile(pattern, flags) && !pat.find(text, 0, begin, end), "an unexpected match", pattern);
+  }
+}
+
+int main() {
+  // 検索対象の行。番号や繰り返し文字を含む。
+  std::vector<std::u32string> lines;
+  text_search_index index;
+  for (std::size_t i = 0; i < 2000; i++) {
+    char buff[128];
+    std::snprintf(buff, sizeof buff, "line %04zu: %s value=%zu %s",
+      i, i % 7 == 0 ? "abbbb" : "xyz", i * 37 % 1000,
+      i % 13 == 0 ? "ABCdef" : i % 11 == 0 ? "foo(bar)" : "hello world");
+    lines.push_back(to_u32(buff));
+    index.add(lines.back());
+  }
+
+  auto _check_all = [&] {
+    check_pattern(lines, index, "hello world", 0);
+    check_pattern(lines, index, "HELLO", search_icase);
+    check_pattern(lines, index, "foo(bar)", 0);
+    check_pattern(lines, index, "ab{4}", search_regex);
+    check_pattern(lines, index, "ab{1000}|abbbb", search_regex);
+    check_pattern(lines, index, "line 1{2}23", search_regex);
+    check_pattern(lines, index, "line [0-9]{4}: abbbb", search_regex);
+    check_pattern(lines, index, "\\x41BCdef", search_regex);
+    check_pattern(lines, index, "\\u0041BCdef", search_regex);
+    check_pattern(lines, index, "value=\\d+ ABC", search_regex);
+    check_pattern(lines, index, "(foo|xyz)\\(bar\\)", search_regex);
+    check_pattern(lines, index, "foo\\(bar\\)", search_regex);
+    check_pattern(lines, index, "abc?def", search_regex | search_icase);
+  };
+  _check_all();
+
+  check_find(U"xaあbc", U"a.b", search_regex, 0, 1, 4);
+  check_find(U"うえあい", U"[あい]+", search_regex, 0, 2, 4);
+  check_find(U"あいあい", U"あい", search_regex, 1, 2, 4);
+  check_find(U"abc あ def", U"\\bdef", search_regex, 5, 6, 9);
+  check_find(U"A\U0001F600B", U"A.B", search_regex, 0, 0, 3);
+  check_not_found(U"う", U"[あい]", search_regex);
+  check_not_found(U"あいう", U"^い", search_regex);
+
+  // 古い行を破棄した後も同じ結果になる。
+  index.drop_front(700);
+  _check_all();
+
+  if (failure_count) {
+    std::printf("test_search: %d failure(s)\n", failure_count);
+    return 1;
+  }
+  std::printf("test_search: ok\n");
+  return 0;
+}
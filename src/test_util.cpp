@@ -0,0 +1,207 @@
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include "util.hpp"
+
+// util::ring_deque と util::spsc_byte_ring の確認。
+
+using namespace contra::util;
+
+namespace {
+  int failure_count = 0;
+
+  void check(bool ok, const char* name, const char* message) {
+    if (ok) return;
+    failure_count++;
+    std::printf("FAIL: %s: %s\n", name, message);
+  }
+
+  // 生存している要素の数を数える。
+  struct counted {
+    static int alive;
+    int value;
+    counted(int value): value(value) { alive++; }
+    counted(counted&& other): value(other.value) { alive++; }
+    counted(counted const& other): value(other.value) { alive++; }
+    ~counted() { alive--; }
+  };
+  int counted::alive = 0;
+
+  std::uint32_t xorshift(std::uint32_t& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  }
+
+  //---------------------------------------------------------------------------
+  // ring_deque
+
+  template<typename Deque>
+  bool equals(Deque const& a, std::deque<int> const& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < b.size(); i++)
+      if (a[i].value != b[i]) return false;
+    return true;
+  }
+
+  void test_ring_deque() {
+    const char* const name = "ring_deque";
+    {
+      ring_deque<counted> deque;
+      std::deque<int> expected;
+      check(deque.empty(), name, "not empty after construction");
+
+      // 先頭から削除しながら追加して、容量の境界を跨ぐ。
+      for (int i = 0; i < 12; i++) {
+        deque.emplace_back(i);
+        expected.push_back(i);
+      }
+      for (int i = 0; i < 10; i++) {
+        deque.pop_front();
+        expected.pop_front();
+      }
+      for (int i = 12; i < 24; i++) {
+        deque.emplace_back(i);
+        expected.push_back(i);
+      }
+      check(equals(deque, expected), name, "wraparound");
+
+      // 境界を跨いだ状態で拡張する。
+      for (int i = 24; i < 40; i++) {
+        deque.emplace_back(i);
+        expected.push_back(i);
+      }
+      check(equals(deque, expected), name, "grow while wrapped");
+
+      std::uint32_t seed = 2463534242u;
+      for (int i = 0; i < 100000; i++) {
+        switch (xorshift(seed) % 4) {
+        case 0:
+          deque.emplace_back(i);
+          expected.push_back(i);
+          break;
+        case 1:
+          deque.emplace_front(i);
+          expected.push_front(i);
+          break;
+        case 2:
+          if (expected.size()) {
+            deque.pop_front();
+            expected.pop_front();
+          }
+          break;
+        case 3:
+          if (expected.size()) {
+            deque.pop_back();
+            expected.pop_back();
+          }
+          break;
+        }
+        if (expected.size() && (deque.front().value != expected.front() || deque.back().value != expected.back())) {
+          check(false, name, "front/back differ from std::deque");
+          break;
+        }
+      }
+      check(equals(deque, expected), name, "random operations");
+      check(counted::alive == (int) expected.size(), name, "element lifetime");
+
+      int sum = 0, expected_sum = 0;
+      for (counted const& value : deque) sum += value.value;
+      for (int const value : expected) expected_sum += value;
+      check(sum == expected_sum, name, "iteration");
+
+      ring_deque<counted> other;
+      other.emplace_back(-1);
+      other.swap(deque);
+      check(equals(other, expected) && deque.size() == 1 && deque.front().value == -1, name, "swap");
+
+      other.clear();
+      check(other.empty(), name, "not empty after clear");
+      other.emplace_back(1);
+      check(other.size() == 1 && other.front().value == 1, name, "reuse after clear");
+    }
+    check(counted::alive == 0, name, "elements leaked after destruction");
+  }
+
+  //---------------------------------------------------------------------------
+  // spsc_byte_ring
+
+  void test_spsc_byte_ring() {
+    const char* const name = "spsc_byte_ring";
+    spsc_byte_ring ring(100);
+    check(ring.capacity() == 128, name, "capacity is not rounded up to a power of two");
+    check(ring.empty() && ring.read_span().second == 0, name, "not empty after construction");
+
+    // 一杯
+    auto [buff, size] = ring.write_span();
+    check(size == 128, name, "the first write span");
+    for (std::size_t i = 0; i < size; i++) buff[i] = (char) i;
+    ring.commit_write(size);
+    check(ring.size() == 128 && ring.write_span().second == 0, name, "full");
+
+    // 一部を読んでから書き込むと末尾で折り返す。
+    check(ring.read_span().second == 128 && ring.read_span().first[100] == 100, name, "read span when full");
+    ring.commit_read(100);
+    std::tie(buff, size) = ring.write_span();
+    check(size == 100, name, "the write span after wraparound");
+    for (std::size_t i = 0; i < 60; i++) buff[i] = (char) (128 + i);
+    ring.commit_write(60);
+
+    // 読取領域は末尾で分かれる。
+    auto [data, count] = ring.read_span();
+    check(count == 28 && data[0] == 100, name, "the read span before the end");
+    ring.commit_read(count);
+    std::tie(data, count) = ring.read_span();
+    check(count == 60 && (unsigned char) data[0] == 128 && (unsigned char) data[59] == 187, name, "the read span after the end");
+    ring.commit_read(count);
+    check(ring.empty(), name, "empty after reading everything");
+    check(ring.write_span().second == 128 - 60, name, "the write span after emptied");
+
+    // 二つのスレッドの間で受け渡す。
+    spsc_byte_ring ring2(64);
+    std::size_t const total = 1 << 22;
+    std::thread writer([&ring2, total] {
+      std::size_t sent = 0;
+      std::uint32_t seed = 12345;
+      while (sent < total) {
+        auto [buff, size] = ring2.write_span();
+        if (!size) {
+          std::this_thread::yield();
+          continue;
+        }
+        size = std::min<std::size_t>({size, total - sent, 1 + xorshift(seed) % 48});
+        for (std::size_t i = 0; i < size; i++) buff[i] = (char) ((sent + i) % 251);
+        ring2.commit_write(size);
+        sent += size;
+      }
+    });
+    std::size_t received = 0;
+    bool ok = true;
+    while (received < total) {
+      auto [data, count] = ring2.read_span();
+      if (!count) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (std::size_t i = 0; i < count; i++)
+        if ((unsigned char) data[i] != (received + i) % 251) ok = false;
+      ring2.commit_read(count);
+      received += count;
+    }
+    writer.join();
+    check(ok && received == total && ring2.empty(), name, "transfer between threads");
+  }
+}
+
+int main() {
+  test_ring_deque();
+  test_spsc_byte_ring();
+  if (failure_count) {
+    std::printf("test_util: %d failures\n", failure_count);
+    return 1;
+  }
+  std::printf("test_util: ok\n");
+  return 0;
+}
@@ -29,7 +29,6 @@ namespace contra::ttty {
   bool run(contra::app::context& actx) {
     initialize();
 
-    contra_unused(actx);
     contra::ttty::ttty_screen screen(STDIN_FILENO, STDOUT_FILENO);
     contra::term::terminal_session_parameters params;
     {
@@ -42,6 +41,10 @@ namespace contra::ttty {
       // params.termios = &screen.old_termios;
       // params.dbg_fd_tee = STDOUT_FILENO;
       // params.dbg_sequence_logfile = "ttty-allseq.txt";
+      actx.read("session_capture_file", params.dbg_capture_file);
+      actx.read("session_threaded_read", params.threaded_read);
+      actx.read("session_threaded_parse", params.threaded_parse);
+      actx.read("session_parse_threads", params.parse_threads);
     }
     if (!screen.initialize(params)) {
       contra::xprint(errdev(), "contra: failed to create the session");
@@ -49,6 +52,7 @@ namespace contra::ttty {
     }
 
     screen.manager().set_prefix_key(modifier_control | ascii_a);
+    screen.manager().configure_frame(actx);
 
     // auto& app = screen.manager().app();
     // app.state().m_default_fg_space = contra::ansi::color_space_indexed;
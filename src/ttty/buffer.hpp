@@ -34,7 +34,7 @@ namespace ttty {
     bool remote_xenl = true;
 
 
-    term_view_t* w_view = nullptr;
+    term_view_t const* w_view = nullptr; // Note: 凍結行を書き戻す対象にしない様に const で参照する。
     tty_writer w;
 
   public:
@@ -256,7 +256,7 @@ namespace ttty {
     }
 
     struct apply_default_attribute_impl {
-      term_view_t* view;
+      term_view_t const* view;
       byte fgspace;
       byte bgspace;
       color_t fgcolor;
@@ -271,7 +271,7 @@ namespace ttty {
       bool hasfill = false;
       cell_t fill;
 
-      apply_default_attribute_impl(term_view_t* view):
+      apply_default_attribute_impl(term_view_t const* view):
         view(view), m_atable(view->atable()), abuild(view->atable())
       {
         fgspace = view->fg_space();
@@ -287,9 +287,9 @@ namespace ttty {
         attr_builder abuild(m_atable);
         abuild.set_fg(fgcolor, fgspace);
         abuild.set_bg(bgcolor, bgspace);
-        fill.character = ascii_nul;
+        fill.set_character(ascii_nul);
         fill.attribute = abuild.attr();
-        fill.width = 1;
+        fill.set_width(1);
       }
 
       void apply(std::vector<cell_t>& content) {
@@ -333,51 +333,53 @@ namespace ttty {
       }
     }
 
-    void render_line(std::vector<cell_t> const& new_content, std::vector<cell_t> const& old_content, attr_t const& fill_attr) {
+    typedef line_storage::buffer_type line_buffer_t;
+
+    void render_line(line_buffer_t const& new_content, line_buffer_t const& old_content, attr_t const& fill_attr) {
+      typedef line_storage S;
+      std::size_t const new_size = S::size(new_content);
+      std::size_t const old_size = S::size(old_content);
+
       // 更新の必要のある範囲を決定する
       attr_table* const atable = w_view->atable();
+      auto _is_blank = [atable] (line_buffer_t const& cells, std::size_t index) {
+        return S::character(cells, index) == ascii_nul && atable->is_default(S::attribute(cells, index));
+      };
 
       // 一致する先頭部分の長さを求める。
-      std::size_t i1 = 0;
+      std::size_t i1 = S::common_prefix(new_content, old_content);
+      if (i1 == old_size)
+        while (i1 < new_size && _is_blank(new_content, i1)) i1++;
       curpos_t x1 = 0;
-      for (; i1 < new_content.size(); i1++) {
-        cell_t const& cell = new_content[i1];
-        if (i1 < old_content.size()) {
-          if (cell != old_content[i1]) break;
-        } else {
-          if (!(cell.character == ascii_nul && atable->is_default(cell.attribute))) break;
-        }
-        x1 += cell.width;
-      }
+      for (std::size_t i = 0; i < i1; i++) x1 += S::width(new_content, i);
       // Note: cluster_extension や marker に違いがある時は
       //   その前の有限幅の文字まで後退する。
       //   (出力先の端末がどの様に零幅文字を扱うのかに依存するが、)
       //   contra では古い marker を消す為には前の有限幅の文字を書く必要がある為。
-      while (i1 && new_content[i1].width == 0) i1--;
+      while (i1 && i1 < new_size && S::width(new_content, i1) == 0) i1--;
 
       // 一致する末端部分のインデックスと長さを求める。
-      auto _find_upper_bound_non_empty = [atable] (std::vector<cell_t> const& cells, std::size_t lower_bound) {
-        std::size_t ret = cells.size();
-        while (ret > lower_bound && cells[ret - 1].character == ascii_nul && atable->is_default(cells[ret - 1].attribute)) ret--;
+      auto _find_upper_bound_non_empty = [&] (line_buffer_t const& cells, std::size_t lower_bound) {
+        std::size_t ret = S::size(cells);
+        while (ret > lower_bound && _is_blank(cells, ret - 1)) ret--;
         return ret;
       };
       curpos_t w3 = 0;
       std::size_t i2 = _find_upper_bound_non_empty(new_content, i1);
       std::size_t j2 = _find_upper_bound_non_empty(old_content, i1);
       for (; j2 > i1 && i2 > i1; j2--, i2--) {
-        cell_t const& cell = new_content[i2 - 1];
-        if (new_content[i2 - 1] != old_content[j2 - 1]) break;
-        w3 += cell.width;
+        if (!S::equals(new_content, i2 - 1, old_content, j2 - 1)) break;
+        w3 += S::width(new_content, i2 - 1);
       }
       // Note: cluster_extension や marker も本体の文字と共に再出力する。
       //   (出力先の端末がどの様に零幅文字を扱うのかに依存するが、)
       //   contra ではcluster_extension や marker は暗黙移動で潰される為。
-      while (i2 < new_content.size() && new_content[i2].width == 0) i2++;
+      while (i2 < new_size && S::width(new_content, i2) == 0) i2++;
 
       // 間の部分の幅を求める。
       curpos_t new_w2 = 0, old_w2 = 0;
-      for (std::size_t i = i1; i < i2; i++) new_w2 += new_content[i].width;
-      for (std::size_t j = i1; j < j2; j++) old_w2 += old_content[j].width;
+      for (std::size_t i = i1; i < i2; i++) new_w2 += S::width(new_content, i);
+      for (std::size_t j = i1; j < j2; j++) old_w2 += S::width(old_content, j);
 
       move_to_column(x1);
       if (new_w2 || old_w2) {
@@ -389,13 +391,13 @@ namespace ttty {
         }
 
         for (std::size_t i = i1; i < i2; i++) {
-          cell_t const& cell = new_content[i];
-          std::uint32_t code = cell.character.value;
+          std::uint32_t code = S::character(new_content, i).value;
+          std::uint32_t const width = S::width(new_content, i);
           if (code == ascii_nul) code = ascii_sp;
-          if (remote_x + (curpos_t) cell.width > remote_w) return;
-          w.apply_attr(cell.attribute);
+          if (remote_x + (curpos_t) width > remote_w) return;
+          w.apply_attr(S::attribute(new_content, i));
           w.put_u32(code);
-          remote_x += cell.width;
+          remote_x += width;
           if (!remote_xenl && remote_x == remote_w) {
             remote_y++;
             remote_x = 0;
@@ -428,6 +430,7 @@ namespace ttty {
   private:
     void render_content(bool full_update) {
       std::vector<cell_t> buff;
+      line_buffer_t content;
 
       curpos_t const height = w_view->height();
       if (full_update) {
@@ -446,11 +449,12 @@ namespace ttty {
           go_to(0, y);
           w_view->order_cells_in(buff, position_client, line);
           default_attribute.apply(buff);
-          this->render_line(buff, snapshot_line.content, fill_attr);
+          line_storage::assign(content, buff);
+          this->render_line(content, snapshot_line.content, fill_attr);
 
           snapshot_line.version = line.version();
           snapshot_line.id = line.id();
-          snapshot_line.content.swap(buff);
+          snapshot_line.content.swap(content);
         }
       }
       w.apply_attr(0);
@@ -475,7 +479,7 @@ namespace ttty {
         w.set_atable(view.atable());
       }
 
-      w_view->update();
+      view.update();
 
       auto _update_metric = [&] (auto& prev, auto value) {
         if (prev == value) return;
@@ -2,6 +2,7 @@
 #ifndef contra_ttty_screen_hpp
 #define contra_ttty_screen_hpp
 #include <memory>
+#include <mutex>
 #include <cstdio>
 #include <time.h>
 
@@ -165,19 +166,44 @@ namespace ttty {
 
     void do_loop(bool render_to_stdout = true) {
       char buff[4096];
+      m_manager.watch_fd(fd_in);
+      m_manager.watch_fd(contra::sys::signal_notify_fd());
       for (;;) {
-        bool const processed = m_manager.do_events();
-        if (m_manager.m_dirty && render_to_stdout)
-          renderer->update(m_manager.app().view());
-
-        contra::sys::process_signals();
-
-        // ToDo: 本来はここはキー入力に変換してから m_manager に渡すべき。
-        //if (contra::term::read_from_fd(fd_in, &m_manager.app().term().input_device(), buff, sizeof(buff))) continue;
-        if (contra::term::read_from_fd(fd_in, &m_input_decoder, buff, sizeof(buff))) continue;
-        if (!m_manager.is_alive()) break;
+        bool processed;
+        int timeout;
+        {
+          std::lock_guard<contra::term::terminal_manager> lock(m_manager);
+          processed = m_manager.do_events();
+          timeout = m_manager.frame_timeout();
+          if (timeout == 0 && render_to_stdout)
+            m_manager.app().update_frame();
+        }
+
+        // Note: 構文解析を別スレッドで行う時、描画中も構文解析を止めない様に
+        //   term ではなく複製した frame を描画する。
+        if (timeout == 0) {
+          if (render_to_stdout) {
+            contra::term::terminal_application& app = m_manager.app();
+            app.lock_frame();
+            renderer->update(app.frame_view());
+            app.unlock_frame();
+          }
+          m_manager.frame_rendered();
+        }
+
+        {
+          std::lock_guard<contra::term::terminal_manager> lock(m_manager);
+          contra::sys::process_signals();
+
+          // ToDo: 本来はここはキー入力に変換してから m_manager に渡すべき。
+          //if (contra::term::read_from_fd(fd_in, &m_manager.app().term().input_device(), buff, sizeof(buff))) continue;
+          if (contra::term::read_from_fd(fd_in, &m_input_decoder, buff, sizeof(buff))) continue;
+          if (!m_manager.is_alive()) break;
+          timeout = m_manager.frame_timeout();
+          if (timeout == 0) processed = true;
+        }
         if (!processed)
-          contra::term::msleep(10);
+          m_manager.wait_events(timeout);
       }
 
       m_manager.terminate();
@@ -1320,6 +1320,10 @@ namespace {
       //params.dbg_sequence_logfile = "twin-allseq.txt";
       actx.read("session_term", params.env["TERM"] = "xterm-256color");
       actx.read("session_shell", params.shell = "/bin/bash");
+      actx.read("session_scroll_buffer_size", params.scroll_buffer_size);
+      actx.read("session_scroll_freeze_age", params.scroll_freeze_age);
+      actx.read("session_scroll_spill", params.scroll_spill);
+      actx.read("session_scroll_search_index", params.scroll_search_index);
       std::unique_ptr<term::terminal_application> sess = contra::term::create_terminal_session(params);
       if (!sess) return false;
 
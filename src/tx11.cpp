@@ -12,7 +12,9 @@
 #include "manager.hpp"
 #include "pty.hpp"
 #include "context.hpp"
+#include "sys.signal.hpp"
 #include <memory>
+#include <mutex>
 
 namespace contra::tx11 {
 namespace {
@@ -702,10 +704,12 @@ namespace {
     const char* m_env_term = "xterm-256color";
     const char* m_env_shell = "/bin/bash";
     bool tx11_disableMouseReportOnScrLock = false;
+    int m_caret_interval = 400;
 
     void configure(contra::app::context& actx) {
       base::configure(actx);
       actx.read("tx11_disable_mouse_report_on_scrlock", tx11_disableMouseReportOnScrLock = true);
+      actx.read("tx11_caret_interval", m_caret_interval = 400);
     }
   };
 
@@ -732,6 +736,7 @@ namespace {
 
       // other settings
       settings.configure(actx);
+      manager.configure_frame(actx);
 
       kbflags_initialize();
     }
@@ -874,9 +879,26 @@ namespace {
     }
 
   private:
+    contra::sys::interval_timer m_cursor_timer;
+    bool m_cursor_timer_active = false;
+
     friend class ansi::window_renderer_t<tx11_graphics_t>;
-    void unset_cursor_timer() {}
-    void reset_cursor_timer() {}
+    void unset_cursor_timer() {
+      if (!m_cursor_timer_active) return;
+      m_cursor_timer.stop();
+      m_cursor_timer_active = false;
+    }
+    void reset_cursor_timer() {
+      if (!is_session_ready()) return;
+      m_cursor_timer_active = m_cursor_timer.start(settings.m_caret_interval);
+      wstat.m_cursor_timer_count = 0;
+    }
+    bool process_cursor_timer() {
+      if (!m_cursor_timer_active || !m_cursor_timer.consume()) return false;
+      wstat.m_cursor_timer_count++;
+      manager.m_dirty = true;
+      return true;
+    }
 
   private:
     void render_window() {
@@ -888,7 +910,10 @@ namespace {
         bool resized = true;
         gbuffer.setup(this->main, g.gc());
         gbuffer.update_window_size(this->m_window_width, this->m_window_height, &resized);
-        renderer.render_view(*this, gbuffer, manager.app().view(), resized);
+        term::terminal_application& app = manager.app();
+        app.lock_frame();
+        renderer.render_view(*this, gbuffer, app.frame_view(), resized);
+        app.unlock_frame();
       }
       XFlush(display);
     }
@@ -1106,14 +1131,13 @@ namespace {
       ansi::curpos_t const x1 = px / wstat.m_xunit;
       ansi::curpos_t const y1 = py / wstat.m_yunit;
       manager.input_mouse(key, px, py, x1, y1);
-      if (manager.m_dirty) render_window();
       return true;
     }
     void process_event(XEvent const& event) {
       switch (event.type) {
       case Expose:
         if (event.xexpose.count == 0)
-          render_window();
+          manager.m_dirty = true;
         break;
 
       case ClientMessage: // #D0162
@@ -1220,16 +1244,28 @@ namespace {
       //params.dbg_sequence_logfile = "tx11-allseq.txt";
       actx.read("session_term", params.env["TERM"] = "xterm-256color");
       actx.read("session_shell", params.shell = "/bin/bash");
+      actx.read("session_scroll_buffer_size", params.scroll_buffer_size);
+      actx.read("session_scroll_freeze_age", params.scroll_freeze_age);
+      actx.read("session_scroll_spill", params.scroll_spill);
+      actx.read("session_scroll_search_index", params.scroll_search_index);
+      actx.read("session_capture_file", params.dbg_capture_file);
+      actx.read("session_threaded_read", params.threaded_read);
+      actx.read("session_threaded_parse", params.threaded_parse);
+      actx.read("session_parse_threads", params.parse_threads);
       std::unique_ptr<term::terminal_application> sess = contra::term::create_terminal_session(params);
       if (!sess) return false;
 
-      contra::ansi::tstate_t& s = sess->state();
-      s.m_default_fg_space = contra::ansi::color_space_rgb;
-      s.m_default_bg_space = contra::ansi::color_space_rgb;
-      s.m_default_fg_color = contra::ansi::rgb(0x00, 0x00, 0x00);
-      s.m_default_bg_color = contra::ansi::rgb(0xFF, 0xFF, 0xFF);
-      // s.m_default_fg_color = contra::ansi::rgb(0xD0, 0xD0, 0xD0);//@color
-      // s.m_default_bg_color = contra::ansi::rgb(0x00, 0x00, 0x00);
+      {
+        // Note: 構文解析スレッドは既に動いているので lock してから変更する。
+        std::lock_guard<term::terminal_application> lock(*sess);
+        contra::ansi::tstate_t& s = sess->state();
+        s.m_default_fg_space = contra::ansi::color_space_rgb;
+        s.m_default_bg_space = contra::ansi::color_space_rgb;
+        s.m_default_fg_color = contra::ansi::rgb(0x00, 0x00, 0x00);
+        s.m_default_bg_color = contra::ansi::rgb(0xFF, 0xFF, 0xFF);
+        // s.m_default_fg_color = contra::ansi::rgb(0xD0, 0xD0, 0xD0);//@color
+        // s.m_default_bg_color = contra::ansi::rgb(0x00, 0x00, 0x00);
+      }
       manager.add_app(std::move(sess));
       return true;
     }
@@ -1245,23 +1281,49 @@ namespace {
       this->kbflags_update_modifiers();
       if (!this->add_terminal_session()) return false;
 
+      manager.watch_fd(ConnectionNumber(display));
+      manager.watch_fd(m_cursor_timer.fd());
+      manager.watch_fd(contra::sys::signal_notify_fd());
+
       XEvent event;
       while (this->display) {
-        bool processed = manager.do_events();
-        if (manager.m_dirty) {
+        bool processed;
+        int timeout;
+        {
+          std::lock_guard<term::terminal_manager> lock(manager);
+          processed = manager.do_events();
+          timeout = manager.frame_timeout();
+          if (timeout == 0) manager.app().update_frame();
+        }
+
+        // Note: 構文解析を別スレッドで行う時、描画中も構文解析を止めない様に
+        //   term ではなく複製した frame を描画する。
+        //   イベント処理で描画が必要になった時も m_dirty を立てて次の周回で描画する。
+        if (timeout == 0) {
           render_window();
-          manager.m_dirty = false;
+          manager.frame_rendered();
         }
 
-        while (::XCheckIfEvent(display, &event, event_filter_proc, NULL)) {
-          processed = true;
-          process_event(event);
-          if (!display) goto exit;
+        {
+          std::lock_guard<term::terminal_manager> lock(manager);
+          while (::XCheckIfEvent(display, &event, event_filter_proc, NULL)) {
+            processed = true;
+            process_event(event);
+            if (!display) goto exit;
+          }
+          if (process_cursor_timer()) processed = true;
+          contra::sys::process_signals();
+
+          if (!manager.is_alive()) break;
+          timeout = manager.frame_timeout();
+          if (timeout == 0) processed = true;
         }
 
-        if (!manager.is_alive()) break;
-        if (!processed)
-          contra::term::msleep(10);
+        // Note: Xlib が既に読み取ってキューに溜めているイベントは fd を見ても分からないので、
+        //   XPending で確認してから待つ (XPending は送信バッファの flush も行う)。
+        //   出力による描画を纏めている間は次の描画の時刻まで待つ。
+        if (!processed && !::XPending(display))
+          manager.wait_events(timeout);
       }
     exit:
       manager.terminate();
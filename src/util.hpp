@@ -4,8 +4,13 @@
 #include <iterator>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 #include <utility>
 #include <algorithm>
+#include <type_traits>
+#include <memory>
+#include <new>
+#include <atomic>
 
 namespace contra {
 namespace util {
@@ -82,36 +87,81 @@ namespace util {
   indexer_iterator<T, Container, Index> operator+(Index index, indexer_iterator<T, Container, Index> const& iter) { return iter + index; }
 
 
+  /*?lwiki
+   * @class ring_buffer
+   *   行の様に大きな要素を並べ替える為の環状バッファ。
+   *   要素の実体 (data) は移動せずに、論理位置から data の添字への表 (m_slots) を並べ替える。
+   *   全体の回転 (rotate) は O(1)、部分範囲の回転 (rotate_range) は添字の移動だけで行う。
+   *   resize と assign の後は data が論理位置の順に並ぶ。
+   */
   template<typename T>
   struct ring_buffer {
     std::vector<T> data;
+    std::vector<std::uint32_t> m_slots;
     std::size_t m_rotate;
 
     template<typename... Args>
-    ring_buffer(Args&&... args): data(std::forward<Args>(args)...), m_rotate(0) {}
+    ring_buffer(Args&&... args): data(std::forward<Args>(args)...), m_rotate(0) {
+      reset_slots();
+    }
 
     T& operator[](std::size_t index) {
-      return data[(m_rotate + index) % data.size()];
+      return data[m_slots[(m_rotate + index) % data.size()]];
     }
     T const& operator[](std::size_t index) const {
-      return data[(m_rotate + index) % data.size()];
+      return data[m_slots[(m_rotate + index) % data.size()]];
     }
 
     void rotate(std::size_t delta) {
       m_rotate = (m_rotate + delta) % data.size();
     }
+    // 論理位置の範囲 [first, last) を middle が先頭に来る様に回転する。
+    void rotate_range(std::size_t first, std::size_t middle, std::size_t last) {
+      if (m_rotate) {
+        std::rotate(m_slots.begin(), m_slots.begin() + m_rotate, m_slots.end());
+        m_rotate = 0;
+      }
+      std::rotate(m_slots.begin() + first, m_slots.begin() + middle, m_slots.begin() + last);
+    }
+
     std::size_t size() const { return data.size(); }
     void resize(std::size_t new_size) {
-      std::rotate(data.begin(), data.begin() + m_rotate, data.end());
-      this->m_rotate = 0;
+      normalize();
       data.resize(new_size);
+      reset_slots();
     }
     void resize(std::size_t new_size, T const& value) {
-      std::rotate(data.begin(), data.begin() + m_rotate, data.end());
-      this->m_rotate = 0;
+      normalize();
       data.resize(new_size, value);
+      reset_slots();
+    }
+    void assign(std::vector<T>&& values) {
+      data = std::move(values);
+      m_rotate = 0;
+      reset_slots();
     }
 
+  private:
+    void reset_slots() {
+      m_slots.resize(data.size());
+      for (std::size_t i = 0; i < m_slots.size(); i++) m_slots[i] = i;
+    }
+    // data を論理位置の順に並べ直す。
+    void normalize() {
+      bool sorted = true;
+      for (std::size_t i = 0; sorted && i < data.size(); i++)
+        sorted = m_slots[(m_rotate + i) % data.size()] == i;
+      if (sorted) return;
+      std::vector<T> values;
+      values.reserve(data.capacity());
+      for (std::size_t i = 0; i < data.size(); i++)
+        values.emplace_back(std::move((*this)[i]));
+      data.swap(values);
+      m_rotate = 0;
+      reset_slots();
+    }
+
+  public:
     typedef indexer_iterator<T, ring_buffer, std::size_t> iterator;
     typedef indexer_iterator<const T, const ring_buffer, std::size_t> const_iterator;
     iterator begin() { return {this, (std::size_t) 0}; }
@@ -120,6 +170,190 @@ namespace util {
     const_iterator end() const { return {this, data.size()}; }
   };
 
+  // 末尾への追加と先頭からの削除を行う両端キュー。
+  // Note: std::deque は要素の追加・削除に伴ってノードを確保・解放するので、
+  //   要素が定常的に入れ替わる用途ではこちらを使う。
+  //   容量は 2 倍ずつ拡張して縮小しないので、容量に達した後は確保が起こらない。
+  template<typename T>
+  class ring_deque {
+    T* m_data = nullptr;
+    std::size_t m_capacity = 0;
+    std::size_t m_head = 0;
+    std::size_t m_size = 0;
+
+  public:
+    ring_deque() {}
+    ring_deque(ring_deque const&) = delete;
+    ring_deque& operator=(ring_deque const&) = delete;
+    ~ring_deque() {
+      clear();
+      if (m_data) std::allocator<T>().deallocate(m_data, m_capacity);
+    }
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T& operator[](std::size_t index) { return m_data[(m_head + index) % m_capacity]; }
+    T const& operator[](std::size_t index) const { return m_data[(m_head + index) % m_capacity]; }
+    T& front() { return m_data[m_head]; }
+    T const& front() const { return m_data[m_head]; }
+    T& back() { return (*this)[m_size - 1]; }
+    T const& back() const { return (*this)[m_size - 1]; }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+      if (m_size == m_capacity) grow();
+      T* const p = &m_data[(m_head + m_size) % m_capacity];
+      ::new((void*) p) T(std::forward<Args>(args)...);
+      m_size++;
+      return *p;
+    }
+    template<typename... Args>
+    T& emplace_front(Args&&... args) {
+      if (m_size == m_capacity) grow();
+      std::size_t const head = (m_head + m_capacity - 1) % m_capacity;
+      T* const p = &m_data[head];
+      ::new((void*) p) T(std::forward<Args>(args)...);
+      m_head = head;
+      m_size++;
+      return *p;
+    }
+    void pop_front() {
+      m_data[m_head].~T();
+      m_head = (m_head + 1) % m_capacity;
+      m_size--;
+    }
+    void pop_back() {
+      back().~T();
+      m_size--;
+    }
+    void clear() {
+      while (m_size) pop_front();
+      m_head = 0;
+    }
+    void swap(ring_deque& other) {
+      std::swap(m_data, other.m_data);
+      std::swap(m_capacity, other.m_capacity);
+      std::swap(m_head, other.m_head);
+      std::swap(m_size, other.m_size);
+    }
+
+    typedef indexer_iterator<T, ring_deque, std::size_t> iterator;
+    typedef indexer_iterator<const T, const ring_deque, std::size_t> const_iterator;
+    iterator begin() { return {this, (std::size_t) 0}; }
+    iterator end() { return {this, m_size}; }
+    const_iterator begin() const { return {this, (std::size_t) 0}; }
+    const_iterator end() const { return {this, m_size}; }
+
+  private:
+    void grow() {
+      std::size_t const capacity = std::max<std::size_t>(16, m_capacity * 2);
+      T* const data = std::allocator<T>().allocate(capacity);
+      for (std::size_t i = 0; i < m_size; i++) {
+        T& value = (*this)[i];
+        ::new((void*) &data[i]) T(std::move(value));
+        value.~T();
+      }
+      if (m_data) std::allocator<T>().deallocate(m_data, m_capacity);
+      m_data = data;
+      m_capacity = capacity;
+      m_head = 0;
+    }
+  };
+
+  // 先頭 N 要素までは内部配列に保持し、溢れた時にだけ std::vector に移す。
+  // Note: clear() は退避領域の容量を保持するので、
+  //   一度溢れた後も再確保は起こらない。
+  template<typename T, std::size_t N>
+  class small_vector {
+    static_assert(std::is_trivially_copyable<T>::value, "small_vector: T should be trivially copyable");
+
+    std::size_t m_size = 0;
+    T m_inline[N];
+    std::vector<T> m_spill;
+
+  public:
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear() {
+      m_size = 0;
+      m_spill.clear();
+    }
+    void push_back(T const& value) {
+      if (m_size < N) {
+        m_inline[m_size] = value;
+      } else {
+        if (m_size == N) m_spill.assign(m_inline, m_inline + N);
+        m_spill.push_back(value);
+      }
+      m_size++;
+    }
+
+    T* data() { return m_size <= N ? m_inline : m_spill.data(); }
+    T const* data() const { return m_size <= N ? m_inline : m_spill.data(); }
+    T& operator[](std::size_t index) { return data()[index]; }
+    T const& operator[](std::size_t index) const { return data()[index]; }
+    T* begin() { return data(); }
+    T* end() { return data() + m_size; }
+    T const* begin() const { return data(); }
+    T const* end() const { return data() + m_size; }
+  };
+
+  /*?lwiki
+   * @class spsc_byte_ring
+   *   一つの書込スレッドと一つの読取スレッドの間でバイト列を受け渡すロックフリーのリングバッファ。
+   *   容量は 2 の冪に切り上げる。
+   * @fn std::pair<char*, std::size_t> write_span();
+   * @fn void commit_write(std::size_t size);
+   *   (書込スレッド) 連続して書き込める領域を取得し、書き込んだ量を公開する。
+   * @fn std::pair<char const*, std::size_t> read_span() const;
+   * @fn void commit_read(std::size_t size);
+   *   (読取スレッド) 連続して読み取れる領域を取得し、読み取った量を解放する。
+   */
+  class spsc_byte_ring {
+    std::unique_ptr<char[]> m_data;
+    std::size_t m_mask = 0;
+    // Note: 書込位置と読取位置は別のスレッドが更新するので別のキャッシュラインに置く。
+    alignas(64) std::atomic<std::size_t> m_head {0};
+    alignas(64) std::atomic<std::size_t> m_tail {0};
+
+  public:
+    explicit spsc_byte_ring(std::size_t capacity) {
+      std::size_t size = 1;
+      while (size < capacity) size <<= 1;
+      m_data = std::make_unique<char[]>(size);
+      m_mask = size - 1;
+    }
+    spsc_byte_ring(spsc_byte_ring const&) = delete;
+    spsc_byte_ring& operator=(spsc_byte_ring const&) = delete;
+
+    std::size_t capacity() const { return m_mask + 1; }
+    std::size_t size() const {
+      return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+
+    std::pair<char*, std::size_t> write_span() {
+      std::size_t const head = m_head.load(std::memory_order_relaxed);
+      std::size_t const tail = m_tail.load(std::memory_order_acquire);
+      std::size_t const offset = head & m_mask;
+      std::size_t const free = capacity() - (head - tail);
+      return {&m_data[offset], std::min(free, capacity() - offset)};
+    }
+    void commit_write(std::size_t size) {
+      m_head.store(m_head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+
+    std::pair<char const*, std::size_t> read_span() const {
+      std::size_t const tail = m_tail.load(std::memory_order_relaxed);
+      std::size_t const head = m_head.load(std::memory_order_acquire);
+      std::size_t const offset = tail & m_mask;
+      return {&m_data[offset], std::min(head - tail, capacity() - offset)};
+    }
+    void commit_read(std::size_t size) {
+      m_tail.store(m_tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+  };
+
   // std::rotate に似るが結果の最初の count 個の要素だけ正しければ良い場合に使うアルゴリズム
   template<typename ForwardIterator>
   void partial_rotate(ForwardIterator first, ForwardIterator mid, ForwardIterator last, std::size_t count) {